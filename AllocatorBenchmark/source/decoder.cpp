@@ -0,0 +1,29 @@
+// Stands in for the Zydis decoder, which SafetyHook links against for its hooks.
+// The benchmark only ever goes through the allocator, which doesn't decode anything.
+// Zydis.c (the amalgamated decoder AurieCore.vcxproj builds) isn't part of the tree,
+// so every decode fails here instead.
+#define ZYDIS_STATIC_BUILD
+#include <Zydis/Zydis.h>
+
+extern "C"
+{
+	ZyanStatus ZydisDecoderInit(
+		ZydisDecoder*,
+		ZydisMachineMode,
+		ZydisStackWidth
+	)
+	{
+		return ZYAN_STATUS_FAILED;
+	}
+
+	ZyanStatus ZydisDecoderDecodeInstruction(
+		const ZydisDecoder*,
+		ZydisDecoderContext*,
+		const void*,
+		ZyanUSize,
+		ZydisDecodedInstruction*
+	)
+	{
+		return ZYAN_STATUS_FAILED;
+	}
+}
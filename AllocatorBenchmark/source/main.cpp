@@ -0,0 +1,260 @@
+// Benchmarks the SafetyHook near allocator the way hooking uses it, no Aurie runtime needed.
+// Builds for both backends, on Linux from this folder with:
+//   g++ -std=c++23 -O2 -I../../Aurie/source/include main.cpp decoder.cpp ../../Aurie/source/include/SafetyHook/safetyhook.cpp
+// decoder.cpp stands in for Zydis, see there.
+#include <SafetyHook/safetyhook.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace safetyhook;
+using benchmark_clock = std::chrono::steady_clock;
+
+// Hooks are spread over this much code, like the functions of a large game binary
+constexpr size_t BENCHMARK_TARGET_SPAN = 512 * 1024 * 1024;
+
+// Roughly what a trampoline for a hooked function prologue takes
+constexpr size_t BENCHMARK_MIN_TRAMPOLINE = 16;
+constexpr size_t BENCHMARK_MAX_TRAMPOLINE = 80;
+
+// Where the fragmented part of the address space goes, relative to our own code.
+// Every run gets a zone of its own, the Linux backend never unmaps its blocks (vm_free passes munmap a zero length).
+constexpr size_t BENCHMARK_FRAGMENT_OFFSET = 1024 * 1024 * 1024;
+constexpr size_t BENCHMARK_FRAGMENT_ZONE_SIZE = 64 * 1024 * 1024;
+
+static double ElapsedMicroseconds(
+	benchmark_clock::time_point Start
+)
+{
+	return std::chrono::duration<double, std::micro>(benchmark_clock::now() - Start).count();
+}
+
+// The unit the allocator reserves address space in
+static size_t GetAllocationGranularity()
+{
+#ifdef _WIN32
+	SYSTEM_INFO system_info = {};
+	GetSystemInfo(&system_info);
+	return system_info.dwAllocationGranularity;
+#else
+	return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+// Takes one granule of address space at exactly Address, fails if anything is there already.
+// Neighbours on Linux only stay separate mappings if their protection differs, hence IsReadable.
+static bool ReserveFragment(
+	uint8_t* Address,
+	size_t Size,
+	bool IsReadable
+)
+{
+#ifdef _WIN32
+	(void)IsReadable;
+	return VirtualAlloc(Address, Size, MEM_RESERVE, PAGE_NOACCESS) == Address;
+#else
+	void* mapping = mmap(
+		Address,
+		Size,
+		IsReadable ? PROT_READ : PROT_NONE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE,
+		-1,
+		0
+	);
+
+	if (mapping == MAP_FAILED)
+		return false;
+
+	if (mapping != Address)
+	{
+		munmap(mapping, Size);
+		return false;
+	}
+
+	return true;
+#endif
+}
+
+static void ReleaseFragment(
+	uint8_t* Address,
+	size_t Size
+)
+{
+#ifdef _WIN32
+	(void)Size;
+	VirtualFree(Address, 0, MEM_RELEASE);
+#else
+	munmap(Address, Size);
+#endif
+}
+
+// Distinct addresses to hook, every one of them needs its trampoline within 2 GB
+static std::vector<uint8_t*> BuildTargets(
+	size_t Count
+)
+{
+	uint8_t* code_base = reinterpret_cast<uint8_t*>(&BuildTargets);
+
+	std::vector<uint8_t*> targets(Count);
+	for (size_t i = 0; i < Count; i++)
+		targets[i] = code_base + (i * (BENCHMARK_TARGET_SPAN / Count) & ~size_t(15));
+
+	return targets;
+}
+
+// Allocates one trampoline near every target, then frees them in random order
+static bool BenchmarkHookAllocations(
+	size_t HookCount
+)
+{
+	std::shared_ptr<Allocator> allocator = Allocator::create();
+	std::vector<uint8_t*> targets = BuildTargets(HookCount);
+
+	std::mt19937 random(static_cast<unsigned>(HookCount));
+	std::uniform_int_distribution<size_t> trampoline_size(BENCHMARK_MIN_TRAMPOLINE, BENCHMARK_MAX_TRAMPOLINE);
+
+	std::vector<Allocation> trampolines;
+	trampolines.reserve(HookCount);
+
+	benchmark_clock::time_point start = benchmark_clock::now();
+	for (uint8_t* target : targets)
+	{
+		auto trampoline = allocator->allocate_near({ target }, trampoline_size(random));
+		if (!trampoline)
+		{
+			printf("[!] allocate_near failed after %zu trampolines\n", trampolines.size());
+			return false;
+		}
+
+		trampolines.push_back(std::move(*trampoline));
+	}
+	const double allocate_time = ElapsedMicroseconds(start);
+
+	std::shuffle(trampolines.begin(), trampolines.end(), random);
+
+	start = benchmark_clock::now();
+	trampolines.clear();
+	const double free_time = ElapsedMicroseconds(start);
+
+	printf(
+		"%6zu hooks: allocate %9.1f us (%.3f us/hook), free %9.1f us (%.3f us/hook)\n",
+		HookCount,
+		allocate_time,
+		allocate_time / HookCount,
+		free_time,
+		free_time / HookCount
+	);
+
+	return true;
+}
+
+// Hooks functions in the middle of FragmentCount separate mappings.
+// Every time a trampoline block fills up, the allocator has to get past them to find free space.
+static bool BenchmarkFragmentedHookAllocations(
+	size_t FragmentCount,
+	size_t HookCount
+)
+{
+	static size_t run_index = 0;
+	const size_t granularity = GetAllocationGranularity();
+
+	uintptr_t zone_start = reinterpret_cast<uintptr_t>(&BenchmarkFragmentedHookAllocations) + BENCHMARK_FRAGMENT_OFFSET;
+	zone_start += run_index++ * BENCHMARK_FRAGMENT_ZONE_SIZE;
+	zone_start = (zone_start + granularity - 1) & ~(granularity - 1);
+
+	std::vector<uint8_t*> fragments;
+	fragments.reserve(FragmentCount);
+
+	for (size_t i = 0; i < FragmentCount; i++)
+	{
+		uint8_t* fragment = reinterpret_cast<uint8_t*>(zone_start + i * granularity);
+		if (ReserveFragment(fragment, granularity, i & 1))
+			fragments.push_back(fragment);
+	}
+
+	uint8_t* zone_middle = reinterpret_cast<uint8_t*>(zone_start + (FragmentCount / 2) * granularity);
+
+	std::vector<double> latencies;
+	latencies.reserve(HookCount);
+
+	bool has_succeeded = true;
+
+	{
+		std::shared_ptr<Allocator> allocator = Allocator::create();
+		std::vector<Allocation> trampolines;
+		trampolines.reserve(HookCount);
+
+		for (size_t i = 0; i < HookCount; i++)
+		{
+			benchmark_clock::time_point start = benchmark_clock::now();
+			auto trampoline = allocator->allocate_near({ zone_middle + i * 16 }, BENCHMARK_MAX_TRAMPOLINE);
+			latencies.push_back(ElapsedMicroseconds(start));
+
+			if (!trampoline)
+			{
+				printf("[!] allocate_near failed after %zu trampolines\n", trampolines.size());
+				has_succeeded = false;
+				break;
+			}
+
+			trampolines.push_back(std::move(*trampoline));
+		}
+	}
+
+	for (uint8_t* fragment : fragments)
+		ReleaseFragment(fragment, granularity);
+
+	if (!has_succeeded)
+		return false;
+
+	// The first allocation has to map out the address space, every later one works off what it learned
+	const double first_latency = latencies.front();
+	latencies.erase(latencies.begin());
+
+	double total_time = 0;
+	for (double latency : latencies)
+		total_time += latency;
+
+	std::sort(latencies.begin(), latencies.end());
+
+	printf(
+		"%6zu mappings: first %10.1f us, then mean %7.3f us, p99 %8.3f us, max %9.3f us per hook\n",
+		fragments.size(),
+		first_latency,
+		total_time / latencies.size(),
+		latencies[latencies.size() * 99 / 100],
+		latencies.back()
+	);
+
+	return true;
+}
+
+int main()
+{
+	// Per-hook cost should stay flat as the count grows, a linear walk per allocation shows up as growth here
+	printf("[>] Trampoline allocation for N hooks\n");
+	for (size_t hook_count : { 1000, 2500, 5000, 10000 })
+	{
+		if (!BenchmarkHookAllocations(hook_count))
+			return 1;
+	}
+
+	// Latency should barely move with the number of mappings in the way, it did when every step was a fresh query
+	printf("[>] Hook allocation latency against address space fragmentation\n");
+	for (size_t fragment_count : { 0, 128, 512, 2048 })
+	{
+		if (!BenchmarkFragmentedHookAllocations(fragment_count, 2000))
+			return 1;
+	}
+
+	return 0;
+}
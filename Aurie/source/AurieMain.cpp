@@ -15,36 +15,53 @@ void ArProcessDetach(HINSTANCE)
 
 	// Unload all modules except the initial image
 	// First calls the ModuleUnload functions (if they're set up)
-	for (auto& entry : Internal::g_LdrModuleList)
 	{
-		// Skip the initial image
-		if (&entry == g_ArInitialImage)
-			continue;
-		
-		// Unmap the image (but don't remove it from the list)
-		Internal::MdpUnmapImage(
-			&entry,
-			false,
-			true
-		);
-	}
+		AurieRcuReadGuard rcu_guard;
 
-	// Free persistent memory
-	for (auto& allocation : g_ArInitialImage->MemoryAllocations)
-	{
-		Internal::MmpFreeMemory(
-			g_ArInitialImage,
-			allocation.AllocationBase,
-			false
-		);
+		const Internal::MdpModuleSnapshot* module_snapshot = Internal::g_LdrModuleSnapshot.Load();
+		if (module_snapshot)
+		{
+			for (AurieModule* entry : module_snapshot->Modules)
+			{
+				// Skip the initial image
+				if (entry == g_ArInitialImage)
+					continue;
+
+				// We're under the loader lock, which a ModuleInitialize still running on the thread pool may need.
+				// Its module stays loaded, waiting for it here could hang the process.
+				if (Internal::MdpIsAsyncInitializationPending(entry))
+					continue;
+
+				// Unmap the image (but don't remove it from the list)
+				Internal::MdpUnmapImage(
+					entry,
+					false,
+					true
+				);
+			}
+		}
 	}
 
-	// Remove all the allocations, they're now invalid
-	g_ArInitialImage->MemoryAllocations.clear();
+	// Free persistent memory
+	Internal::MmpReleaseArena(g_ArInitialImage->MemoryArena);
 
 	// Null the initial image, and clear the module list
 	g_ArInitialImage = nullptr;
-	Internal::g_LdrModuleList.clear();
+	Internal::g_ObInterfaceTables.Publish(nullptr);
+
+	for (auto& subscribers : Internal::g_ObEventSubscribers)
+		subscribers.Publish(nullptr);
+
+	Internal::ObpDestroyServiceQueue();
+
+	Internal::g_LdrModuleSnapshot.Publish(nullptr);
+	Internal::g_LdrModuleRegistry = {};
+
+	// Images that were never asked for stay unloaded
+	Internal::g_LdrLazyImages.clear();
+
+	// Nothing is left to read the tables, so whatever was retired can go
+	Internal::ObpRcuReclaimAll();
 }
 
 // Called upon framework initialization (DLL_PROCESS_ATTACH) event.
@@ -95,6 +112,20 @@ void ArProcessAttach(HINSTANCE Instance)
 		std::move(initial_module)
 	);
 
+	// Expose framework-owned interfaces before any module gets to run
+	Internal::MmpRegisterHookStatisticsInterface();
+
+	// Modules may post tasks from their entries already, they run once everything is initialized
+	if (!AurieSuccess(Internal::ObpInitializeServiceQueue()))
+	{
+		return (void)MessageBoxA(
+			nullptr,
+			"Failed to create the service queue!",
+			"Aurie Framework",
+			MB_OK | MB_TOPMOST | MB_ICONERROR | MB_SETFOREGROUND
+		);
+	}
+
 	// Get the current folder (where the main executable is)
 	fs::path folder_path;
 	if (!AurieSuccess(
@@ -115,6 +146,15 @@ void ArProcessAttach(HINSTANCE Instance)
 	// Craft the path from which the mods will be loaded
 	folder_path = folder_path / "mods" / "aurie";
 
+	// Remembers what preflight found out about each module last time, safe to delete
+	uint32_t trace_event = Internal::MmpBeginTraceSpan("LoadManifestCache");
+	Internal::MdpLoadManifestCache(folder_path / "aurie_manifest.cache");
+	Internal::MmpEndTraceSpan(trace_event);
+
+	// Developer mode, loaded modules are reloaded whenever they're rebuilt
+	if (GetEnvironmentVariableW(Internal::MDP_HOT_RELOAD_VARIABLE, nullptr, 0))
+		Internal::MdpEnableHotReload(folder_path);
+
 	// Load everything from %APPDIR%\\mods\\aurie
 	Internal::MdpMapFolder(
 		folder_path,
@@ -124,46 +164,56 @@ void ArProcessAttach(HINSTANCE Instance)
 	);
 
 	// Call ModulePreinitialize on all loaded plugins
-	for (auto& entry : Internal::g_LdrModuleList)
-	{
-		AurieStatus last_status = AURIE_SUCCESS;
-
-		// Skip modules that have already been preloaded - this can happen in one specific scenario:
-		// Mod A gets loaded, in ModulePreload calls MdMapImage on Mod B.
-		// 
-		// Mod B is loaded while the game process is suspended, which prompts
-		// the module manager to treat it as a non-runtime loaded mod.
-		// 
-		// The module manager will not call the ModuleInitialize routine
-		// if the process is suspended at the time of the call.
-		if (MdIsImagePreinitialized(&entry))
-			continue;
-
-		last_status = Internal::MdpDispatchEntry(
-			&entry,
-			entry.ModulePreinitialize
-		);
+	// Modules are dispatched in dependency order, see MdpOrderImages
+	trace_event = Internal::MmpBeginTraceSpan("PreinitializeModules");
+	Internal::MdpDispatchInWaves(
+		[](AurieModule* Entry)
+		{
+			AurieStatus last_status = AURIE_SUCCESS;
+
+			// Skip modules that have already been preloaded - this can happen in one specific scenario:
+			// Mod A gets loaded, in ModulePreload calls MdMapImage on Mod B.
+			// 
+			// Mod B is loaded while the game process is suspended, which prompts
+			// the module manager to treat it as a non-runtime loaded mod.
+			// 
+			// The module manager will not call the ModuleInitialize routine
+			// if the process is suspended at the time of the call.
+			if (MdIsImagePreinitialized(Entry))
+				return;
+
+			last_status = Internal::MdpDispatchEntry(
+				Entry,
+				Entry->ModulePreinitialize
+			);
 
-		// Mark mods failed for loading for the purge
-		if (!AurieSuccess(last_status))
-			Internal::MdpMarkModuleForPurge(&entry);
-		else
-			entry.Flags.IsPreloaded = true;
-	}
+			// Mark mods failed for loading for the purge
+			if (!AurieSuccess(last_status))
+				Internal::MdpMarkModuleForPurge(Entry);
+			else
+				Entry->Flags.IsPreloaded = true;
+		}
+	);
+	Internal::MmpEndTraceSpan(trace_event);
 
 	// Purge all the modules that failed loading
 	// We can't do this in the for loop because of iterators...
+	trace_event = Internal::MmpBeginTraceSpan("PurgeModules");
 	Internal::MdpPurgeMarkedModules();
+	Internal::MmpEndTraceSpan(trace_event);
 
 	// Resume our process if needed
+	trace_event = Internal::MmpBeginTraceSpan("ResumeProcess");
 	bool is_process_suspended = false;
 	if (!AurieSuccess(ElIsProcessSuspended(is_process_suspended)) || is_process_suspended)
 	{
 		Internal::ElpResumeProcess(GetCurrentProcess());
 	}
+	Internal::MmpEndTraceSpan(trace_event);
 
 	// Now we have to wait until the current process has finished initializating
-	
+	trace_event = Internal::MmpBeginTraceSpan("WaitForProcess");
+
 	// Query the process subsystem
 	unsigned short current_process_subsystem = 0;
 	PpGetImageSubsystem(
@@ -176,34 +226,66 @@ void ArProcessAttach(HINSTANCE Instance)
 		ElWaitForCurrentProcessWindow();
 
 	WaitForInputIdle(GetCurrentProcess(), INFINITE);
+	Internal::MmpEndTraceSpan(trace_event);
 
 	// Call ModuleEntry on all loaded plugins
-	for (auto& entry : Internal::g_LdrModuleList)
-	{
-		// Ignore modules that are already initialized?
-		if (MdIsImageInitialized(&entry))
-			continue;
+	trace_event = Internal::MmpBeginTraceSpan("InitializeModules");
+	Internal::MdpDispatchInWaves(
+		[](AurieModule* Entry)
+		{
+			// Ignore modules that are already initialized?
+			if (MdIsImageInitialized(Entry))
+				return;
 
-		AurieStatus last_status = Internal::MdpDispatchEntry(
-			&entry,
-			entry.ModuleInitialize
-		);
+			// Earlier waves may still be initializing in the background, and this module may depend on them
+			if (Entry->InitializationWave)
+				Internal::MdpWaitForAsyncInitializations(Entry->InitializationWave);
 
-		// Mark mods failed for loading for the purge
-		if (!AurieSuccess(last_status))
-			Internal::MdpMarkModuleForPurge(&entry);
-		else
-			entry.Flags.IsInitialized = true;
-	}
+			// The worker reports back through the service thread, see MdpAsyncInitializationWorker
+			if (Entry->Flags.AllowsAsyncInitialize && Internal::MdpBeginAsyncInitialization(Entry))
+				return;
+
+			AurieStatus last_status = Internal::MdpDispatchEntry(
+				Entry,
+				Entry->ModuleInitialize
+			);
+
+			// Mark mods failed for loading for the purge
+			if (!AurieSuccess(last_status))
+				Internal::MdpMarkModuleForPurge(Entry);
+			else
+				Entry->Flags.IsInitialized = true;
+		}
+	);
+	Internal::MmpEndTraceSpan(trace_event);
 
 	// Purge all the modules that failed loading
 	// We can't do this in the for loop because of iterators...
+	trace_event = Internal::MmpBeginTraceSpan("PurgeModules");
 	Internal::MdpPurgeMarkedModules();
+	Internal::MmpEndTraceSpan(trace_event);
 
-	while (!GetAsyncKeyState(VK_END))
-	{
-		Sleep(1);
-	}
+	// Write the startup timeline out if asked to, modules can write it again later with MmWriteTrace
+	wchar_t trace_path[MAX_PATH] = { 0 };
+	DWORD trace_path_length = GetEnvironmentVariableW(Internal::MMP_TRACE_VARIABLE, trace_path, MAX_PATH);
+	if (trace_path_length && trace_path_length < MAX_PATH)
+		MmWriteTrace(trace_path);
+
+	// Only does anything in hot reload mode
+	Internal::MdpStartHotReloadWatcher();
+
+	// Ctrl+Shift+End unloads everything, the key can be changed or turned off, see OBP_UNLOAD_HOTKEY_VARIABLE
+	UINT unload_hotkey = VK_END;
+	wchar_t unload_hotkey_value[16] = { 0 };
+	DWORD unload_hotkey_length = GetEnvironmentVariableW(Internal::OBP_UNLOAD_HOTKEY_VARIABLE, unload_hotkey_value, 16);
+	if (unload_hotkey_length && unload_hotkey_length < 16)
+		unload_hotkey = static_cast<UINT>(wcstoul(unload_hotkey_value, nullptr, 0));
+
+	// This thread now becomes the service thread, it runs deferred work until we're told to unload
+	Internal::ObpRunServiceLoop(unload_hotkey);
+
+	// The watcher runs our code, it has to be gone before we unload
+	Internal::MdpStopHotReloadWatcher();
 
 	// Calls DllMain with DLL_PROCESS_DETACH, which calls ArProcessDetach
 	FreeLibraryAndExitThread(Instance, 0);
@@ -220,8 +302,8 @@ BOOL WINAPI DllMain(
 	{
 	case DLL_PROCESS_ATTACH:
 		{
-			DisableThreadLibraryCalls(hinstDLL);
-
+			// Thread notifications stay enabled, thread_local state (RCU records, arena caches,
+			// scratch chunks) is torn down by the CRT when a thread detaches.
 			HANDLE created_thread = CreateThread(
 				nullptr,
 				0,
@@ -237,6 +319,11 @@ BOOL WINAPI DllMain(
 			CloseHandle(created_thread);
 			break;
 		}
+	case DLL_THREAD_DETACH:
+		{
+			// The CRT runs this thread's thread_local destructors on its own
+			break;
+		}
 	case DLL_PROCESS_DETACH:
 		{
 			// Process termination, the kernel will free stuff for us.
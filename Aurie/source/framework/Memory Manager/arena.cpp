@@ -0,0 +1,1056 @@
+#include "memory.hpp"
+#include <bit>
+#include <unordered_map>
+
+namespace Aurie
+{
+	PVOID MmAllocatePersistentMemory(
+		IN size_t Size
+	)
+	{
+		return MmAllocateMemory(
+			g_ArInitialImage,
+			Size
+		);
+	}
+
+	PVOID MmAllocateMemory(
+		IN AurieModule* Owner,
+		IN size_t Size
+	)
+	{
+		return Internal::MmpAllocateMemory(
+			Size,
+			Owner
+		);
+	}
+
+	AurieStatus MmFreePersistentMemory(
+		IN PVOID AllocationBase
+	)
+	{
+		return MmFreeMemory(
+			g_ArInitialImage, 
+			AllocationBase
+		);
+	}
+
+	AurieStatus MmFreeMemory(
+		IN AurieModule* Owner, 
+		IN PVOID AllocationBase
+	)
+	{
+		if (!Internal::MmpIsAllocatedMemory(
+			Owner,
+			AllocationBase
+		))
+		{
+			return AURIE_INVALID_PARAMETER;
+		}
+
+		Internal::MmpFreeMemory(
+			Owner,
+			AllocationBase
+		);
+
+		return AURIE_SUCCESS;
+	}
+
+	PVOID MmAllocateMemoryEx(
+		IN AurieModule* Owner,
+		IN size_t Size,
+		IN size_t Alignment,
+		IN AurieAllocationFlags Flags
+	)
+	{
+		// Has to be a power of two no larger than a page
+		if (Alignment & (Alignment - 1) || Alignment > AURIE_ARENA_PAGE_SIZE)
+			return nullptr;
+
+		PVOID allocation_base = nullptr;
+
+		// Every block is 16-byte aligned already
+		if (Alignment <= alignof(AurieArenaBlockHeader))
+		{
+			allocation_base = Internal::MmpAllocateMemory(
+				Size,
+				Owner
+			);
+		}
+		else
+		{
+			allocation_base = Internal::MmpArenaAllocateAligned(
+				Owner->MemoryArena,
+				Size,
+				Alignment
+			);
+		}
+
+		if (allocation_base && (Flags & AURIE_ALLOCATION_ZERO_MEMORY))
+			memset(allocation_base, 0, Size);
+
+		return allocation_base;
+	}
+
+	PVOID MmReallocateMemory(
+		IN AurieModule* Owner,
+		IN PVOID AllocationBase,
+		IN size_t NewSize
+	)
+	{
+		if (!AllocationBase)
+			return MmAllocateMemory(Owner, NewSize);
+
+		if (!Internal::MmpIsAllocatedMemory(Owner, AllocationBase))
+			return nullptr;
+
+		// Size classes are rounded up and large blocks to a full page, so there's often room left
+		const size_t block_size = Internal::MmpArenaGetBlockSize(AllocationBase);
+		if (NewSize <= block_size)
+			return AllocationBase;
+
+		// Over-aligned blocks stay as aligned as they were asked to be
+		PVOID new_allocation_base = MmAllocateMemoryEx(
+			Owner,
+			NewSize,
+			Internal::MmpArenaGetBlockAlignment(AllocationBase),
+			AURIE_ALLOCATION_FLAGS_NONE
+		);
+
+		if (!new_allocation_base)
+			return nullptr;
+
+		memcpy(new_allocation_base, AllocationBase, block_size);
+
+		Internal::MmpFreeMemory(
+			Owner,
+			AllocationBase
+		);
+
+		return new_allocation_base;
+	}
+
+	AurieStatus MmCreateObjectPool(
+		IN AurieModule* Owner,
+		IN size_t ObjectSize,
+		OUT AurieObjectPool*& Pool
+	)
+	{
+		if (!ObjectSize)
+			return AURIE_INVALID_PARAMETER;
+
+		PVOID pool_memory = Internal::MmpAllocateMemory(
+			sizeof(AurieObjectPool),
+			Owner
+		);
+
+		if (!pool_memory)
+			return AURIE_INSUFFICIENT_MEMORY;
+
+		AurieObjectPool* pool = new (pool_memory) AurieObjectPool;
+		pool->Owner = Owner;
+		pool->ObjectSize = (ObjectSize + alignof(AurieArenaBlockHeader) - 1) & ~(alignof(AurieArenaBlockHeader) - 1);
+
+		// Size slabs so they fill a chunk, unless a single object doesn't fit in one.
+		// Even half full, that's too big for any size class, so every slab gets a chunk of its own.
+		constexpr size_t slab_capacity = AURIE_ARENA_CHUNK_SIZE - Internal::MMP_POOL_SLAB_OFFSET - sizeof(AurieObjectPoolSlab);
+		static_assert(slab_capacity / 2 > (size_t(1) << (AURIE_ARENA_SIZE_CLASSES - 1 + AURIE_ARENA_MIN_BLOCK_SHIFT)));
+
+		pool->ObjectsPerSlab = std::max<size_t>(1, slab_capacity / pool->ObjectSize);
+
+		Pool = pool;
+		return AURIE_SUCCESS;
+	}
+
+	AurieStatus MmDestroyObjectPool(
+		IN AurieModule* Owner,
+		IN AurieObjectPool* Pool
+	)
+	{
+		if (!Internal::MmpIsAllocatedMemory(Owner, Pool) || Pool->Owner != Owner)
+			return AURIE_INVALID_PARAMETER;
+
+		AurieObjectPoolSlab* slab = Pool->Slabs;
+		while (slab)
+		{
+			AurieObjectPoolSlab* next_slab = slab->Next;
+			Internal::MmpFreeMemory(Owner, slab);
+			slab = next_slab;
+		}
+
+		Internal::MmpFreeMemory(Owner, Pool);
+		return AURIE_SUCCESS;
+	}
+
+	PVOID MmAllocatePoolObject(
+		IN AurieObjectPool* Pool
+	)
+	{
+		if (!Pool)
+			return nullptr;
+
+		AurieExclusiveLock pool_lock(Pool->Lock);
+
+		// Out of objects, carve up a new slab
+		if (!Pool->FreeObjects)
+		{
+			AurieObjectPoolSlab* slab = reinterpret_cast<AurieObjectPoolSlab*>(Internal::MmpAllocateMemory(
+				sizeof(AurieObjectPoolSlab) + Pool->ObjectSize * Pool->ObjectsPerSlab,
+				Pool->Owner
+			));
+
+			if (!slab)
+				return nullptr;
+
+			slab->Next = Pool->Slabs;
+			slab->Pool = Pool;
+			Pool->Slabs = slab;
+
+			// Link them back to front, so objects get handed out in address order
+			char* objects = reinterpret_cast<char*>(slab + 1);
+			for (size_t i = Pool->ObjectsPerSlab; i > 0; i--)
+			{
+				AurieArenaFreeBlock* object = reinterpret_cast<AurieArenaFreeBlock*>(objects + (i - 1) * Pool->ObjectSize);
+				object->Next = Pool->FreeObjects;
+				Pool->FreeObjects = object;
+			}
+		}
+
+		AurieArenaFreeBlock* object = Pool->FreeObjects;
+		Pool->FreeObjects = object->Next;
+
+		return object;
+	}
+
+	AurieStatus MmFreePoolObject(
+		IN AurieObjectPool* Pool,
+		IN PVOID Object
+	)
+	{
+		if (!Pool || !Object)
+			return AURIE_INVALID_PARAMETER;
+
+		// Only take back objects this pool handed out, anything else would corrupt the free list.
+		// Slabs start at the same place in their own chunk, and every object starts in its first AURIE_ARENA_CHUNK_SIZE bytes.
+		const uintptr_t object_address = reinterpret_cast<uintptr_t>(Object);
+		const uintptr_t chunk_base = object_address & ~(AURIE_ARENA_CHUNK_SIZE - 1);
+
+		{
+			// Keeps a slab of another pool from being released while we look at it
+			AurieRcuReadGuard rcu_guard;
+
+			if (!Internal::MmpIsArenaChunk(chunk_base))
+				return AURIE_INVALID_PARAMETER;
+
+			// Chunks shared by small blocks can't hold a slab
+			const AurieObjectPoolSlab* slab = reinterpret_cast<const AurieObjectPoolSlab*>(chunk_base + Internal::MMP_POOL_SLAB_OFFSET);
+			const AurieArenaBlockHeader* slab_header = reinterpret_cast<const AurieArenaBlockHeader*>(slab) - 1;
+
+			if (slab_header->SizeClass != AURIE_ARENA_LARGE_BLOCK || slab->Pool != Pool)
+				return AURIE_INVALID_PARAMETER;
+
+			const uintptr_t objects = reinterpret_cast<uintptr_t>(slab + 1);
+			if (object_address < objects)
+				return AURIE_INVALID_PARAMETER;
+
+			const uintptr_t object_offset = object_address - objects;
+			if (object_offset % Pool->ObjectSize || object_offset / Pool->ObjectSize >= Pool->ObjectsPerSlab)
+				return AURIE_INVALID_PARAMETER;
+		}
+
+		AurieExclusiveLock pool_lock(Pool->Lock);
+
+		AurieArenaFreeBlock* object = reinterpret_cast<AurieArenaFreeBlock*>(Object);
+		object->Next = Pool->FreeObjects;
+		Pool->FreeObjects = object;
+
+		return AURIE_SUCCESS;
+	}
+
+	AurieStatus MmQueryMemoryStatistics(
+		IN AurieModule* Module,
+		OUT AurieMemoryStatistics& Statistics
+	)
+	{
+		if (!Module)
+			return AURIE_INVALID_PARAMETER;
+
+		AurieMemoryStatistics& statistics = Module->MemoryArena.Statistics;
+
+		// Each counter is read atomically, but they can be slightly out of sync with each other
+		Statistics.LiveBytes = std::atomic_ref(statistics.LiveBytes).load(std::memory_order_relaxed);
+		Statistics.PeakBytes = std::atomic_ref(statistics.PeakBytes).load(std::memory_order_relaxed);
+		Statistics.LiveAllocations = std::atomic_ref(statistics.LiveAllocations).load(std::memory_order_relaxed);
+		Statistics.TotalAllocations = std::atomic_ref(statistics.TotalAllocations).load(std::memory_order_relaxed);
+
+		for (size_t i = 0; i < AURIE_MEMORY_HISTOGRAM_BUCKETS; i++)
+			Statistics.SizeHistogram[i] = std::atomic_ref(statistics.SizeHistogram[i]).load(std::memory_order_relaxed);
+
+		return AURIE_SUCCESS;
+	}
+
+	AurieStatus MmGetScratchAllocator(
+		OUT AurieScratchAllocator*& Allocator
+	)
+	{
+		Allocator = Internal::MmpGetThreadScratchAllocator();
+		return AURIE_SUCCESS;
+	}
+
+	PVOID MmScratchExpand(
+		IN AurieScratchAllocator* Allocator,
+		IN size_t Size,
+		IN size_t Alignment
+	)
+	{
+		if (Alignment & (Alignment - 1) || Alignment > AURIE_ARENA_PAGE_SIZE)
+			return nullptr;
+
+		// Enough for the allocation wherever it ends up inside the chunk
+		const size_t needed_size = sizeof(AurieArenaChunk) + Alignment + Size;
+
+		AurieArenaChunk* current_chunk = reinterpret_cast<AurieArenaChunk*>(Allocator->CurrentChunk);
+		AurieArenaChunk* next_chunk = current_chunk ? current_chunk->Next : reinterpret_cast<AurieArenaChunk*>(Allocator->Chunks);
+
+		// Reuse the chunk we've rewound past if it's big enough, otherwise slot a new one in before it
+		if (!next_chunk || next_chunk->Size < needed_size)
+		{
+			const size_t chunk_size = std::max(AURIE_ARENA_CHUNK_SIZE, (needed_size + AURIE_ARENA_PAGE_SIZE - 1) & ~(AURIE_ARENA_PAGE_SIZE - 1));
+
+			AurieArenaChunk* new_chunk = reinterpret_cast<AurieArenaChunk*>(VirtualAlloc(
+				nullptr,
+				chunk_size,
+				MEM_COMMIT | MEM_RESERVE,
+				PAGE_READWRITE
+			));
+
+			if (!new_chunk)
+				return nullptr;
+
+			new_chunk->Size = chunk_size;
+			new_chunk->Previous = current_chunk;
+			new_chunk->Next = next_chunk;
+
+			if (next_chunk)
+				next_chunk->Previous = new_chunk;
+
+			if (current_chunk)
+				current_chunk->Next = new_chunk;
+			else
+				Allocator->Chunks = new_chunk;
+
+			next_chunk = new_chunk;
+		}
+
+		Allocator->CurrentChunk = next_chunk;
+		Allocator->Cursor = reinterpret_cast<char*>(next_chunk + 1);
+		Allocator->Limit = reinterpret_cast<char*>(next_chunk) + next_chunk->Size;
+
+		const uintptr_t allocation = (reinterpret_cast<uintptr_t>(Allocator->Cursor) + Alignment - 1) & ~(Alignment - 1);
+		Allocator->Cursor = reinterpret_cast<char*>(allocation + Size);
+
+		return reinterpret_cast<PVOID>(allocation);
+	}
+
+	void MmScratchRewind(
+		IN AurieScratchAllocator* Allocator,
+		IN const AurieScratchMark& Mark
+	)
+	{
+		AurieArenaChunk* mark_chunk = reinterpret_cast<AurieArenaChunk*>(Mark.Chunk);
+		char* mark_cursor = Mark.Cursor;
+
+		// The mark was taken before the first chunk existed, so rewind to its start.
+		// That way later marks point into a chunk, and resetting to them stays inline.
+		if (!mark_chunk)
+		{
+			mark_chunk = reinterpret_cast<AurieArenaChunk*>(Allocator->Chunks);
+			mark_cursor = reinterpret_cast<char*>(mark_chunk + 1);
+		}
+
+		if (!mark_chunk)
+			return;
+
+		// Back at the very start means the outermost scope ended, keep one chunk and give the rest back
+		if (mark_chunk == Allocator->Chunks && mark_cursor == reinterpret_cast<char*>(mark_chunk + 1))
+		{
+			AurieArenaChunk* chunk = mark_chunk->Next;
+			while (chunk)
+			{
+				AurieArenaChunk* next_chunk = chunk->Next;
+				VirtualFree(chunk, 0, MEM_RELEASE);
+				chunk = next_chunk;
+			}
+
+			mark_chunk->Next = nullptr;
+		}
+
+		Allocator->CurrentChunk = mark_chunk;
+		Allocator->Cursor = mark_cursor;
+		Allocator->Limit = reinterpret_cast<char*>(mark_chunk) + mark_chunk->Size;
+	}
+
+	namespace Internal
+	{
+		PVOID MmpAllocateMemory(
+			IN const size_t AllocationSize,
+			IN AurieModule* const OwnerModule
+		)
+		{
+			return MmpArenaAllocate(
+				OwnerModule->MemoryArena,
+				AllocationSize
+			);
+		}
+
+		void MmpFreeMemory(
+			IN AurieModule* OwnerModule,
+			IN PVOID AllocationBase
+		)
+		{
+			MmpArenaFree(
+				OwnerModule->MemoryArena,
+				AllocationBase
+			);
+		}
+
+		bool MmpIsAllocatedMemory(
+			IN AurieModule* Module,
+			IN PVOID AllocationBase
+		)
+		{
+			return MmpArenaOwnsBlock(
+				Module->MemoryArena,
+				AllocationBase
+			);
+		}
+
+		// Small blocks cached by the current thread for a single arena
+		struct MmpArenaCacheEntry
+		{
+			AurieArena* Arena;
+			uint64_t ArenaId;
+			AurieArenaFreeBlock* Blocks[AURIE_ARENA_SIZE_CLASSES];
+			uint32_t BlockCount[AURIE_ARENA_SIZE_CLASSES];
+		};
+
+		struct MmpArenaThreadCache
+		{
+			MmpArenaCacheEntry Entries[AURIE_ARENA_CACHE_ARENAS];
+			size_t NextEviction;
+
+			~MmpArenaThreadCache();
+		};
+
+		// Arenas that haven't been released yet, by ID.
+		// Lets a thread tell whether the blocks it caches still point to live memory.
+		static SRWLOCK g_MmpArenaRegistryLock = SRWLOCK_INIT;
+		static std::unordered_map<uint64_t, AurieArena*> g_MmpLiveArenas;
+		static std::atomic<uint64_t> g_MmpNextArenaId = 1;
+
+		// Flushed back to the arenas by its destructor when the thread exits, which relies on DllMain
+		// leaving thread notifications on. Entries of arenas released in the meantime are dropped, see MmpFlushArenaCacheEntry.
+		static thread_local MmpArenaThreadCache g_MmpArenaCache = {};
+
+		// Shared by every arena, a block's header still has to name the arena freeing it.
+		// Leaves are never freed once published.
+		struct MmpChunkMapLeaf
+		{
+			std::atomic<uint64_t> Bits[MMP_CHUNK_MAP_LEAF_CHUNKS / 64];
+		};
+
+		static std::atomic<MmpChunkMapLeaf*> g_MmpChunkMap[MMP_CHUNK_MAP_ROOT_ENTRIES];
+
+		// Scratch chunks are only ever touched by their thread. All but the first are given back
+		// when its outermost scope ends (see MmScratchRewind), the first when the thread exits.
+		struct MmpScratchThreadState
+		{
+			AurieScratchAllocator Allocator;
+
+			~MmpScratchThreadState()
+			{
+				AurieArenaChunk* chunk = reinterpret_cast<AurieArenaChunk*>(Allocator.Chunks);
+				while (chunk)
+				{
+					AurieArenaChunk* next_chunk = chunk->Next;
+					VirtualFree(chunk, 0, MEM_RELEASE);
+					chunk = next_chunk;
+				}
+			}
+		};
+
+		static thread_local MmpScratchThreadState g_MmpScratchAllocator = {};
+
+		AurieScratchAllocator* MmpGetThreadScratchAllocator()
+		{
+			return &g_MmpScratchAllocator.Allocator;
+		}
+
+		// Returns all blocks in a cache entry to its arena, if the arena is still alive
+		static void MmpFlushArenaCacheEntry(
+			IN MmpArenaCacheEntry& Entry
+		)
+		{
+			if (Entry.Arena)
+			{
+				AurieSharedLock registry_lock(g_MmpArenaRegistryLock);
+
+				auto iterator = g_MmpLiveArenas.find(Entry.ArenaId);
+				if (iterator != g_MmpLiveArenas.end() && iterator->second == Entry.Arena)
+				{
+					for (size_t size_class = 0; size_class < AURIE_ARENA_SIZE_CLASSES; size_class++)
+					{
+						MmpArenaDrain(
+							*Entry.Arena,
+							size_class,
+							Entry.Blocks[size_class],
+							Entry.BlockCount[size_class],
+							Entry.BlockCount[size_class]
+						);
+					}
+				}
+			}
+
+			Entry = {};
+		}
+
+		MmpArenaThreadCache::~MmpArenaThreadCache()
+		{
+			for (auto& entry : Entries)
+				MmpFlushArenaCacheEntry(entry);
+		}
+
+		static MmpArenaCacheEntry& MmpGetArenaCacheEntry(
+			IN AurieArena& Arena
+		)
+		{
+			auto& cache = g_MmpArenaCache;
+			MmpArenaCacheEntry* free_entry = nullptr;
+
+			for (auto& entry : cache.Entries)
+			{
+				if (entry.Arena == &Arena && entry.ArenaId == Arena.Id)
+					return entry;
+
+				// Same address but a different ID means the old arena was released along with everything we cached
+				if (entry.Arena == &Arena)
+					entry = {};
+
+				if (!entry.Arena && !free_entry)
+					free_entry = &entry;
+			}
+
+			// All entries are taken, hand the oldest one's blocks back to make room
+			if (!free_entry)
+			{
+				free_entry = &cache.Entries[cache.NextEviction];
+				cache.NextEviction = (cache.NextEviction + 1) % AURIE_ARENA_CACHE_ARENAS;
+
+				MmpFlushArenaCacheEntry(*free_entry);
+			}
+
+			free_entry->Arena = &Arena;
+			free_entry->ArenaId = Arena.Id;
+
+			return *free_entry;
+		}
+
+		PVOID MmpArenaAllocate(
+			IN AurieArena& Arena,
+			IN size_t Size
+		)
+		{
+			// Find the smallest size class the allocation fits in
+			size_t size_class = 0;
+			while (size_class < AURIE_ARENA_SIZE_CLASSES && (size_t(1) << (size_class + AURIE_ARENA_MIN_BLOCK_SHIFT)) < Size)
+				size_class++;
+
+			AurieArenaBlockHeader* header = nullptr;
+
+			// Too big for any size class, give it its own chunk
+			if (size_class == AURIE_ARENA_SIZE_CLASSES)
+			{
+				AurieExclusiveLock arena_lock(Arena.Lock);
+
+				AurieArenaChunk* chunk = MmpArenaAllocateChunk(
+					Arena.LargeChunks,
+					sizeof(AurieArenaChunk) + sizeof(AurieArenaBlockHeader) + Size
+				);
+
+				if (!chunk)
+					return nullptr;
+
+				header = reinterpret_cast<AurieArenaBlockHeader*>(chunk + 1);
+				header->SizeClass = AURIE_ARENA_LARGE_BLOCK;
+			}
+			else
+			{
+				// The common case only touches memory owned by this thread
+				auto& cache_entry = MmpGetArenaCacheEntry(Arena);
+
+				if (!cache_entry.Blocks[size_class])
+				{
+					MmpArenaRefill(
+						Arena,
+						size_class,
+						cache_entry.Blocks[size_class],
+						cache_entry.BlockCount[size_class]
+					);
+
+					if (!cache_entry.Blocks[size_class])
+						return nullptr;
+				}
+
+				AurieArenaFreeBlock* free_block = cache_entry.Blocks[size_class];
+				cache_entry.Blocks[size_class] = free_block->Next;
+				cache_entry.BlockCount[size_class]--;
+
+				header = reinterpret_cast<AurieArenaBlockHeader*>(free_block) - 1;
+			}
+
+			header->Owner = &Arena;
+			header->Canary = MmpArenaGetCanary(header);
+
+			MmpArenaRecordUsage(
+				Arena,
+				std::min<size_t>(size_class, AURIE_MEMORY_HISTOGRAM_BUCKETS - 1),
+				MmpArenaGetBlockSize(header + 1),
+				true
+			);
+
+			return header + 1;
+		}
+
+		void MmpArenaFree(
+			IN AurieArena& Arena,
+			IN PVOID AllocationBase
+		)
+		{
+			AurieArenaBlockHeader* header = reinterpret_cast<AurieArenaBlockHeader*>(AllocationBase) - 1;
+
+			// Over-aligned blocks free the block they were carved from
+			if (header->SizeClass != AURIE_ARENA_LARGE_BLOCK && (header->SizeClass & AURIE_ARENA_OFFSET_BLOCK))
+			{
+				header->Canary = ~MmpArenaGetCanary(header);
+
+				AllocationBase = reinterpret_cast<char*>(AllocationBase) - (header->SizeClass & AURIE_ARENA_OFFSET_MASK);
+				header = reinterpret_cast<AurieArenaBlockHeader*>(AllocationBase) - 1;
+			}
+
+			MmpArenaRecordUsage(
+				Arena,
+				std::min<size_t>(header->SizeClass, AURIE_MEMORY_HISTOGRAM_BUCKETS - 1),
+				MmpArenaGetBlockSize(AllocationBase),
+				false
+			);
+
+			// Small blocks go into this thread's cache, marked as dead so they can't be freed twice
+			if (header->SizeClass != AURIE_ARENA_LARGE_BLOCK)
+			{
+				const size_t size_class = header->SizeClass;
+				header->Canary = ~MmpArenaGetCanary(header);
+
+				auto& cache_entry = MmpGetArenaCacheEntry(Arena);
+
+				AurieArenaFreeBlock* free_block = reinterpret_cast<AurieArenaFreeBlock*>(AllocationBase);
+				free_block->Next = cache_entry.Blocks[size_class];
+				cache_entry.Blocks[size_class] = free_block;
+				cache_entry.BlockCount[size_class]++;
+
+				// Don't let one thread hoard blocks another thread might need
+				if (cache_entry.BlockCount[size_class] > AURIE_ARENA_CACHE_DEPTH)
+				{
+					MmpArenaDrain(
+						Arena,
+						size_class,
+						cache_entry.Blocks[size_class],
+						cache_entry.BlockCount[size_class],
+						AURIE_ARENA_CACHE_BATCH
+					);
+				}
+
+				return;
+			}
+
+			// Large blocks own their chunk, unlink it and give it back to the OS
+			AurieArenaChunk* chunk = reinterpret_cast<AurieArenaChunk*>(header) - 1;
+
+			{
+				AurieExclusiveLock arena_lock(Arena.Lock);
+
+				// From here on, freeing the block again fails MmpArenaOwnsBlock
+				MmpSetArenaChunk(reinterpret_cast<uintptr_t>(chunk), false);
+
+				if (chunk->Previous)
+					chunk->Previous->Next = chunk->Next;
+				else
+					Arena.LargeChunks = chunk->Next;
+
+				if (chunk->Next)
+					chunk->Next->Previous = chunk->Previous;
+			}
+
+			// MmpArenaOwnsBlock may still be reading the header on another thread, it doesn't lock
+			ObpRcuRetire(
+				chunk,
+				[](const void* Chunk)
+				{
+					VirtualFree(const_cast<void*>(Chunk), 0, MEM_RELEASE);
+				}
+			);
+		}
+
+		void MmpArenaRefill(
+			IN AurieArena& Arena,
+			IN size_t SizeClass,
+			IN OUT AurieArenaFreeBlock*& Blocks,
+			IN OUT uint32_t& BlockCount
+		)
+		{
+			const size_t block_size = size_t(1) << (SizeClass + AURIE_ARENA_MIN_BLOCK_SHIFT);
+
+			AurieExclusiveLock arena_lock(Arena.Lock);
+
+			for (size_t i = 0; i < AURIE_ARENA_CACHE_BATCH; i++)
+			{
+				AurieArenaFreeBlock* free_block = Arena.FreeLists[SizeClass];
+
+				// Prefer blocks that were freed before
+				if (free_block)
+				{
+					Arena.FreeLists[SizeClass] = free_block->Next;
+				}
+				else
+				{
+					// Start a new chunk if the current one is out of space.
+					// Whatever is left at the end of the old chunk is abandoned until the arena is released.
+					if (static_cast<size_t>(Arena.Limit - Arena.Cursor) < sizeof(AurieArenaBlockHeader) + block_size)
+					{
+						// Don't grow the arena just to fill the cache
+						if (BlockCount)
+							break;
+
+						AurieArenaChunk* chunk = MmpArenaAllocateChunk(
+							Arena.Chunks,
+							AURIE_ARENA_CHUNK_SIZE
+						);
+
+						if (!chunk)
+							break;
+
+						Arena.Cursor = reinterpret_cast<char*>(chunk + 1);
+						Arena.Limit = reinterpret_cast<char*>(chunk) + chunk->Size;
+					}
+
+					AurieArenaBlockHeader* header = reinterpret_cast<AurieArenaBlockHeader*>(Arena.Cursor);
+					header->Owner = &Arena;
+					header->SizeClass = static_cast<uint32_t>(SizeClass);
+					header->Canary = ~MmpArenaGetCanary(header);
+
+					Arena.Cursor += sizeof(AurieArenaBlockHeader) + block_size;
+					free_block = reinterpret_cast<AurieArenaFreeBlock*>(header + 1);
+				}
+
+				free_block->Next = Blocks;
+				Blocks = free_block;
+				BlockCount++;
+			}
+		}
+
+		void MmpArenaDrain(
+			IN AurieArena& Arena,
+			IN size_t SizeClass,
+			IN OUT AurieArenaFreeBlock*& Blocks,
+			IN OUT uint32_t& BlockCount,
+			IN uint32_t DrainCount
+		)
+		{
+			if (!DrainCount)
+				return;
+
+			AurieExclusiveLock arena_lock(Arena.Lock);
+
+			for (uint32_t i = 0; i < DrainCount && Blocks; i++)
+			{
+				AurieArenaFreeBlock* free_block = Blocks;
+				Blocks = free_block->Next;
+				BlockCount--;
+
+				free_block->Next = Arena.FreeLists[SizeClass];
+				Arena.FreeLists[SizeClass] = free_block;
+			}
+		}
+
+		PVOID MmpArenaAllocateAligned(
+			IN AurieArena& Arena,
+			IN size_t Size,
+			IN size_t Alignment
+		)
+		{
+			// Worst case, the aligned address is a whole alignment past the start of the block
+			char* outer_block = reinterpret_cast<char*>(MmpArenaAllocate(
+				Arena,
+				Size + Alignment
+			));
+
+			if (!outer_block)
+				return nullptr;
+
+			// Leave room for the inner header, which tells MmFreeMemory where the real block starts.
+			// It's needed even if the block happens to be aligned already, as it also remembers the alignment.
+			char* aligned_block = reinterpret_cast<char*>(
+				(reinterpret_cast<uintptr_t>(outer_block) + sizeof(AurieArenaBlockHeader) + Alignment - 1) & ~(Alignment - 1)
+			);
+
+			AurieArenaBlockHeader* header = reinterpret_cast<AurieArenaBlockHeader*>(aligned_block) - 1;
+			header->Owner = &Arena;
+			header->SizeClass = AURIE_ARENA_OFFSET_BLOCK
+				| (static_cast<uint32_t>(std::countr_zero(Alignment)) << AURIE_ARENA_ALIGNMENT_SHIFT)
+				| static_cast<uint32_t>(aligned_block - outer_block);
+			header->Canary = MmpArenaGetCanary(header);
+
+			return aligned_block;
+		}
+
+		void MmpArenaRecordUsage(
+			IN AurieArena& Arena,
+			IN size_t HistogramBucket,
+			IN size_t BlockSize,
+			IN bool Allocated
+		)
+		{
+			AurieMemoryStatistics& statistics = Arena.Statistics;
+
+			if (Allocated)
+			{
+				const uint64_t live_bytes = std::atomic_ref(statistics.LiveBytes).fetch_add(BlockSize, std::memory_order_relaxed) + BlockSize;
+				std::atomic_ref(statistics.LiveAllocations).fetch_add(1, std::memory_order_relaxed);
+				std::atomic_ref(statistics.TotalAllocations).fetch_add(1, std::memory_order_relaxed);
+				std::atomic_ref(statistics.SizeHistogram[HistogramBucket]).fetch_add(1, std::memory_order_relaxed);
+
+				// Raise the peak if we're above it, another thread might be doing the same
+				std::atomic_ref peak_bytes(statistics.PeakBytes);
+				uint64_t current_peak = peak_bytes.load(std::memory_order_relaxed);
+				while (live_bytes > current_peak && !peak_bytes.compare_exchange_weak(current_peak, live_bytes, std::memory_order_relaxed));
+
+				return;
+			}
+
+			std::atomic_ref(statistics.LiveBytes).fetch_sub(BlockSize, std::memory_order_relaxed);
+			std::atomic_ref(statistics.LiveAllocations).fetch_sub(1, std::memory_order_relaxed);
+			std::atomic_ref(statistics.SizeHistogram[HistogramBucket]).fetch_sub(1, std::memory_order_relaxed);
+		}
+
+		size_t MmpArenaGetBlockSize(
+			IN PVOID AllocationBase
+		)
+		{
+			const AurieArenaBlockHeader* header = reinterpret_cast<const AurieArenaBlockHeader*>(AllocationBase) - 1;
+
+			if (header->SizeClass == AURIE_ARENA_LARGE_BLOCK)
+			{
+				const AurieArenaChunk* chunk = reinterpret_cast<const AurieArenaChunk*>(header) - 1;
+				return chunk->Size - sizeof(AurieArenaChunk) - sizeof(AurieArenaBlockHeader);
+			}
+
+			if (header->SizeClass & AURIE_ARENA_OFFSET_BLOCK)
+			{
+				const uint32_t offset = header->SizeClass & AURIE_ARENA_OFFSET_MASK;
+				return MmpArenaGetBlockSize(reinterpret_cast<char*>(AllocationBase) - offset) - offset;
+			}
+
+			return size_t(1) << (header->SizeClass + AURIE_ARENA_MIN_BLOCK_SHIFT);
+		}
+
+		size_t MmpArenaGetBlockAlignment(
+			IN PVOID AllocationBase
+		)
+		{
+			const AurieArenaBlockHeader* header = reinterpret_cast<const AurieArenaBlockHeader*>(AllocationBase) - 1;
+
+			if (header->SizeClass == AURIE_ARENA_LARGE_BLOCK || !(header->SizeClass & AURIE_ARENA_OFFSET_BLOCK))
+				return alignof(AurieArenaBlockHeader);
+
+			return size_t(1) << ((header->SizeClass & ~AURIE_ARENA_OFFSET_BLOCK) >> AURIE_ARENA_ALIGNMENT_SHIFT);
+		}
+
+		bool MmpArenaOwnsBlock(
+			IN AurieArena& Arena,
+			IN PVOID AllocationBase
+		)
+		{
+			const uintptr_t block_address = reinterpret_cast<uintptr_t>(AllocationBase);
+
+			// Blocks are 16-byte aligned, anything else can't have come from us
+			if (!AllocationBase || block_address % alignof(AurieArenaBlockHeader))
+				return false;
+
+			// Every block starts in the first AURIE_ARENA_CHUNK_SIZE bytes of its chunk, see there.
+			const uintptr_t chunk_base = block_address & ~(AURIE_ARENA_CHUNK_SIZE - 1);
+
+			// Keeps large chunks from being released while we look at them, see MmpArenaFree
+			AurieRcuReadGuard rcu_guard;
+
+			if (!MmpIsArenaChunk(chunk_base))
+				return false;
+
+			// The header has to lie past the chunk's own header, and the block has to start inside the chunk
+			const AurieArenaChunk* chunk = reinterpret_cast<const AurieArenaChunk*>(chunk_base);
+			if (block_address < chunk_base + sizeof(AurieArenaChunk) + sizeof(AurieArenaBlockHeader) || block_address >= chunk_base + chunk->Size)
+				return false;
+
+			const AurieArenaBlockHeader* header = reinterpret_cast<const AurieArenaBlockHeader*>(AllocationBase) - 1;
+
+			return header->Owner == &Arena && header->Canary == MmpArenaGetCanary(header);
+		}
+
+		void MmpInitializeArena(
+			IN AurieArena& Arena
+		)
+		{
+			AurieExclusiveLock registry_lock(g_MmpArenaRegistryLock);
+
+			Arena.Id = g_MmpNextArenaId.fetch_add(1, std::memory_order_relaxed);
+			g_MmpLiveArenas.emplace(Arena.Id, &Arena);
+		}
+
+		void MmpReleaseArena(
+			IN AurieArena& Arena
+		)
+		{
+			// Once the arena is out of the registry, no thread will try to flush its cache into it
+			AurieExclusiveLock registry_lock(g_MmpArenaRegistryLock);
+			g_MmpLiveArenas.erase(Arena.Id);
+
+			for (AurieArenaChunk* chunk_list : { Arena.Chunks, Arena.LargeChunks })
+			{
+				while (chunk_list)
+				{
+					AurieArenaChunk* next_chunk = chunk_list->Next;
+					MmpSetArenaChunk(reinterpret_cast<uintptr_t>(chunk_list), false);
+					VirtualFree(chunk_list, 0, MEM_RELEASE);
+					chunk_list = next_chunk;
+				}
+			}
+
+			Arena = {};
+		}
+
+		AurieArenaChunk* MmpArenaAllocateChunk(
+			IN OUT AurieArenaChunk*& ChunkList,
+			IN size_t Size
+		)
+		{
+			// VirtualAlloc commits whole pages anyway, let large blocks grow into the rest of theirs
+			Size = (Size + AURIE_ARENA_PAGE_SIZE - 1) & ~(AURIE_ARENA_PAGE_SIZE - 1);
+
+			AurieArenaChunk* chunk = reinterpret_cast<AurieArenaChunk*>(VirtualAlloc(
+				nullptr,
+				Size,
+				MEM_COMMIT | MEM_RESERVE,
+				PAGE_READWRITE
+			));
+
+			if (!chunk)
+				return nullptr;
+
+			chunk->Next = ChunkList;
+			chunk->Previous = nullptr;
+			chunk->Size = Size;
+
+			// Publishes the header above to MmpArenaOwnsBlock
+			if (!MmpSetArenaChunk(reinterpret_cast<uintptr_t>(chunk), true))
+			{
+				VirtualFree(chunk, 0, MEM_RELEASE);
+				return nullptr;
+			}
+
+			if (ChunkList)
+				ChunkList->Previous = chunk;
+
+			ChunkList = chunk;
+
+			return chunk;
+		}
+
+		// Finds the word holding ChunkBase's bit, allocating the leaf it's in if asked to
+		static std::atomic<uint64_t>* MmpGetChunkMapWord(
+			IN uintptr_t ChunkBase,
+			IN bool CreateLeaf
+		)
+		{
+			const uint64_t chunk_index = static_cast<uint64_t>(ChunkBase) / AURIE_ARENA_CHUNK_SIZE;
+			const uint64_t root_index = chunk_index / MMP_CHUNK_MAP_LEAF_CHUNKS;
+
+			// Past the end of user-mode address space, no chunk can start there
+			if (root_index >= MMP_CHUNK_MAP_ROOT_ENTRIES)
+				return nullptr;
+
+			MmpChunkMapLeaf* leaf = g_MmpChunkMap[root_index].load(std::memory_order_acquire);
+			if (!leaf && CreateLeaf)
+			{
+				PVOID leaf_memory = VirtualAlloc(
+					nullptr,
+					sizeof(MmpChunkMapLeaf),
+					MEM_COMMIT | MEM_RESERVE,
+					PAGE_READWRITE
+				);
+
+				if (!leaf_memory)
+					return nullptr;
+
+				MmpChunkMapLeaf* new_leaf = new (leaf_memory) MmpChunkMapLeaf();
+
+				// Another thread may have put one there in the meantime
+				if (g_MmpChunkMap[root_index].compare_exchange_strong(leaf, new_leaf, std::memory_order_acq_rel))
+					leaf = new_leaf;
+				else
+					VirtualFree(leaf_memory, 0, MEM_RELEASE);
+			}
+
+			if (!leaf)
+				return nullptr;
+
+			return &leaf->Bits[(chunk_index % MMP_CHUNK_MAP_LEAF_CHUNKS) / 64];
+		}
+
+		bool MmpSetArenaChunk(
+			IN uintptr_t ChunkBase,
+			IN bool IsArenaChunk
+		)
+		{
+			std::atomic<uint64_t>* map_word = MmpGetChunkMapWord(ChunkBase, IsArenaChunk);
+			if (!map_word)
+				return !IsArenaChunk;
+
+			const uint64_t chunk_bit = uint64_t(1) << ((ChunkBase / AURIE_ARENA_CHUNK_SIZE) % 64);
+
+			// Other arenas may be flipping bits in the same word
+			if (IsArenaChunk)
+				map_word->fetch_or(chunk_bit, std::memory_order_release);
+			else
+				map_word->fetch_and(~chunk_bit, std::memory_order_release);
+
+			return true;
+		}
+
+		bool MmpIsArenaChunk(
+			IN uintptr_t ChunkBase
+		)
+		{
+			std::atomic<uint64_t>* map_word = MmpGetChunkMapWord(ChunkBase, false);
+			if (!map_word)
+				return false;
+
+			const uint64_t chunk_bit = uint64_t(1) << ((ChunkBase / AURIE_ARENA_CHUNK_SIZE) % 64);
+			return map_word->load(std::memory_order_acquire) & chunk_bit;
+		}
+
+		uint32_t MmpArenaGetCanary(
+			IN const AurieArenaBlockHeader* Header
+		)
+		{
+			return AURIE_ARENA_CANARY ^ static_cast<uint32_t>(reinterpret_cast<uintptr_t>(Header) >> 4);
+		}
+	}
+}
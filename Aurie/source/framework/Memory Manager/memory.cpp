@@ -1,70 +1,17 @@
 #include "memory.hpp"
+#include <cwchar>
+#include <fstream>
 
 namespace Aurie
 {
-	PVOID MmAllocatePersistentMemory(
-		IN size_t Size
-	)
-	{
-		return MmAllocateMemory(
-			g_ArInitialImage,
-			Size
-		);
-	}
-
-	PVOID MmAllocateMemory(
-		IN AurieModule* Owner,
-		IN size_t Size
-	)
-	{
-		AurieMemoryAllocation allocation = Internal::MmpAllocateMemory(
-			Size,
-			Owner
-		);
-
-		Internal::MmpAddAllocationToTable(allocation);
-
-		return allocation.AllocationBase;
-	}
-
-	AurieStatus MmFreePersistentMemory(
-		IN PVOID AllocationBase
-	)
-	{
-		return MmFreeMemory(
-			g_ArInitialImage, 
-			AllocationBase
-		);
-	}
-
-	AurieStatus MmFreeMemory(
-		IN AurieModule* Owner, 
-		IN PVOID AllocationBase
-	)
-	{
-		if (!Internal::MmpIsAllocatedMemory(
-			Owner,
-			AllocationBase
-		))
-		{
-			return AURIE_INVALID_PARAMETER;
-		}
-
-		Internal::MmpFreeMemory(
-			Owner,
-			AllocationBase,
-			true
-		);
-
-		return AURIE_SUCCESS;
-	}
-
 	size_t MmSigscanModule(
 		IN const wchar_t* ModuleName,
 		IN const unsigned char* Pattern,
 		IN const char* PatternMask
 	)
 	{
+		Internal::MmpTraceSpan trace_span("SigscanModule");
+
 		// Capture the module we're searching for
 		HMODULE module_handle = GetModuleHandleW(ModuleName);
 		if (!module_handle)
@@ -128,9 +75,36 @@ namespace Aurie
 		OUT OPTIONAL PVOID* Trampoline
 	)
 	{
+		return MmCreateHookEx(
+			Module,
+			HookIdentifier,
+			SourceFunction,
+			DestinationFunction,
+			Trampoline,
+			AURIE_HOOK_FLAGS_NONE
+		);
+	}
+
+	AurieStatus MmCreateHookEx(
+		IN AurieModule* Module,
+		IN std::string_view HookIdentifier,
+		IN PVOID SourceFunction,
+		IN PVOID DestinationFunction,
+		OUT OPTIONAL PVOID* Trampoline,
+		IN AurieHookFlags Flags
+	)
+	{
+		Internal::MmpTraceSpan trace_span("CreateHook", HookIdentifier);
+
 		if (AurieSuccess(MmHookExists(Module, HookIdentifier)))
 			return AURIE_OBJECT_ALREADY_EXISTS;
 
+#ifndef _WIN64
+		// The instrumentation thunks are only written for x64
+		if (Flags & AURIE_HOOK_INSTRUMENTED)
+			return AURIE_NOT_IMPLEMENTED;
+#endif // _WIN64
+
 		Internal::MmpFreezeCurrentProcess();
 
 		// Creates and enables the actual hook
@@ -138,7 +112,8 @@ namespace Aurie
 			Module,
 			HookIdentifier,
 			SourceFunction,
-			DestinationFunction
+			DestinationFunction,
+			Flags
 		);
 
 		if (!created_hook)
@@ -186,6 +161,16 @@ namespace Aurie
 			);
 		}
 
+		if (!AurieSuccess(last_status))
+		{
+			AurieVmtHook* vmt_hook_object = nullptr;
+			last_status = Internal::MmpLookupVmtHookByName(
+				Module,
+				HookIdentifier,
+				vmt_hook_object
+			);
+		}
+
 		return last_status;
 	}
 
@@ -208,6 +193,7 @@ namespace Aurie
 		IN std::string_view HookIdentifier
 	)
 	{
+		AurieRcuReadGuard rcu_guard;
 		AurieInlineHook* hook_object = nullptr;
 
 		AurieStatus last_status = Internal::MmpLookupInlineHookByName(
@@ -245,9 +231,34 @@ namespace Aurie
 		IN AurieMidHookFunction TargetHandler
 	)
 	{
+		return MmCreateMidfunctionHookEx(
+			Module,
+			HookIdentifier,
+			SourceAddress,
+			TargetHandler,
+			AURIE_HOOK_FLAGS_NONE
+		);
+	}
+
+	AurieStatus MmCreateMidfunctionHookEx(
+		IN AurieModule* Module,
+		IN std::string_view HookIdentifier,
+		IN PVOID SourceAddress,
+		IN AurieMidHookFunction TargetHandler,
+		IN AurieHookFlags Flags
+	)
+	{
+		Internal::MmpTraceSpan trace_span("CreateMidfunctionHook", HookIdentifier);
+
 		if (AurieSuccess(MmHookExists(Module, HookIdentifier)))
 			return AURIE_OBJECT_ALREADY_EXISTS;
 
+#ifndef _WIN64
+		// The instrumentation thunks are only written for x64
+		if (Flags & AURIE_HOOK_INSTRUMENTED)
+			return AURIE_NOT_IMPLEMENTED;
+#endif // _WIN64
+
 		Internal::MmpFreezeCurrentProcess();
 
 		// Creates and enables the actual hook
@@ -255,7 +266,8 @@ namespace Aurie
 			Module,
 			HookIdentifier,
 			SourceAddress,
-			TargetHandler
+			TargetHandler,
+			Flags
 		);
 
 		Internal::MmpResumeCurrentProcess();
@@ -270,69 +282,363 @@ namespace Aurie
 		return AURIE_SUCCESS;
 	}
 
-	namespace Internal
+	AurieStatus MmCreateLightMidfunctionHook(
+		IN AurieModule* Module,
+		IN std::string_view HookIdentifier,
+		IN PVOID SourceAddress,
+		IN AurieMidHookFunction TargetHandler,
+		IN AurieMidHookRegisters Registers,
+		IN AurieHookFlags Flags
+	)
 	{
-		AurieMemoryAllocation MmpAllocateMemory(
-			IN const size_t AllocationSize,
-			IN AurieModule* const OwnerModule
-		)
+		Internal::MmpTraceSpan trace_span("CreateLightMidfunctionHook", HookIdentifier);
+
+		if (AurieSuccess(MmHookExists(Module, HookIdentifier)))
+			return AURIE_OBJECT_ALREADY_EXISTS;
+
+#ifndef _WIN64
+		// The instrumentation thunks are only written for x64
+		if (Flags & AURIE_HOOK_INSTRUMENTED)
+			return AURIE_NOT_IMPLEMENTED;
+#endif // _WIN64
+
+		Internal::MmpFreezeCurrentProcess();
+
+		AurieMidHook* created_hook = Internal::MmpCreateLightMidHook(
+			Module,
+			HookIdentifier,
+			SourceAddress,
+			TargetHandler,
+			Registers,
+			Flags
+		);
+
+		Internal::MmpResumeCurrentProcess();
+
+		if (!created_hook)
+			return AURIE_INSUFFICIENT_MEMORY;
+
+		// If the hook is invalid, we're probably passing invalid parameters to it.
+		if (!created_hook->IsActive())
+			return AURIE_INVALID_PARAMETER;
+
+		return AURIE_SUCCESS;
+	}
+
+	AurieStatus MmCreateVmtHook(
+		IN AurieModule* Module,
+		IN std::string_view HookIdentifier,
+		IN PVOID Object
+	)
+	{
+		Internal::MmpTraceSpan trace_span("CreateVmtHook", HookIdentifier);
+
+		if (!Object)
+			return AURIE_INVALID_PARAMETER;
+
+		if (AurieSuccess(MmHookExists(Module, HookIdentifier)))
+			return AURIE_OBJECT_ALREADY_EXISTS;
+
+		// Counted the same way SafetyHook sizes the clone, every pointer up to the first non-executable one
+		uint8_t** original_vmt = *reinterpret_cast<uint8_t***>(Object);
+		size_t method_count = 0;
+		while (safetyhook::is_executable(original_vmt[method_count]))
+			method_count++;
+
+		// Cloning the VMT only writes to the object itself, no need to freeze anything
+		auto vmt_hook = safetyhook::VmtHook::create(Object);
+		if (!vmt_hook)
+			return AURIE_INSUFFICIENT_MEMORY;
+
+		AurieVmtHook hook = {};
+		hook.Owner = Module;
+		hook.Identifier = HookIdentifier;
+		hook.HookInstance = std::move(*vmt_hook);
+		hook.MethodCount = method_count;
+
+		Internal::MmpAddVmtHookToTable(
+			Module,
+			std::move(hook)
+		);
+
+		return AURIE_SUCCESS;
+	}
+
+	AurieStatus MmApplyVmtHook(
+		IN AurieModule* Module,
+		IN std::string_view HookIdentifier,
+		IN PVOID Object
+	)
+	{
+		if (!Object)
+			return AURIE_INVALID_PARAMETER;
+
+		AurieRcuReadGuard rcu_guard;
+
+		AurieVmtHook* hook_object = nullptr;
+		AurieStatus last_status = Internal::MmpLookupVmtHookByName(
+			Module,
+			HookIdentifier,
+			hook_object
+		);
+
+		if (!AurieSuccess(last_status))
+			return last_status;
+
+		// SafetyHook keeps track of the objects in a map of its own
+		AurieExclusiveLock hook_table_lock(Module->HookTableLock);
+
+		hook_object->HookInstance.apply(Object);
+		return AURIE_SUCCESS;
+	}
+
+	AurieStatus MmHookVirtualMethod(
+		IN AurieModule* Module,
+		IN std::string_view HookIdentifier,
+		IN size_t MethodIndex,
+		IN PVOID DestinationFunction,
+		OUT OPTIONAL PVOID* OriginalMethod
+	)
+	{
+		if (!DestinationFunction)
+			return AURIE_INVALID_PARAMETER;
+
+		AurieRcuReadGuard rcu_guard;
+
+		AurieVmtHook* hook_object = nullptr;
+		AurieStatus last_status = Internal::MmpLookupVmtHookByName(
+			Module,
+			HookIdentifier,
+			hook_object
+		);
+
+		if (!AurieSuccess(last_status))
+			return last_status;
+
+		// Other threads may hook methods of the same VMT, or remove it
+		AurieExclusiveLock hook_table_lock(Module->HookTableLock);
+
+		// hook_method would write past the end of the clone, the count is zero once the hook is removed
+		if (MethodIndex >= hook_object->MethodCount)
+			return AURIE_INVALID_PARAMETER;
+
+		// Each slot in the cloned VMT can only be hooked once
+		if (hook_object->MethodHooks.contains(MethodIndex))
+			return AURIE_OBJECT_ALREADY_EXISTS;
+
+		// This is a single pointer write into our own copy of the VMT
+		auto method_hook = hook_object->HookInstance.hook_method(MethodIndex, DestinationFunction);
+		if (!method_hook)
+			return AURIE_EXTERNAL_ERROR;
+
+		if (OriginalMethod)
+			*OriginalMethod = method_hook->original<PVOID>();
+
+		hook_object->MethodHooks.emplace(MethodIndex, std::move(*method_hook));
+		return AURIE_SUCCESS;
+	}
+
+	void MmDumpMemoryStatistics(
+		IN OPTIONAL AurieModule* Module
+	)
+	{
+		AurieRcuReadGuard rcu_guard;
+
+		const Internal::MdpModuleSnapshot* module_snapshot = Internal::g_LdrModuleSnapshot.Load();
+		if (!module_snapshot)
+			return;
+
+		for (AurieModule* module : module_snapshot->Modules)
 		{
-			AurieMemoryAllocation allocation;
-			allocation.AllocationBase = reinterpret_cast<void*>(new char[AllocationSize]);
-			allocation.AllocationSize = AllocationSize;
-			allocation.OwnerModule = OwnerModule;
+			if (Module && Module != module)
+				continue;
 
-			return allocation;
+			AurieMemoryStatistics statistics = {};
+			MmQueryMemoryStatistics(module, statistics);
+
+			wchar_t line[512] = {};
+			size_t length = 0;
+
+			auto append = [&](const wchar_t* Format, auto... Arguments)
+			{
+				int written = swprintf(line + length, std::size(line) - length, Format, Arguments...);
+				if (written > 0)
+					length = std::min(length + written, std::size(line) - 1);
+			};
+
+			append(
+				L"[Aurie] %ls: %llu live bytes (peak %llu) in %llu blocks, %llu allocated in total |",
+				module->ImagePath.filename().wstring().c_str(),
+				statistics.LiveBytes,
+				statistics.PeakBytes,
+				statistics.LiveAllocations,
+				statistics.TotalAllocations
+			);
+
+			for (size_t i = 0; i + 1 < AURIE_MEMORY_HISTOGRAM_BUCKETS; i++)
+				append(L" <=%llu: %llu", 16ull << i, statistics.SizeHistogram[i]);
+
+			append(L" larger: %llu\n", statistics.SizeHistogram[AURIE_MEMORY_HISTOGRAM_BUCKETS - 1]);
+
+			OutputDebugStringW(line);
 		}
+	}
 
-		AurieStatus MmpVerifyCallback(
-			IN HMODULE Module,
-			IN PVOID CallbackRoutine
-		)
+	AurieStatus MmQueryHookStatistics(
+		IN AurieModule* Module,
+		IN std::string_view HookIdentifier,
+		OUT AurieHookStatistics& Statistics
+	)
+	{
+		AurieRcuReadGuard rcu_guard;
+
+		AurieHookCounters* counters = nullptr;
+		AurieStatus last_status = Internal::MmpLookupHookCounters(
+			Module,
+			HookIdentifier,
+			counters
+		);
+
+		if (!AurieSuccess(last_status))
+			return last_status;
+
+		// Counters keep moving while we read them, the sum is only a snapshot
+		AurieHookStatistics statistics = {};
+		for (const auto& slot : counters->Slots)
 		{
-			if (CallbackRoutine && Module)
-				return AURIE_SUCCESS;
+			statistics.CallCount += slot.CallCount.load(std::memory_order_relaxed);
+			statistics.CycleCount += slot.CycleCount.load(std::memory_order_relaxed);
+		}
 
-			return AURIE_ACCESS_DENIED;
+		Statistics = statistics;
+		return AURIE_SUCCESS;
+	}
+
+	AurieStatus MmResetHookStatistics(
+		IN AurieModule* Module,
+		IN std::string_view HookIdentifier
+	)
+	{
+		AurieRcuReadGuard rcu_guard;
+
+		AurieHookCounters* counters = nullptr;
+		AurieStatus last_status = Internal::MmpLookupHookCounters(
+			Module,
+			HookIdentifier,
+			counters
+		);
+
+		if (!AurieSuccess(last_status))
+			return last_status;
+
+		for (auto& slot : counters->Slots)
+		{
+			slot.CallCount.store(0, std::memory_order_relaxed);
+			slot.CycleCount.store(0, std::memory_order_relaxed);
 		}
 
-		void MmpFreeMemory(
-			IN AurieModule* OwnerModule,
-			IN PVOID AllocationBase,
-			IN bool RemoveTableEntry
-		)
+		return AURIE_SUCCESS;
+	}
+
+	AurieStatus MmWriteTrace(
+		IN const fs::path& TracePath
+	)
+	{
+		LARGE_INTEGER frequency = {};
+		LARGE_INTEGER current_ticks = {};
+		QueryPerformanceFrequency(&frequency);
+		QueryPerformanceCounter(&current_ticks);
+
+		uint32_t claimed_count = Internal::g_MmTraceEventCount.load(std::memory_order_acquire);
+		uint32_t event_count = std::min(claimed_count, Internal::MMP_TRACE_CAPACITY);
+
+		// Timestamps start at the earliest span, the viewers don't care where zero is
+		int64_t origin_ticks = current_ticks.QuadPart;
+		for (uint32_t i = 0; i < event_count; i++)
+		{
+			int64_t start_ticks = Internal::g_MmTraceEvents[i].StartTicks.load(std::memory_order_acquire);
+			if (start_ticks)
+				origin_ticks = std::min(origin_ticks, start_ticks);
+		}
+
+		auto to_microseconds = [&frequency](int64_t Ticks) -> double
+		{
+			return static_cast<double>(Ticks) * 1000000.0 / static_cast<double>(frequency.QuadPart);
+		};
+
+		std::string trace_json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+		bool is_first_event = true;
+
+		for (uint32_t i = 0; i < event_count; i++)
 		{
-			if (RemoveTableEntry)
+			const Internal::MmpTraceEvent& trace_event = Internal::g_MmTraceEvents[i];
+
+			// Claimed, but the thread hasn't gotten to filling it in yet
+			int64_t start_ticks = trace_event.StartTicks.load(std::memory_order_acquire);
+			if (!start_ticks)
+				continue;
+
+			int64_t end_ticks = trace_event.EndTicks.load(std::memory_order_acquire);
+			if (!end_ticks)
+				end_ticks = current_ticks.QuadPart;
+
+			if (!is_first_event)
+				trace_json.push_back(',');
+
+			is_first_event = false;
+
+			trace_json += "{\"name\":";
+			Internal::MmpAppendJsonString(trace_event.Name, trace_json);
+
+			char event_fields[160] = {};
+			snprintf(
+				event_fields,
+				std::size(event_fields),
+				",\"cat\":\"aurie\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%lu,\"tid\":%lu",
+				to_microseconds(start_ticks - origin_ticks),
+				to_microseconds(end_ticks - start_ticks),
+				static_cast<unsigned long>(GetCurrentProcessId()),
+				static_cast<unsigned long>(trace_event.ThreadId)
+			);
+
+			trace_json += event_fields;
+
+			if (trace_event.Detail[0])
 			{
-				MmpRemoveAllocationsFromTable(
-					OwnerModule,
-					AllocationBase
-				);
+				trace_json += ",\"args\":{\"detail\":";
+				Internal::MmpAppendJsonString(trace_event.Detail, trace_json);
+				trace_json.push_back('}');
 			}
 
-			delete[] AllocationBase;
+			trace_json.push_back('}');
 		}
 
-		AurieMemoryAllocation* MmpAddAllocationToTable(
-			IN const AurieMemoryAllocation& Allocation
-		)
-		{
-			return &Allocation.OwnerModule->MemoryAllocations.emplace_back(Allocation);
-		}
+		trace_json += "],\"otherData\":{\"droppedSpans\":";
+		trace_json += std::to_string(claimed_count - event_count);
+		trace_json += "}}";
 
-		bool MmpIsAllocatedMemory(
-			IN AurieModule* Module,
-			IN PVOID AllocationBase
+		std::ofstream trace_file(TracePath, std::ios::binary | std::ios::trunc);
+		if (!trace_file.is_open())
+			return AURIE_ACCESS_DENIED;
+
+		trace_file.write(trace_json.data(), trace_json.size());
+		if (!trace_file.good())
+			return AURIE_EXTERNAL_ERROR;
+
+		return AURIE_SUCCESS;
+	}
+
+	namespace Internal
+	{
+		AurieStatus MmpVerifyCallback(
+			IN HMODULE Module,
+			IN PVOID CallbackRoutine
 		)
 		{
-			return std::find_if(
-				Module->MemoryAllocations.begin(),
-				Module->MemoryAllocations.end(),
-				[AllocationBase](const AurieMemoryAllocation& Allocation) -> bool
-				{
-					return Allocation.AllocationBase == AllocationBase;
-				}
-			) != Module->MemoryAllocations.end();
+			if (CallbackRoutine && Module)
+				return AURIE_SUCCESS;
+
+			return AURIE_ACCESS_DENIED;
 		}
 
 		AurieStatus MmpSigscanRegion(
@@ -343,6 +649,8 @@ namespace Aurie
 			OUT uintptr_t& PatternBase
 		)
 		{
+			MmpTraceSpan trace_span("Sigscan");
+
 			size_t pattern_size = strlen(PatternMask);
 
 			// Loop all bytes in the region
@@ -371,33 +679,111 @@ namespace Aurie
 			return AURIE_OBJECT_NOT_FOUND;
 		}
 
-		void MmpRemoveAllocationsFromTable(
-			IN AurieModule* OwnerModule,
-			IN const PVOID AllocationBase
+		void MmpPublishHookSnapshot(
+			IN AurieModule* Module
 		)
 		{
-			OwnerModule->MemoryAllocations.remove_if(
-				[AllocationBase](const AurieMemoryAllocation& Allocation)
-				{
-					return Allocation.AllocationBase == AllocationBase;
-				}
-			);
+			auto hook_table = std::make_unique<AurieHookTableSnapshot>();
+
+			for (auto& hook : Module->InlineHooks)
+				hook_table->InlineHooks.push_back(&hook);
+
+			for (auto& hook : Module->MidHooks)
+				hook_table->MidHooks.push_back(&hook);
+
+			for (auto& hook : Module->VmtHooks)
+				hook_table->VmtHooks.push_back(&hook);
+
+			Module->HookSnapshot.Publish(std::move(hook_table));
 		}
 
-		AurieInlineHook* MmpAddInlineHookToTable(
-			IN AurieModule* OwnerModule,
-			IN AurieInlineHook&& Hook
+		// Takes a hook out of its list and frees it once no lookup can still be holding it.
+		// The caller must hold the module's HookTableLock exclusively.
+		template <typename T>
+		static void MmpRetireHookFromList(
+			IN AurieModule* Module,
+			IN OUT std::list<T>& HookList,
+			IN T* Hook
 		)
 		{
-			return &OwnerModule->InlineHooks.emplace_back(std::move(Hook));
-		}
+			auto iterator = std::find_if(
+				HookList.begin(),
+				HookList.end(),
+				[Hook](const T& Entry) -> bool
+				{
+					return &Entry == Hook;
+				}
+			);
+
+			if (iterator == HookList.end())
+				return;
+
+			auto removed_hooks = std::make_unique<std::list<T>>();
+			removed_hooks->splice(removed_hooks->end(), HookList, iterator);
+
+			// The new snapshot has to be out before the hook is retired
+			MmpPublishHookSnapshot(Module);
+			ObpRcuRetireObject(std::move(removed_hooks));
+		}
+
+		void MmpRemoveAllHooks(
+			IN AurieModule* Module
+		)
+		{
+			AurieExclusiveLock hook_table_lock(Module->HookTableLock);
+
+			// Unhook everything right away, only the hook objects themselves are kept around
+			for (auto& hook : Module->InlineHooks)
+				hook.HookInstance = {};
+
+			for (auto& hook : Module->MidHooks)
+			{
+				hook.HookInstance = {};
+				hook.LiteHookInstance = {};
+			}
+
+			// Objects hooked through a cloned VMT get their original VMT back
+			for (auto& hook : Module->VmtHooks)
+			{
+				hook.MethodHooks.clear();
+				hook.HookInstance = {};
+				hook.MethodCount = 0;
+			}
+
+			Module->HookSnapshot.Publish(nullptr);
+
+			auto removed_hooks = std::make_unique<MmpRemovedHooks>();
+			removed_hooks->InlineHooks.splice(removed_hooks->InlineHooks.end(), Module->InlineHooks);
+			removed_hooks->MidHooks.splice(removed_hooks->MidHooks.end(), Module->MidHooks);
+			removed_hooks->VmtHooks.splice(removed_hooks->VmtHooks.end(), Module->VmtHooks);
+
+			ObpRcuRetireObject(std::move(removed_hooks));
+		}
+
+		AurieInlineHook* MmpAddInlineHookToTable(
+			IN AurieModule* OwnerModule,
+			IN AurieInlineHook&& Hook
+		)
+		{
+			AurieExclusiveLock hook_table_lock(OwnerModule->HookTableLock);
+
+			AurieInlineHook* hook_object = &OwnerModule->InlineHooks.emplace_back(std::move(Hook));
+			MmpPublishHookSnapshot(OwnerModule);
+
+			return hook_object;
+		}
 
 		AurieMidHook* MmpAddMidHookToTable(
 			IN AurieModule* OwnerModule,
 			IN AurieMidHook&& Hook
 		)
 		{
-			return &OwnerModule->MidHooks.emplace_back(std::move(Hook));
+			AurieExclusiveLock hook_table_lock(OwnerModule->HookTableLock);
+
+			AurieMidHook* hook_object = &OwnerModule->MidHooks.emplace_back(std::move(Hook));
+			MmpPublishHookSnapshot(OwnerModule);
+
+			return hook_object;
 		}
 
 		AurieStatus MmpRemoveInlineHook(
@@ -434,6 +820,7 @@ namespace Aurie
 			Internal::MmpFreezeCurrentProcess();
 
 			Hook->HookInstance = {};
+			Hook->LiteHookInstance = {};
 
 			Internal::MmpResumeCurrentProcess();
 
@@ -448,12 +835,41 @@ namespace Aurie
 			return AURIE_SUCCESS;
 		}
 
+		AurieStatus MmpRemoveVmtHook(
+			IN AurieModule* Module,
+			IN AurieVmtHook* Hook,
+			IN bool RemoveFromTable
+		)
+		{
+			// Restore the method slots first, then point every object back at its original VMT.
+			// SafetyHook freezes threads on its own for the latter.
+			{
+				AurieExclusiveLock hook_table_lock(Module->HookTableLock);
+
+				Hook->MethodHooks.clear();
+				Hook->HookInstance = {};
+				Hook->MethodCount = 0;
+			}
+
+			if (RemoveFromTable)
+			{
+				MmpRemoveVmtHookFromTable(
+					Module,
+					Hook
+				);
+			}
+
+			return AURIE_SUCCESS;
+		}
+
 		AurieStatus MmpRemoveHook(
 			IN AurieModule* Module,
 			IN std::string_view HookIdentifier,
 			IN bool RemoveFromTable
 		)
 		{
+			AurieRcuReadGuard rcu_guard;
+
 			AurieInlineHook* inline_hook_object = nullptr;
 			AurieStatus last_status = AURIE_SUCCESS;
 
@@ -492,6 +908,23 @@ namespace Aurie
 				);
 			}
 
+			// Lastly, it might be a VMT hook
+			AurieVmtHook* vmt_hook_object = nullptr;
+			last_status = MmpLookupVmtHookByName(
+				Module,
+				HookIdentifier,
+				vmt_hook_object
+			);
+
+			if (AurieSuccess(last_status))
+			{
+				return MmpRemoveVmtHook(
+					Module,
+					vmt_hook_object,
+					RemoveFromTable
+				);
+			}
+
 			// Else it's a non-existent hook.
 			return AURIE_OBJECT_NOT_FOUND;
 		}
@@ -501,12 +934,12 @@ namespace Aurie
 			IN AurieInlineHook* Hook
 		)
 		{
-			std::erase_if(
+			AurieExclusiveLock hook_table_lock(Module->HookTableLock);
+
+			MmpRetireHookFromList(
+				Module,
 				Module->InlineHooks,
-				[Hook](const AurieInlineHook& Entry) -> bool
-				{
-					return Entry == *Hook;
-				}
+				Hook
 			);
 		}
 
@@ -515,13 +948,69 @@ namespace Aurie
 			IN AurieMidHook* Hook
 		)
 		{
-			std::erase_if(
+			AurieExclusiveLock hook_table_lock(Module->HookTableLock);
+
+			MmpRetireHookFromList(
+				Module,
 				Module->MidHooks,
-				[Hook](const AurieMidHook& Entry) -> bool
+				Hook
+			);
+		}
+
+		AurieVmtHook* MmpAddVmtHookToTable(
+			IN AurieModule* OwnerModule,
+			IN AurieVmtHook&& Hook
+		)
+		{
+			AurieExclusiveLock hook_table_lock(OwnerModule->HookTableLock);
+
+			AurieVmtHook* hook_object = &OwnerModule->VmtHooks.emplace_back(std::move(Hook));
+			MmpPublishHookSnapshot(OwnerModule);
+
+			return hook_object;
+		}
+
+		void MmpRemoveVmtHookFromTable(
+			IN AurieModule* Module,
+			IN AurieVmtHook* Hook
+		)
+		{
+			AurieExclusiveLock hook_table_lock(Module->HookTableLock);
+
+			MmpRetireHookFromList(
+				Module,
+				Module->VmtHooks,
+				Hook
+			);
+		}
+
+		AurieStatus MmpLookupVmtHookByName(
+			IN AurieModule* Module,
+			IN std::string_view HookIdentifier,
+			OUT AurieVmtHook*& Hook
+		)
+		{
+			AurieRcuReadGuard rcu_guard;
+
+			const AurieHookTableSnapshot* hook_table = Module->HookSnapshot.Load();
+			if (!hook_table)
+				return AURIE_OBJECT_NOT_FOUND;
+
+			auto iterator = std::find_if(
+				hook_table->VmtHooks.begin(),
+				hook_table->VmtHooks.end(),
+				[HookIdentifier](AurieVmtHook* Object) -> bool
 				{
-					return Entry == *Hook;
+					return Object->Identifier == HookIdentifier;
 				}
 			);
+
+			if (iterator == std::end(hook_table->VmtHooks))
+				return AURIE_OBJECT_NOT_FOUND;
+
+			Hook = *iterator;
+
+			return AURIE_SUCCESS;
 		}
 
 		AurieStatus MmpLookupInlineHookByName(
@@ -530,19 +1019,25 @@ namespace Aurie
 			OUT AurieInlineHook*& Hook
 		)
 		{
+			AurieRcuReadGuard rcu_guard;
+
+			const AurieHookTableSnapshot* hook_table = Module->HookSnapshot.Load();
+			if (!hook_table)
+				return AURIE_OBJECT_NOT_FOUND;
+
 			auto iterator = std::find_if(
-				Module->InlineHooks.begin(),
-				Module->InlineHooks.end(),
-				[HookIdentifier](AurieInlineHook& Object) -> bool
+				hook_table->InlineHooks.begin(),
+				hook_table->InlineHooks.end(),
+				[HookIdentifier](AurieInlineHook* Object) -> bool
 				{
-					return Object.Identifier == HookIdentifier;
+					return Object->Identifier == HookIdentifier;
 				}
 			);
 
-			if (iterator == std::end(Module->InlineHooks))
+			if (iterator == std::end(hook_table->InlineHooks))
 				return AURIE_OBJECT_NOT_FOUND;
 
-			Hook = &(*iterator);
+			Hook = *iterator;
 
 			return AURIE_SUCCESS;
 		}
@@ -553,19 +1048,25 @@ namespace Aurie
 			OUT AurieMidHook*& Hook
 		)
 		{
+			AurieRcuReadGuard rcu_guard;
+
+			const AurieHookTableSnapshot* hook_table = Module->HookSnapshot.Load();
+			if (!hook_table)
+				return AURIE_OBJECT_NOT_FOUND;
+
 			auto iterator = std::find_if(
-				Module->MidHooks.begin(),
-				Module->MidHooks.end(),
-				[HookIdentifier](AurieMidHook& Object) -> bool
+				hook_table->MidHooks.begin(),
+				hook_table->MidHooks.end(),
+				[HookIdentifier](AurieMidHook* Object) -> bool
 				{
-					return Object.Identifier == HookIdentifier;
+					return Object->Identifier == HookIdentifier;
 				}
 			);
 
-			if (iterator == std::end(Module->MidHooks))
+			if (iterator == std::end(hook_table->MidHooks))
 				return AURIE_OBJECT_NOT_FOUND;
 
-			Hook = &(*iterator);
+			Hook = *iterator;
 
 			return AURIE_SUCCESS;
 		}
@@ -574,13 +1075,30 @@ namespace Aurie
 			IN AurieModule* Module,
 			IN std::string_view HookIdentifier,
 			IN PVOID SourceFunction,
-			IN PVOID DestinationFunction
+			IN PVOID DestinationFunction,
+			IN AurieHookFlags Flags
 		)
 		{
 			// Create the hook object
 			AurieInlineHook hook = {};
 			hook.Owner = Module;
 			hook.Identifier = HookIdentifier;
+
+			// Instrumented hooks jump to the thunk, which forwards to the real destination
+			if (Flags & AURIE_HOOK_INSTRUMENTED)
+			{
+				AurieStatus last_status = MmpCreateInstrumentation(
+					false,
+					DestinationFunction,
+					hook.Instrumentation
+				);
+
+				if (!AurieSuccess(last_status))
+					return nullptr;
+
+				DestinationFunction = hook.Instrumentation->Thunk.data();
+			}
+
 			hook.HookInstance = safetyhook::create_inline(SourceFunction, DestinationFunction);
 
 			// Add the hook to the table
@@ -591,15 +1109,417 @@ namespace Aurie
 			IN AurieModule* Module,
 			IN std::string_view HookIdentifier,
 			IN PVOID SourceInstruction,
-			IN AurieMidHookFunction TargetFunction
+			IN AurieMidHookFunction TargetFunction,
+			IN AurieHookFlags Flags
+		)
+		{
+			AurieMidHook hook = {};
+			hook.Owner = Module;
+			hook.Identifier = HookIdentifier;
+
+			PVOID target_function = reinterpret_cast<PVOID>(TargetFunction);
+
+			// Instrumented midhooks call the thunk, which times the call to the real handler
+			if (Flags & AURIE_HOOK_INSTRUMENTED)
+			{
+				AurieStatus last_status = MmpCreateInstrumentation(
+					true,
+					target_function,
+					hook.Instrumentation
+				);
+
+				if (!AurieSuccess(last_status))
+					return nullptr;
+
+				target_function = hook.Instrumentation->Thunk.data();
+			}
+
+			hook.HookInstance = safetyhook::create_mid(SourceInstruction, reinterpret_cast<safetyhook::MidHookFn>(target_function));
+
+			return MmpAddMidHookToTable(Module, std::move(hook));
+		}
+
+		AurieMidHook* MmpCreateLightMidHook(
+			IN AurieModule* Module,
+			IN std::string_view HookIdentifier,
+			IN PVOID SourceInstruction,
+			IN AurieMidHookFunction TargetFunction,
+			IN AurieMidHookRegisters Registers,
+			IN AurieHookFlags Flags
 		)
 		{
+#ifdef _WIN64
 			AurieMidHook hook = {};
 			hook.Owner = Module;
 			hook.Identifier = HookIdentifier;
-			hook.HookInstance = safetyhook::create_mid(SourceInstruction, reinterpret_cast<safetyhook::MidHookFn>(TargetFunction));
+
+			PVOID target_function = reinterpret_cast<PVOID>(TargetFunction);
+
+			if (Flags & AURIE_HOOK_INSTRUMENTED)
+			{
+				AurieStatus last_status = MmpCreateInstrumentation(
+					true,
+					target_function,
+					hook.Instrumentation
+				);
+
+				if (!AurieSuccess(last_status))
+					return nullptr;
+
+				target_function = hook.Instrumentation->Thunk.data();
+			}
+
+			// The handler may clobber XMM0-5 (they're volatile in the x64 ABI),
+			// so those are always preserved even if the caller doesn't want to see them.
+			// XMM6-15 are callee-saved, so the handler restores them on its own.
+			std::vector<uint8_t> stub_code;
+			size_t destination_offset = 0, trampoline_offset = 0;
+
+			MmpEmitLightMidHookStub(
+				(Registers & AURIE_MIDHOOK_ALL_XMM) | 0x3F,
+				stub_code,
+				destination_offset,
+				trampoline_offset
+			);
+
+			auto stub_allocation = safetyhook::Allocator::global()->allocate(stub_code.size());
+			if (!stub_allocation)
+				return nullptr;
+
+			hook.LiteStub = std::move(*stub_allocation);
+
+			uint8_t* stub = hook.LiteStub.data();
+			memcpy(stub, stub_code.data(), stub_code.size());
+			memcpy(stub + destination_offset, &target_function, sizeof(target_function));
+
+			hook.LiteHookInstance = safetyhook::create_inline(SourceInstruction, stub);
+
+			// Resume at the trampoline, just like SafetyHook's midhooks do
+			PVOID trampoline = hook.LiteHookInstance.trampoline().data();
+			memcpy(stub + trampoline_offset, &trampoline, sizeof(trampoline));
 
 			return MmpAddMidHookToTable(Module, std::move(hook));
+#else
+			// x86 has no stub of its own, the full context is always captured there.
+			// Registers is only a hint, so this is still correct.
+			return MmpCreateMidHook(
+				Module,
+				HookIdentifier,
+				SourceInstruction,
+				TargetFunction,
+				Flags
+			);
+#endif // _WIN64
+		}
+
+		void MmpEmitLightMidHookStub(
+			IN uint32_t XmmMask,
+			OUT std::vector<uint8_t>& Code,
+			OUT size_t& DestinationOffset,
+			OUT size_t& TrampolineOffset
+		)
+		{
+			auto emit = [&Code](std::initializer_list<uint8_t> Bytes)
+				{
+					Code.insert(Code.end(), Bytes);
+				};
+
+			auto emit_u32 = [&Code](uint32_t Value)
+				{
+					for (int i = 0; i < 4; i++)
+						Code.push_back(static_cast<uint8_t>(Value >> (i * 8)));
+				};
+
+			// movdqu [rsp + Index * 16], xmmIndex (Opcode 0x7F) or movdqu xmmIndex, [rsp + Index * 16] (Opcode 0x6F)
+			auto emit_xmm_move = [&](uint8_t Opcode, uint8_t Index)
+				{
+					uint8_t reg = (Index & 7) << 3;
+					uint32_t displacement = Index * 16;
+
+					Code.push_back(0xF3);
+					if (Index >= 8)
+						Code.push_back(0x44);
+
+					emit({ 0x0F, Opcode });
+
+					if (displacement == 0)
+					{
+						emit({ static_cast<uint8_t>(0x04 | reg), 0x24 });
+					}
+					else if (displacement < 0x80)
+					{
+						emit({ static_cast<uint8_t>(0x44 | reg), 0x24, static_cast<uint8_t>(displacement) });
+					}
+					else
+					{
+						emit({ static_cast<uint8_t>(0x84 | reg), 0x24 });
+						emit_u32(displacement);
+					}
+				};
+
+			Code.clear();
+
+			// push qword ptr [rip + trampoline]
+			emit({ 0xFF, 0x35 });
+			size_t trampoline_disp = Code.size();
+			emit_u32(0);
+
+			// push rsp; push rsp; push rbp; push rax; ... push r15; pushfq
+			emit({
+				0x54, 0x54, 0x55, 0x50, 0x53, 0x51, 0x52, 0x56, 0x57, 0x41, 0x50, 0x41, 0x51,
+				0x41, 0x52, 0x41, 0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57, 0x9C
+			});
+
+			// sub rsp, 0x100 (the SSE part of the context is always reserved, only partially filled)
+			emit({ 0x48, 0x81, 0xEC, 0x00, 0x01, 0x00, 0x00 });
+
+			for (int i = 15; i >= 0; i--)
+			{
+				if (XmmMask & (1 << i))
+					emit_xmm_move(0x7F, static_cast<uint8_t>(i));
+			}
+
+			// Fix up the RSP field, point rcx at the context and call the handler on an aligned stack
+			emit({
+				0x48, 0x8B, 0x8C, 0x24, 0x80, 0x01, 0x00, 0x00,		// mov rcx, [rsp + 0x180]
+				0x48, 0x83, 0xC1, 0x10,								// add rcx, 0x10
+				0x48, 0x89, 0x8C, 0x24, 0x80, 0x01, 0x00, 0x00,		// mov [rsp + 0x180], rcx
+				0x48, 0x8D, 0x0C, 0x24,								// lea rcx, [rsp]
+				0x48, 0x89, 0xE3,									// mov rbx, rsp
+				0x48, 0x83, 0xEC, 0x30,								// sub rsp, 0x30
+				0x48, 0x83, 0xE4, 0xF0,								// and rsp, -16
+				0xFF, 0x15											// call qword ptr [rip + destination]
+			});
+			size_t destination_disp = Code.size();
+			emit_u32(0);
+
+			// mov rsp, rbx
+			emit({ 0x48, 0x89, 0xDC });
+
+			for (int i = 0; i < 16; i++)
+			{
+				if (XmmMask & (1 << i))
+					emit_xmm_move(0x6F, static_cast<uint8_t>(i));
+			}
+
+			// add rsp, 0x100; popfq; pop r15; ... pop rbp; lea rsp, [rsp + 8]; pop rsp; ret
+			emit({
+				0x48, 0x81, 0xC4, 0x00, 0x01, 0x00, 0x00, 0x9D, 0x41, 0x5F, 0x41, 0x5E, 0x41,
+				0x5D, 0x41, 0x5C, 0x41, 0x5B, 0x41, 0x5A, 0x41, 0x59, 0x41, 0x58, 0x5F, 0x5E,
+				0x5A, 0x59, 0x5B, 0x58, 0x5D, 0x48, 0x8D, 0x64, 0x24, 0x08, 0x5C, 0xC3
+			});
+
+			// Align the data block
+			while (Code.size() % 8)
+				Code.push_back(0xCC);
+
+			DestinationOffset = Code.size();
+			emit({ 0, 0, 0, 0, 0, 0, 0, 0 });
+
+			TrampolineOffset = Code.size();
+			emit({ 0, 0, 0, 0, 0, 0, 0, 0 });
+
+			// RIP-relative displacements are relative to the end of the 4-byte field
+			auto patch_disp = [&Code](size_t Field, size_t Target)
+				{
+					uint32_t displacement = static_cast<uint32_t>(Target - (Field + 4));
+					memcpy(&Code[Field], &displacement, sizeof(displacement));
+				};
+
+			patch_disp(trampoline_disp, TrampolineOffset);
+			patch_disp(destination_disp, DestinationOffset);
+		}
+
+		AurieStatus MmpCreateInstrumentation(
+			IN bool IsMidHook,
+			IN PVOID Destination,
+			OUT AurieHookInstrumentation*& Instrumentation
+		)
+		{
+#ifdef _WIN64
+			// Calls the destination from a frame of its own and takes rdtsc around it.
+			// The caller's first 16 stack arguments are copied over, so a destination can take up to 20 arguments.
+			// 
+			// Data (last 24 bytes): Counters, MmpRecordHookSample, Destination
+			constexpr uint8_t inline_thunk[] = {
+				0x48, 0x81, 0xEC, 0xB8, 0x00, 0x00, 0x00, 0x49, 0x89, 0xD3, 0x0F, 0x31, 0x48, 0xC1, 0xE2, 0x20,
+				0x48, 0x09, 0xD0, 0x48, 0x89, 0x84, 0x24, 0xA0, 0x00, 0x00, 0x00, 0x4C, 0x89, 0xDA, 0x41, 0xBA,
+				0x78, 0x00, 0x00, 0x00, 0x4A, 0x8B, 0x84, 0x14, 0xE0, 0x00, 0x00, 0x00, 0x4A, 0x89, 0x44, 0x14,
+				0x20, 0x49, 0x83, 0xEA, 0x08, 0x79, 0xED, 0xFF, 0x15, 0x73, 0x00, 0x00, 0x00, 0x48, 0x89, 0x44,
+				0x24, 0x20, 0xF3, 0x0F, 0x7F, 0x44, 0x24, 0x30, 0xF3, 0x0F, 0x7F, 0x4C, 0x24, 0x40, 0xF3, 0x0F,
+				0x7F, 0x54, 0x24, 0x50, 0xF3, 0x0F, 0x7F, 0x5C, 0x24, 0x60, 0x0F, 0x31, 0x48, 0xC1, 0xE2, 0x20,
+				0x48, 0x09, 0xD0, 0x48, 0x2B, 0x84, 0x24, 0xA0, 0x00, 0x00, 0x00, 0x48, 0x89, 0xC2, 0x48, 0x8B,
+				0x0D, 0x2B, 0x00, 0x00, 0x00, 0xFF, 0x15, 0x2D, 0x00, 0x00, 0x00, 0xF3, 0x0F, 0x6F, 0x44, 0x24,
+				0x30, 0xF3, 0x0F, 0x6F, 0x4C, 0x24, 0x40, 0xF3, 0x0F, 0x6F, 0x54, 0x24, 0x50, 0xF3, 0x0F, 0x6F,
+				0x5C, 0x24, 0x60, 0x48, 0x8B, 0x44, 0x24, 0x20, 0x48, 0x81, 0xC4, 0xB8, 0x00, 0x00, 0x00, 0xC3,
+				0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+				0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+			};
+
+			// The only prolog instruction is sub rsp, 0xB8 (7 bytes), which is all the unwinder needs to get past the frame.
+			// UNWIND_INFO: version 1, no handler, one UWOP_ALLOC_LARGE code taking two slots.
+			constexpr size_t inline_thunk_code_size = 0xA0;
+			constexpr uint8_t inline_thunk_unwind_info[] = {
+				0x01, 0x07, 0x02, 0x00, 0x07, 0x01, 0xB8 / 8, 0x00
+			};
+
+			// Takes rdtsc around the handler call and passes the delta to MmpRecordHookSample.
+			// 
+			// Data (last 24 bytes): Counters, MmpRecordHookSample, Destination
+			constexpr uint8_t mid_thunk[] = {
+				0x53, 0x56, 0x48, 0x83, 0xEC, 0x28, 0x48, 0x89, 0xCB, 0x0F, 0x31, 0x48, 0xC1, 0xE2, 0x20, 0x48,
+				0x09, 0xD0, 0x48, 0x89, 0xC6, 0x48, 0x89, 0xD9, 0xFF, 0x15, 0x3A, 0x00, 0x00, 0x00, 0x0F, 0x31,
+				0x48, 0xC1, 0xE2, 0x20, 0x48, 0x09, 0xD0, 0x48, 0x29, 0xF0, 0x48, 0x89, 0xC2, 0x48, 0x8B, 0x0D,
+				0x14, 0x00, 0x00, 0x00, 0xFF, 0x15, 0x16, 0x00, 0x00, 0x00, 0x48, 0x83, 0xC4, 0x28, 0x5E, 0x5B,
+				0xC3, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+				0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+			};
+
+			const uint8_t* thunk_code = IsMidHook ? mid_thunk : inline_thunk;
+			const size_t thunk_size = IsMidHook ? sizeof(mid_thunk) : sizeof(inline_thunk);
+
+			// Inline thunks get their function table entry and unwind info right after the code
+			const size_t allocation_size = IsMidHook
+				? thunk_size
+				: thunk_size + sizeof(RUNTIME_FUNCTION) + sizeof(inline_thunk_unwind_info);
+
+			auto allocation = safetyhook::Allocator::global()->allocate(allocation_size);
+			if (!allocation)
+				return AURIE_INSUFFICIENT_MEMORY;
+
+			auto instrumentation = std::make_unique<AurieHookInstrumentation>();
+			instrumentation->Thunk = std::move(*allocation);
+
+			uint8_t* thunk = instrumentation->Thunk.data();
+			memcpy(thunk, thunk_code, thunk_size);
+
+			// Fill in the data block at the end of the thunk
+			const uintptr_t thunk_data[] = {
+				reinterpret_cast<uintptr_t>(&instrumentation->Counters),
+				reinterpret_cast<uintptr_t>(&MmpRecordHookSample),
+				reinterpret_cast<uintptr_t>(Destination)
+			};
+
+			memcpy(thunk + thunk_size - sizeof(thunk_data), thunk_data, sizeof(thunk_data));
+
+			// Without this, exceptions thrown by the destination couldn't get past the thunk's frame
+			if (!IsMidHook)
+			{
+				RUNTIME_FUNCTION* function_entry = reinterpret_cast<RUNTIME_FUNCTION*>(thunk + thunk_size);
+				uint8_t* unwind_info = reinterpret_cast<uint8_t*>(function_entry + 1);
+
+				memcpy(unwind_info, inline_thunk_unwind_info, sizeof(inline_thunk_unwind_info));
+
+				function_entry->BeginAddress = 0;
+				function_entry->EndAddress = static_cast<DWORD>(inline_thunk_code_size);
+				function_entry->UnwindData = static_cast<DWORD>(unwind_info - thunk);
+
+				if (!RtlAddFunctionTable(function_entry, 1, reinterpret_cast<DWORD64>(thunk)))
+					return AURIE_EXTERNAL_ERROR;
+			}
+
+			// Nothing ever frees this, a thread may still be about to return into the thunk
+			Instrumentation = instrumentation.release();
+			return AURIE_SUCCESS;
+#else
+			return AURIE_NOT_IMPLEMENTED;
+#endif // _WIN64
+		}
+
+		AurieStatus MmpLookupHookCounters(
+			IN AurieModule* Module,
+			IN std::string_view HookIdentifier,
+			OUT AurieHookCounters*& Counters
+		)
+		{
+			AurieInlineHook* inline_hook_object = nullptr;
+			AurieMidHook* mid_hook_object = nullptr;
+			AurieHookInstrumentation* instrumentation = nullptr;
+
+			if (AurieSuccess(MmpLookupInlineHookByName(Module, HookIdentifier, inline_hook_object)))
+				instrumentation = inline_hook_object->Instrumentation;
+			else if (AurieSuccess(MmpLookupMidHookByName(Module, HookIdentifier, mid_hook_object)))
+				instrumentation = mid_hook_object->Instrumentation;
+			else
+				return AURIE_OBJECT_NOT_FOUND;
+
+			// The hook exists, but wasn't created with AURIE_HOOK_INSTRUMENTED
+			if (!instrumentation)
+				return AURIE_UNAVAILABLE;
+
+			Counters = &instrumentation->Counters;
+			return AURIE_SUCCESS;
+		}
+
+		size_t MmpGetHookCounterSlot()
+		{
+			static std::atomic<size_t> next_slot = 0;
+			thread_local size_t thread_slot = next_slot.fetch_add(1, std::memory_order_relaxed) % AURIE_HOOK_COUNTER_SLOTS;
+
+			return thread_slot;
+		}
+
+		void MmpRecordHookSample(
+			IN AurieHookCounters* Counters,
+			IN uint64_t Cycles
+		) noexcept
+		{
+			// The slot is (almost always) only written by this thread, so the
+			// cache line stays local and the atomics are uncontended.
+			AurieHookCounterSlot& slot = Counters->Slots[MmpGetHookCounterSlot()];
+
+			slot.CallCount.fetch_add(1, std::memory_order_relaxed);
+			slot.CycleCount.fetch_add(Cycles, std::memory_order_relaxed);
+		}
+
+		// Framework-owned interface over MmQueryHookStatistics / MmResetHookStatistics
+		struct MmpHookStatisticsInterface : AurieHookStatisticsInterface
+		{
+			virtual AurieStatus Create() override
+			{
+				return AURIE_SUCCESS;
+			}
+
+			virtual void Destroy() override
+			{
+			}
+
+			virtual void QueryVersion(
+				OUT short& Major,
+				OUT short& Minor,
+				OUT short& Patch
+			) override
+			{
+				MmGetFrameworkVersion(&Major, &Minor, &Patch);
+			}
+
+			virtual AurieStatus QueryHookStatistics(
+				IN AurieModule* Module,
+				IN std::string_view HookIdentifier,
+				OUT AurieHookStatistics& Statistics
+			) override
+			{
+				return MmQueryHookStatistics(Module, HookIdentifier, Statistics);
+			}
+
+			virtual AurieStatus ResetHookStatistics(
+				IN AurieModule* Module,
+				IN std::string_view HookIdentifier
+			) override
+			{
+				return MmResetHookStatistics(Module, HookIdentifier);
+			}
+		};
+
+		AurieStatus MmpRegisterHookStatisticsInterface()
+		{
+			static MmpHookStatisticsInterface hook_statistics_interface;
+
+			return ObCreateInterface(
+				g_ArInitialImage,
+				&hook_statistics_interface,
+				AURIE_HOOK_STATISTICS_INTERFACE_NAME
+			);
 		}
 
 		void MmpFreezeCurrentProcess()
@@ -653,5 +1573,146 @@ namespace Aurie
 				}
 			);
 		}
+
+		// Keeps the tail of Source, which is the interesting part of a path
+		template <typename TChar>
+		static void MmpCopyTraceDetail(
+			IN std::basic_string_view<TChar> Source,
+			OUT char(&Detail)[MMP_TRACE_DETAIL_LENGTH]
+		) noexcept
+		{
+			// Whatever doesn't fit is cut off the front
+			if (Source.size() >= MMP_TRACE_DETAIL_LENGTH)
+				Source.remove_prefix(Source.size() - (MMP_TRACE_DETAIL_LENGTH - 1));
+
+			size_t length = 0;
+			for (TChar character : Source)
+			{
+				// Anything that isn't printable ASCII would need converting, which isn't worth it here
+				bool is_printable = character >= 0x20 && character < 0x7F;
+				Detail[length++] = is_printable ? static_cast<char>(character) : '?';
+			}
+
+			Detail[length] = '\0';
+		}
+
+		static MmpTraceEvent* MmpClaimTraceEvent(
+			OUT uint32_t& EventIndex
+		) noexcept
+		{
+			// Don't keep bumping the count once it's full, it'd wrap around eventually
+			if (g_MmTraceEventCount.load(std::memory_order_relaxed) >= MMP_TRACE_CAPACITY)
+			{
+				EventIndex = MMP_TRACE_DROPPED;
+				return nullptr;
+			}
+
+			EventIndex = g_MmTraceEventCount.fetch_add(1, std::memory_order_relaxed);
+			if (EventIndex >= MMP_TRACE_CAPACITY)
+			{
+				EventIndex = MMP_TRACE_DROPPED;
+				return nullptr;
+			}
+
+			return &g_MmTraceEvents[EventIndex];
+		}
+
+		static void MmpStartTraceEvent(
+			IN MmpTraceEvent* TraceEvent,
+			IN const char* Name
+		) noexcept
+		{
+			TraceEvent->Name = Name;
+			TraceEvent->ThreadId = GetCurrentThreadId();
+
+			LARGE_INTEGER start_ticks = {};
+			QueryPerformanceCounter(&start_ticks);
+
+			// Publishes the fields above to MmWriteTrace
+			TraceEvent->StartTicks.store(start_ticks.QuadPart, std::memory_order_release);
+		}
+
+		uint32_t MmpBeginTraceSpan(
+			IN const char* Name,
+			IN std::string_view Detail
+		) noexcept
+		{
+			uint32_t event_index = MMP_TRACE_DROPPED;
+			MmpTraceEvent* trace_event = MmpClaimTraceEvent(event_index);
+			if (!trace_event)
+				return event_index;
+
+			MmpCopyTraceDetail(Detail, trace_event->Detail);
+			MmpStartTraceEvent(trace_event, Name);
+
+			return event_index;
+		}
+
+		uint32_t MmpBeginTraceSpan(
+			IN const char* Name,
+			IN const fs::path& ImagePath
+		) noexcept
+		{
+			uint32_t event_index = MMP_TRACE_DROPPED;
+			MmpTraceEvent* trace_event = MmpClaimTraceEvent(event_index);
+			if (!trace_event)
+				return event_index;
+
+			// native() is a reference to the path's own string, unlike filename() it doesn't allocate
+			std::basic_string_view<fs::path::value_type> image_path = ImagePath.native();
+
+			const fs::path::value_type separators[] = { fs::path::preferred_separator, '/', '\0' };
+
+			size_t separator = image_path.find_last_of(separators);
+			if (separator != image_path.npos)
+				image_path.remove_prefix(separator + 1);
+
+			MmpCopyTraceDetail(image_path, trace_event->Detail);
+			MmpStartTraceEvent(trace_event, Name);
+
+			return event_index;
+		}
+
+		void MmpEndTraceSpan(
+			IN uint32_t EventIndex
+		) noexcept
+		{
+			if (EventIndex >= MMP_TRACE_CAPACITY)
+				return;
+
+			LARGE_INTEGER end_ticks = {};
+			QueryPerformanceCounter(&end_ticks);
+
+			g_MmTraceEvents[EventIndex].EndTicks.store(end_ticks.QuadPart, std::memory_order_release);
+		}
+
+		void MmpAppendJsonString(
+			IN std::string_view Value,
+			IN OUT std::string& Json
+		)
+		{
+			Json.push_back('"');
+
+			for (char character : Value)
+			{
+				if (character == '"' || character == '\\')
+				{
+					Json.push_back('\\');
+					Json.push_back(character);
+				}
+				else if (static_cast<unsigned char>(character) < 0x20)
+				{
+					char escaped_character[8] = {};
+					snprintf(escaped_character, std::size(escaped_character), "\\u%04x", character);
+					Json += escaped_character;
+				}
+				else
+				{
+					Json.push_back(character);
+				}
+			}
+
+			Json.push_back('"');
+		}
 	}
 }
@@ -2,6 +2,9 @@
 #define AURIE_MEMORY_H_
 
 #include "../framework.hpp"
+#include <atomic>
+#include <string>
+#include <vector>
 
 namespace Aurie
 {
@@ -30,6 +33,43 @@ namespace Aurie
 		IN PVOID AllocationBase
 	);
 
+	// Allocates memory aligned to any power of two up to the page size
+	EXPORTED PVOID MmAllocateMemoryEx(
+		IN AurieModule* Owner,
+		IN size_t Size,
+		IN size_t Alignment,
+		IN AurieAllocationFlags Flags
+	);
+
+	// Grows or shrinks an allocation, in place if the block has room for it.
+	// Returns nullptr and leaves the allocation alone if it has to move and there's no memory.
+	EXPORTED PVOID MmReallocateMemory(
+		IN AurieModule* Owner,
+		IN PVOID AllocationBase,
+		IN size_t NewSize
+	);
+
+	// Creates a pool of fixed-size objects, freed along with the rest of the owner's memory
+	EXPORTED AurieStatus MmCreateObjectPool(
+		IN AurieModule* Owner,
+		IN size_t ObjectSize,
+		OUT AurieObjectPool*& Pool
+	);
+
+	EXPORTED AurieStatus MmDestroyObjectPool(
+		IN AurieModule* Owner,
+		IN AurieObjectPool* Pool
+	);
+
+	EXPORTED PVOID MmAllocatePoolObject(
+		IN AurieObjectPool* Pool
+	);
+
+	EXPORTED AurieStatus MmFreePoolObject(
+		IN AurieObjectPool* Pool,
+		IN PVOID Object
+	);
+
 	EXPORTED size_t MmSigscanModule(
 		IN const wchar_t* ModuleName,
 		IN const unsigned char* Pattern,
@@ -73,9 +113,108 @@ namespace Aurie
 		IN AurieMidHookFunction TargetHandler
 	);
 
+	EXPORTED AurieStatus MmCreateHookEx(
+		IN AurieModule* Module,
+		IN std::string_view HookIdentifier,
+		IN PVOID SourceFunction,
+		IN PVOID DestinationFunction,
+		OUT OPTIONAL PVOID* Trampoline,
+		IN AurieHookFlags Flags
+	);
+
+	EXPORTED AurieStatus MmCreateMidfunctionHookEx(
+		IN AurieModule* Module,
+		IN std::string_view HookIdentifier,
+		IN PVOID SourceAddress,
+		IN AurieMidHookFunction TargetHandler,
+		IN AurieHookFlags Flags
+	);
+
+	// Like MmCreateMidfunctionHookEx, but only the XMM registers in Registers are captured.
+	// The remaining XMM fields of the context are undefined, and writes to them are discarded.
+	EXPORTED AurieStatus MmCreateLightMidfunctionHook(
+		IN AurieModule* Module,
+		IN std::string_view HookIdentifier,
+		IN PVOID SourceAddress,
+		IN AurieMidHookFunction TargetHandler,
+		IN AurieMidHookRegisters Registers,
+		IN AurieHookFlags Flags
+	);
+
+	// Clones the VMT of Object and points Object at the clone.
+	// Methods are hooked in the clone with MmHookVirtualMethod, which only affects objects the hook is applied to.
+	EXPORTED AurieStatus MmCreateVmtHook(
+		IN AurieModule* Module,
+		IN std::string_view HookIdentifier,
+		IN PVOID Object
+	);
+
+	// Points another object (of the same class) at an existing cloned VMT
+	EXPORTED AurieStatus MmApplyVmtHook(
+		IN AurieModule* Module,
+		IN std::string_view HookIdentifier,
+		IN PVOID Object
+	);
+
+	EXPORTED AurieStatus MmHookVirtualMethod(
+		IN AurieModule* Module,
+		IN std::string_view HookIdentifier,
+		IN size_t MethodIndex,
+		IN PVOID DestinationFunction,
+		OUT OPTIONAL PVOID* OriginalMethod
+	);
+
+	EXPORTED AurieStatus MmQueryMemoryStatistics(
+		IN AurieModule* Module,
+		OUT AurieMemoryStatistics& Statistics
+	);
+
+	// Writes the memory statistics of a module to the debugger output, or of every loaded module if Module is nullptr
+	EXPORTED void MmDumpMemoryStatistics(
+		IN OPTIONAL AurieModule* Module
+	);
+
+	// Returns the calling thread's scratch allocator, which lives until the thread exits
+	EXPORTED AurieStatus MmGetScratchAllocator(
+		OUT AurieScratchAllocator*& Allocator
+	);
+
+	// Moves the scratch allocator to a chunk with enough room and allocates from it.
+	// Called by MmScratchAllocate when the current chunk runs out.
+	EXPORTED PVOID MmScratchExpand(
+		IN AurieScratchAllocator* Allocator,
+		IN size_t Size,
+		IN size_t Alignment
+	);
+
+	// Resets the scratch allocator to a mark in an earlier chunk, chunks past it are kept for reuse.
+	// Resetting all the way back to the start frees every chunk but the first.
+	EXPORTED void MmScratchRewind(
+		IN AurieScratchAllocator* Allocator,
+		IN const AurieScratchMark& Mark
+	);
+
+	// Sums up the per-thread counters of a hook created with AURIE_HOOK_INSTRUMENTED.
+	EXPORTED AurieStatus MmQueryHookStatistics(
+		IN AurieModule* Module,
+		IN std::string_view HookIdentifier,
+		OUT AurieHookStatistics& Statistics
+	);
+
+	EXPORTED AurieStatus MmResetHookStatistics(
+		IN AurieModule* Module,
+		IN std::string_view HookIdentifier
+	);
+
+	// Writes every span recorded so far as Chrome trace event JSON, which chrome://tracing and Perfetto can open.
+	// Spans that are still open are written as if they ended now.
+	EXPORTED AurieStatus MmWriteTrace(
+		IN const fs::path& TracePath
+	);
+
 	namespace Internal
 	{
-		AurieMemoryAllocation MmpAllocateMemory(
+		PVOID MmpAllocateMemory(
 			IN const size_t AllocationSize,
 			IN AurieModule* const OwnerModule
 		);
@@ -87,12 +226,101 @@ namespace Aurie
 
 		void MmpFreeMemory(
 			IN AurieModule* OwnerModule,
-			IN PVOID AllocationBase,
-			IN bool RemoveTableEntry
+			IN PVOID AllocationBase
 		);
-		
-		AurieMemoryAllocation* MmpAddAllocationToTable(
-			IN const AurieMemoryAllocation& Allocation
+
+		// Bumps the cursor of the arena, or reuses a freed block of the same size class
+		PVOID MmpArenaAllocate(
+			IN AurieArena& Arena,
+			IN size_t Size
+		);
+
+		void MmpArenaFree(
+			IN AurieArena& Arena,
+			IN PVOID AllocationBase
+		);
+
+		// Over-allocates a block and places a second header in front of the aligned address inside it
+		PVOID MmpArenaAllocateAligned(
+			IN AurieArena& Arena,
+			IN size_t Size,
+			IN size_t Alignment
+		);
+
+		// Accounts for a block being handed out (positive) or taken back (negative)
+		void MmpArenaRecordUsage(
+			IN AurieArena& Arena,
+			IN size_t HistogramBucket,
+			IN size_t BlockSize,
+			IN bool Allocated
+		);
+
+		AurieScratchAllocator* MmpGetThreadScratchAllocator();
+
+		// How many bytes can be used starting at AllocationBase
+		size_t MmpArenaGetBlockSize(
+			IN PVOID AllocationBase
+		);
+
+		// The alignment the block was allocated with, read back from its header
+		size_t MmpArenaGetBlockAlignment(
+			IN PVOID AllocationBase
+		);
+
+		// Checks that AllocationBase is a live block handed out by the arena, in constant time and without locking.
+		// Safe to call with any pointer, nothing is read from it unless it's inside an arena chunk.
+		bool MmpArenaOwnsBlock(
+			IN AurieArena& Arena,
+			IN PVOID AllocationBase
+		);
+
+		// Releases every chunk of the arena at once, invalidating all of its allocations
+		void MmpReleaseArena(
+			IN AurieArena& Arena
+		);
+
+		// Gives the arena an identity thread caches can recognize it by.
+		// The arena must not move after this.
+		void MmpInitializeArena(
+			IN AurieArena& Arena
+		);
+
+		// Moves up to AURIE_ARENA_CACHE_BATCH blocks of a size class from the arena into a thread cache bin
+		void MmpArenaRefill(
+			IN AurieArena& Arena,
+			IN size_t SizeClass,
+			IN OUT AurieArenaFreeBlock*& Blocks,
+			IN OUT uint32_t& BlockCount
+		);
+
+		// Moves up to BlockCount blocks from a thread cache bin back to the arena's free list
+		void MmpArenaDrain(
+			IN AurieArena& Arena,
+			IN size_t SizeClass,
+			IN OUT AurieArenaFreeBlock*& Blocks,
+			IN OUT uint32_t& BlockCount,
+			IN uint32_t DrainCount
+		);
+
+		// Marks or unmarks ChunkBase as the start of an arena chunk, see MMP_CHUNK_MAP_LEAF_CHUNKS.
+		// Only fails to mark it if there's no memory for the map.
+		bool MmpSetArenaChunk(
+			IN uintptr_t ChunkBase,
+			IN bool IsArenaChunk
+		);
+
+		bool MmpIsArenaChunk(
+			IN uintptr_t ChunkBase
+		);
+
+		// The caller must hold the arena's lock exclusively
+		AurieArenaChunk* MmpArenaAllocateChunk(
+			IN OUT AurieArenaChunk*& ChunkList,
+			IN size_t Size
+		);
+
+		uint32_t MmpArenaGetCanary(
+			IN const AurieArenaBlockHeader* Header
 		);
 
 		EXPORTED bool MmpIsAllocatedMemory(
@@ -108,9 +336,22 @@ namespace Aurie
 			OUT uintptr_t& PatternBase
 		);
 
-		void MmpRemoveAllocationsFromTable(
-			IN AurieModule* OwnerModule,
-			IN const PVOID AllocationBase
+		// Rebuilds the snapshot hook lookups go through, the caller must hold HookTableLock exclusively
+		void MmpPublishHookSnapshot(
+			IN AurieModule* Module
+		);
+
+		// Hooks taken out of a module at once, kept alive until lookups are done with them
+		struct MmpRemovedHooks
+		{
+			std::list<AurieInlineHook> InlineHooks;
+			std::list<AurieMidHook> MidHooks;
+			std::list<AurieVmtHook> VmtHooks;
+		};
+
+		// Unhooks and removes every hook a module made
+		void MmpRemoveAllHooks(
+			IN AurieModule* Module
 		);
 
 		AurieInlineHook* MmpAddInlineHookToTable(
@@ -135,6 +376,12 @@ namespace Aurie
 			IN bool RemoveFromTable
 		);
 
+		AurieStatus MmpRemoveVmtHook(
+			IN AurieModule* Module,
+			IN AurieVmtHook* Hook,
+			IN bool RemoveFromTable
+		);
+
 		AurieStatus MmpRemoveHook(
 			IN AurieModule* Module,
 			IN std::string_view HookIdentifier,
@@ -151,6 +398,23 @@ namespace Aurie
 			IN AurieMidHook* Hook
 		);
 
+		AurieVmtHook* MmpAddVmtHookToTable(
+			IN AurieModule* OwnerModule,
+			IN AurieVmtHook&& Hook
+		);
+
+		void MmpRemoveVmtHookFromTable(
+			IN AurieModule* Module,
+			IN AurieVmtHook* Hook
+		);
+
+		// The hook found by these is only valid for as long as the caller stays in an RCU read section
+		AurieStatus MmpLookupVmtHookByName(
+			IN AurieModule* Module,
+			IN std::string_view HookIdentifier,
+			OUT AurieVmtHook*& Hook
+		);
+
 		AurieStatus MmpLookupInlineHookByName(
 			IN AurieModule* Module,
 			IN std::string_view HookIdentifier,
@@ -167,19 +431,157 @@ namespace Aurie
 			IN AurieModule* Module,
 			IN std::string_view HookIdentifier,
 			IN PVOID SourceFunction,
-			IN PVOID DestinationFunction
+			IN PVOID DestinationFunction,
+			IN AurieHookFlags Flags
 		);
 
 		AurieMidHook* MmpCreateMidHook(
 			IN AurieModule* Module,
 			IN std::string_view HookIdentifier,
 			IN PVOID SourceInstruction,
-			IN AurieMidHookFunction TargetFunction
+			IN AurieMidHookFunction TargetFunction,
+			IN AurieHookFlags Flags
+		);
+
+		AurieMidHook* MmpCreateLightMidHook(
+			IN AurieModule* Module,
+			IN std::string_view HookIdentifier,
+			IN PVOID SourceInstruction,
+			IN AurieMidHookFunction TargetFunction,
+			IN AurieMidHookRegisters Registers,
+			IN AurieHookFlags Flags
+		);
+
+		// Builds a midhook stub with the same ProcessorContext64 layout as SafetyHook's,
+		// but only saves / restores the XMM registers set in XmmMask.
+		void MmpEmitLightMidHookStub(
+			IN uint32_t XmmMask,
+			OUT std::vector<uint8_t>& Code,
+			OUT size_t& DestinationOffset,
+			OUT size_t& TrampolineOffset
 		);
 
+		// Emits a stub that wraps Destination and feeds the counters next to it.
+		// Inline hook stubs call Destination from a frame of their own, midhook stubs wrap the handler call.
+		// The result lives until the process exits.
+		AurieStatus MmpCreateInstrumentation(
+			IN bool IsMidHook,
+			IN PVOID Destination,
+			OUT AurieHookInstrumentation*& Instrumentation
+		);
+
+		AurieStatus MmpLookupHookCounters(
+			IN AurieModule* Module,
+			IN std::string_view HookIdentifier,
+			OUT AurieHookCounters*& Counters
+		);
+
+		// Index of the counter slot the calling thread writes to
+		size_t MmpGetHookCounterSlot();
+
+		// Called from the instrumentation thunks
+		void MmpRecordHookSample(
+			IN AurieHookCounters* Counters,
+			IN uint64_t Cycles
+		) noexcept;
+
+		// Registers AURIE_HOOK_STATISTICS_INTERFACE_NAME under the initial image
+		AurieStatus MmpRegisterHookStatisticsInterface();
+
 		void MmpFreezeCurrentProcess();
 
 		void MmpResumeCurrentProcess();
+
+		// Where a slab of an object pool starts in its chunk, it's always a large block
+		constexpr size_t MMP_POOL_SLAB_OFFSET = sizeof(AurieArenaChunk) + sizeof(AurieArenaBlockHeader);
+
+		// Every AURIE_ARENA_CHUNK_SIZE step of the address space has a bit that's set while an arena chunk starts there.
+		// Leaves of the map cover 16 GB each and are allocated as needed, the root covers 128 TB of user-mode address space.
+		constexpr size_t MMP_CHUNK_MAP_LEAF_CHUNKS = size_t(1) << 18;
+		constexpr size_t MMP_CHUNK_MAP_ROOT_ENTRIES = static_cast<size_t>((uint64_t(1) << 47) / (uint64_t(AURIE_ARENA_CHUNK_SIZE) * MMP_CHUNK_MAP_LEAF_CHUNKS));
+
+		// Set in the environment to a file path, the startup timeline gets written there once every module is initialized
+		inline constexpr const wchar_t* MMP_TRACE_VARIABLE = L"AURIE_TRACE";
+
+		// Spans past this many are dropped, the buffer is never grown
+		constexpr uint32_t MMP_TRACE_CAPACITY = 8192;
+		constexpr size_t MMP_TRACE_DETAIL_LENGTH = 64;
+		constexpr uint32_t MMP_TRACE_DROPPED = UINT32_MAX;
+
+		struct MmpTraceEvent
+		{
+			// Always a string literal
+			const char* Name;
+
+			// Module file name or hook identifier, cut short if it doesn't fit
+			char Detail[MMP_TRACE_DETAIL_LENGTH];
+			uint32_t ThreadId;
+
+			// QueryPerformanceCounter ticks. StartTicks is stored last, and EndTicks is zero while the span is open.
+			std::atomic<int64_t> StartTicks;
+			std::atomic<int64_t> EndTicks;
+		};
+
+		// Every thread claims events by bumping the count, no locks or allocations while recording
+		inline MmpTraceEvent g_MmTraceEvents[MMP_TRACE_CAPACITY];
+		inline std::atomic<uint32_t> g_MmTraceEventCount = 0;
+
+		// Returns the event to pass to MmpEndTraceSpan, or MMP_TRACE_DROPPED if the buffer is full
+		uint32_t MmpBeginTraceSpan(
+			IN const char* Name,
+			IN std::string_view Detail = std::string_view()
+		) noexcept;
+
+		// Same as above, but only the file name of ImagePath is kept
+		uint32_t MmpBeginTraceSpan(
+			IN const char* Name,
+			IN const fs::path& ImagePath
+		) noexcept;
+
+		void MmpEndTraceSpan(
+			IN uint32_t EventIndex
+		) noexcept;
+
+		void MmpAppendJsonString(
+			IN std::string_view Value,
+			IN OUT std::string& Json
+		);
+
+		// Records a span for as long as the object lives.
+		// Spans on the same thread show up nested in the trace viewer if they're nested in time.
+		class MmpTraceSpan
+		{
+			uint32_t m_EventIndex;
+
+		public:
+			explicit MmpTraceSpan(
+				IN const char* Name
+			) : m_EventIndex(MmpBeginTraceSpan(Name))
+			{
+			}
+
+			MmpTraceSpan(
+				IN const char* Name,
+				IN std::string_view Detail
+			) : m_EventIndex(MmpBeginTraceSpan(Name, Detail))
+			{
+			}
+
+			MmpTraceSpan(
+				IN const char* Name,
+				IN const fs::path& ImagePath
+			) : m_EventIndex(MmpBeginTraceSpan(Name, ImagePath))
+			{
+			}
+
+			~MmpTraceSpan()
+			{
+				MmpEndTraceSpan(m_EventIndex);
+			}
+
+			MmpTraceSpan(const MmpTraceSpan&) = delete;
+			MmpTraceSpan& operator=(const MmpTraceSpan&) = delete;
+		};
 	}
 }
 
@@ -1,5 +1,8 @@
 #include "module.hpp"
 #include <Psapi.h>
+#include <fstream>
+#include <optional>
+#include <unordered_set>
 
 namespace Aurie
 {
@@ -18,6 +21,10 @@ namespace Aurie
 		temp_module.Flags.Bitfield = BitFlags;
 		temp_module.ImagePath = ImagePath;
 
+		// Computed once here, so looking a module up by path doesn't have to touch every loaded module's file
+		temp_module.CanonicalImagePath = MdpCanonicalizePath(ImagePath);
+		temp_module.HasImageIdentity = AurieSuccess(MdpQueryFileIdentity(ImagePath, temp_module.ImageIdentity));
+
 		if (ProcessExports)
 		{
 			last_status = MdpProcessImageExports(
@@ -65,22 +72,153 @@ namespace Aurie
 
 	void Internal::MdpPurgeMarkedModules()
 	{
+		std::vector<AurieModule*> purged_modules;
+
 		// Loop through all the modules marked for purge
-		for (auto& module : g_LdrModuleList)
 		{
-			// Unmap the module, but don't call the unload routine, and don't remove it from the list
-			if (MdpIsModuleMarkedForPurge(&module))
-				MdpUnmapImage(&module, false, false);
-		}
+			AurieRcuReadGuard rcu_guard;
 
-		// Remove the now unloaded modules from our list
-		// Note we can't do this in the for loop, since that'd invalidate the iterators
-		g_LdrModuleList.remove_if(
-			[](AurieModule& Module) -> bool
+			const MdpModuleSnapshot* module_snapshot = g_LdrModuleSnapshot.Load();
+			if (!module_snapshot)
+				return;
+
+			for (AurieModule* module : module_snapshot->Modules)
 			{
-				return MdpIsModuleMarkedForPurge(&Module);
+				if (MdpIsModuleMarkedForPurge(module))
+					purged_modules.push_back(module);
 			}
+		}
+
+		// Unmap the module, but don't call the unload routine, and don't remove it from the list
+		for (AurieModule* module : purged_modules)
+			MdpUnmapImage(module, false, false);
+
+		// Remove the now unloaded modules from our list
+		AurieExclusiveLock module_list_lock(g_LdrModuleListLock);
+
+		for (AurieModule* module : purged_modules)
+			MdpRetireModule(module);
+	}
+
+	void Internal::MdpPublishModuleSnapshot()
+	{
+		auto module_snapshot = std::make_unique<MdpModuleSnapshot>();
+		module_snapshot->Modules = g_LdrModuleRegistry.Modules;
+		module_snapshot->SlotPositions.assign(g_LdrModuleRegistry.Slots.size(), MDP_INVALID_POSITION);
+		module_snapshot->SlotGenerations.reserve(g_LdrModuleRegistry.Slots.size());
+
+		for (const auto& slot : g_LdrModuleRegistry.Slots)
+			module_snapshot->SlotGenerations.push_back(slot.Generation);
+
+		for (size_t position = 0; position < module_snapshot->Modules.size(); position++)
+		{
+			AurieModule* module = module_snapshot->Modules[position];
+
+			module_snapshot->SlotPositions[module->RegistrySlot] = static_cast<uint32_t>(position);
+			module_snapshot->PathIndex.emplace(module->CanonicalImagePath, module);
+
+			if (module->HasImageIdentity)
+				module_snapshot->IdentityIndex.emplace(module->ImageIdentity, module);
+		}
+
+		g_LdrModuleSnapshot.Publish(std::move(module_snapshot));
+	}
+
+	std::wstring Internal::MdpCanonicalizePath(
+		IN const fs::path& Path
+	)
+	{
+		std::error_code ec;
+
+		// fs::absolute only looks at the current directory, unlike fs::canonical it doesn't touch the file
+		fs::path absolute_path = fs::absolute(Path, ec);
+		if (ec)
+			absolute_path = Path;
+
+		std::wstring canonical_path = absolute_path.lexically_normal().wstring();
+
+		// Paths are case-insensitive on Windows
+		for (wchar_t& character : canonical_path)
+			character = static_cast<wchar_t>(towlower(character));
+
+		return canonical_path;
+	}
+
+	AurieStatus Internal::MdpQueryFileIdentity(
+		IN const fs::path& Path,
+		OUT AurieFileIdentity& Identity
+	)
+	{
+		// Attributes are all we need, and this works on files other processes have open
+		HANDLE file_handle = CreateFileW(
+			Path.wstring().c_str(),
+			FILE_READ_ATTRIBUTES,
+			FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			nullptr,
+			OPEN_EXISTING,
+			FILE_FLAG_BACKUP_SEMANTICS,
+			nullptr
+		);
+
+		if (file_handle == INVALID_HANDLE_VALUE)
+			return AURIE_FILE_NOT_FOUND;
+
+		BY_HANDLE_FILE_INFORMATION file_information = {};
+		BOOL has_information = GetFileInformationByHandle(
+			file_handle,
+			&file_information
 		);
+
+		CloseHandle(file_handle);
+
+		if (!has_information)
+			return AURIE_EXTERNAL_ERROR;
+
+		Identity.VolumeSerial = file_information.dwVolumeSerialNumber;
+		Identity.FileIndex = (static_cast<uint64_t>(file_information.nFileIndexHigh) << 32) | file_information.nFileIndexLow;
+
+		return AURIE_SUCCESS;
+	}
+
+	void Internal::MdpRetireModule(
+		IN AurieModule* Module
+	)
+	{
+		uint32_t slot_index = Module->RegistrySlot;
+		if (slot_index >= g_LdrModuleRegistry.Slots.size())
+			return;
+
+		MdpModuleSlot& slot = g_LdrModuleRegistry.Slots[slot_index];
+		if (slot.Module.get() != Module)
+			return;
+
+		// Handles to the old module stop resolving once the new generation is published
+		std::unique_ptr<AurieModule> removed_module = std::move(slot.Module);
+		slot.Generation++;
+
+		g_LdrModuleRegistry.FreeSlots.push_back(slot_index);
+		std::erase(g_LdrModuleRegistry.Modules, Module);
+
+		// The new snapshot has to be out before the module is retired
+		MdpPublishModuleSnapshot();
+		ObpRcuRetireObject(std::move(removed_module));
+	}
+
+	bool Internal::MdpLocateModule(
+		IN const MdpModuleSnapshot& Snapshot,
+		IN AurieModule* Module,
+		OUT size_t& Position
+	)
+	{
+		if (!Module || Module->RegistrySlot >= Snapshot.SlotPositions.size())
+			return false;
+
+		uint32_t position = Snapshot.SlotPositions[Module->RegistrySlot];
+		if (position == MDP_INVALID_POSITION || Snapshot.Modules[position] != Module)
+			return false;
+
+		Position = position;
+		return true;
 	}
 
 	AurieStatus Internal::MdpMapImage(
@@ -88,210 +226,1205 @@ namespace Aurie
 		OUT HMODULE& ImageBase
 	)
 	{
+		MdpImageDescriptor image_descriptor = {};
+		MdpPreflightImage(
+			ImagePath,
+			true,
+			image_descriptor
+		);
+
+		return MdpMapPreflightedImage(
+			image_descriptor,
+			ImageBase,
+			nullptr
+		);
+	}
+
+	AurieStatus Internal::MdpPreflightImage(
+		IN const fs::path& ImagePath,
+		IN bool UseShadowImage,
+		OUT MdpImageDescriptor& Descriptor
+	)
+	{
+		MmpTraceSpan trace_span("PreflightImage", ImagePath);
+
+		AurieStatus last_status = AURIE_SUCCESS;
+
+		Descriptor = {};
+		Descriptor.ImagePath = ImagePath;
+
 		// If the file doesn't exist, we have nothing to map
 		std::error_code ec;
 		if (!fs::exists(ImagePath, ec))
-			return AURIE_FILE_NOT_FOUND;
+			return Descriptor.PreflightStatus = AURIE_FILE_NOT_FOUND;
+
+		// The original can be rebuilt at any moment in hot reload mode, so check the copy that'll be loaded
+		fs::path source_path = ImagePath;
+		if (UseShadowImage && g_LdrHotReload.IsEnabled)
+		{
+			last_status = MdpCreateShadowImage(
+				ImagePath,
+				source_path
+			);
+
+			if (!AurieSuccess(last_status))
+				return Descriptor.PreflightStatus = last_status;
+		}
+
+		// Unchanged images don't have to be parsed again, copies keep the timestamp and are cached under the original's path
+		MdpImageFingerprint image_fingerprint = {};
+		const bool has_fingerprint = AurieSuccess(MdpQueryImageFingerprint(source_path, image_fingerprint));
+		image_fingerprint.ImagePath = ImagePath.wstring();
+
+		if (has_fingerprint && MdpLookupManifestCache(image_fingerprint, Descriptor))
+		{
+			last_status = Descriptor.PreflightStatus;
+		}
+		else
+		{
+			last_status = MdpInspectImage(
+				source_path,
+				Descriptor
+			);
+
+			// Failing to read the file says nothing about its contents, so that's not worth remembering
+			if (has_fingerprint && last_status != AURIE_ACCESS_DENIED && last_status != AURIE_INSUFFICIENT_MEMORY)
+				MdpStoreManifestCache(image_fingerprint, Descriptor);
+		}
+
+		// Nothing is going to load a copy that failed preflight
+		if (source_path != ImagePath)
+		{
+			if (AurieSuccess(last_status))
+				Descriptor.ShadowImagePath = source_path;
+			else
+				fs::remove(source_path, ec);
+		}
 
+		return last_status;
+	}
+
+	AurieStatus Internal::MdpInspectImage(
+		IN const fs::path& ImagePath,
+		IN OUT MdpImageDescriptor& Descriptor
+	)
+	{
 		AurieStatus last_status = AURIE_SUCCESS;
 		unsigned short target_arch = 0, self_arch = 0;
-		
-		// Query the target image architecture
-		last_status = PpQueryImageArchitecture(
+
+		// Read the file once, everything below is parsed from this copy
+		void* image_base = nullptr;
+		size_t image_size = 0;
+		last_status = PpiMapFileToMemory(
 			ImagePath,
-			target_arch
+			image_base,
+			image_size
 		);
 
 		if (!AurieSuccess(last_status))
-			return last_status;
+			return Descriptor.PreflightStatus = last_status;
 
-		// Query the current architecture
-		last_status = PpGetCurrentArchitecture(
-			self_arch
+		// Query the target image architecture
+		last_status = PpiQueryImageArchitecture(
+			image_base,
+			target_arch
 		);
 
-		// If we fail to query the current architecture, we bail.
-		if (!AurieSuccess(last_status))
-			return last_status;
+		// Query the current architecture
+		if (AurieSuccess(last_status))
+			last_status = PpGetCurrentArchitecture(self_arch);
 
 		// Don't try to load modules which are the wrong architecture
-		if (target_arch != self_arch)
-			return AURIE_INVALID_ARCH;
+		if (AurieSuccess(last_status) && target_arch != self_arch)
+			last_status = AURIE_INVALID_ARCH;
 
-		// Make sure the image has the required exports
-		bool has_framework_init = PpFindFileExportByName(ImagePath, "__AurieFrameworkInit") != 0;
-		bool has_module_entry = PpFindFileExportByName(ImagePath, "ModuleInitialize") != 0;
-		bool has_module_preinit = PpFindFileExportByName(ImagePath, "ModulePreinitialize") != 0;
+		if (AurieSuccess(last_status))
+		{
+			auto find_export = [image_base](const char* ExportName) -> uintptr_t
+			{
+				uintptr_t export_offset = 0;
+				if (!AurieSuccess(PpiGetExportOffset(image_base, ExportName, export_offset)))
+					return 0;
+
+				return export_offset;
+			};
+
+			Descriptor.FrameworkInitializeOffset = find_export("__AurieFrameworkInit");
+			Descriptor.ModuleInitializeOffset = find_export("ModuleInitialize");
+			Descriptor.ModulePreinitializeOffset = find_export("ModulePreinitialize");
+			Descriptor.ModuleUnloadOffset = find_export("ModuleUnload");
+			Descriptor.ModuleCallbackOffset = find_export("ModuleOperationCallback");
+			Descriptor.ModuleReloadOffset = find_export("ModuleReload");
+
+			// If the image doesn't have a framework init function, we can't load it.
+			// If we don't have a module entry OR a module preinitialize function, we can't load either.
+			if (!Descriptor.FrameworkInitializeOffset)
+				last_status = AURIE_INVALID_SIGNATURE;
+			else if (!Descriptor.ModuleInitializeOffset && !Descriptor.ModulePreinitializeOffset)
+				last_status = AURIE_INVALID_SIGNATURE;
+		}
 
-		// If the image doesn't have a framework init function, we can't load it.
-		if (!has_framework_init)
-			return AURIE_INVALID_SIGNATURE;
+		if (AurieSuccess(last_status))
+		{
+			last_status = MdpParseImageManifest(
+				image_base,
+				image_size,
+				Descriptor
+			);
+		}
 
-		// If we don't have a module entry OR a module preinitialize function, we can't load.
-		bool has_either_entry = has_module_entry || has_module_preinit;
-		if (!has_either_entry)
-			return AURIE_INVALID_SIGNATURE;
+		delete[] static_cast<char*>(image_base);
 
-		AurieModule* potential_loaded_copy = nullptr;
-		last_status = MdpLookupModuleByPath(
-			ImagePath,
-			potential_loaded_copy
-		);
+		return Descriptor.PreflightStatus = last_status;
+	}
 
-		// If there's a module that's already loaded from the same path, deny loading it twice
-		if (AurieSuccess(last_status))
-			return AURIE_OBJECT_ALREADY_EXISTS;
+	AurieStatus Internal::MdpParseImageManifest(
+		IN void* Image,
+		IN size_t ImageSize,
+		IN OUT MdpImageDescriptor& Descriptor
+	)
+	{
+		uint32_t manifest_offset = 0;
+		AurieStatus last_status = PpiGetExportFileOffset(
+			Image,
+			"AurieModuleManifest",
+			manifest_offset
+		);
 
-		// Load the image into memory and make sure we loaded it
-		HMODULE image_module = LoadLibraryW(ImagePath.wstring().c_str());
+		// Not having a manifest is fine
+		if (!AurieSuccess(last_status))
+			return AURIE_SUCCESS;
 
-		if (!image_module)
-			return AURIE_EXTERNAL_ERROR;
+		if (manifest_offset >= ImageSize)
+			return AURIE_FILE_PART_NOT_FOUND;
 
-		ImageBase = image_module;
-		return AURIE_SUCCESS;
+		return MdpParseManifestEntries(
+			std::string_view(static_cast<const char*>(Image) + manifest_offset, ImageSize - manifest_offset),
+			Descriptor
+		);
 	}
 
-	void Internal::MdpBuildModuleList(
-		IN const fs::path& BaseFolder, 
-		IN bool Recursive, 
-		IN std::function<bool(const fs::directory_entry& Entry)> Predicate,
-		OUT std::vector<fs::path>& Files
+	AurieStatus Internal::MdpParseManifestEntries(
+		IN std::string_view ManifestData,
+		IN OUT MdpImageDescriptor& Descriptor
 	)
 	{
-		std::error_code ec;
-		Files.clear();
-
-		if (Recursive)
+		// Entries are strings laid out back to back, terminated by an empty one
+		std::string_view manifest_data = ManifestData;
+		while (true)
 		{
-			for (auto& entry : fs::recursive_directory_iterator(BaseFolder, ec))
-				if (Predicate(entry))
-					Files.push_back(entry.path());
-
-			return;
+			size_t entry_length = manifest_data.find('\0');
+			if (entry_length == std::string_view::npos)
+				return AURIE_FILE_PART_NOT_FOUND;
+
+			std::string_view entry = manifest_data.substr(0, entry_length);
+			manifest_data.remove_prefix(entry_length + 1);
+
+			if (entry.empty())
+				break;
+
+			// Unknown entries are skipped, they may come from a newer framework version
+			if (entry.starts_with("requires="))
+				Descriptor.RequiredInterfaces.emplace_back(entry.substr(strlen("requires=")));
+			else if (entry.starts_with("provides="))
+				Descriptor.ProvidedInterfaces.emplace_back(entry.substr(strlen("provides=")));
+			else if (entry == "parallel")
+				Descriptor.ParallelInitialize = true;
+			else if (entry == "async")
+				Descriptor.AsyncInitialize = true;
+			else if (entry == "lazy")
+				Descriptor.LazyLoad = true;
 		}
 
-		for (auto& entry : fs::recursive_directory_iterator(BaseFolder, ec))
-			if (Predicate(entry))
-				Files.push_back(entry.path());	
+		return AURIE_SUCCESS;
 	}
 
-	AurieModule* Internal::MdpAddModuleToList(
-		IN AurieModule&& Module
+	uint64_t Internal::MdpHashBytes(
+		IN const void* Data,
+		IN size_t Size,
+		IN uint64_t Hash
 	)
 	{
-		return &g_LdrModuleList.emplace_back(std::move(Module));
+		// FNV-1a, same as the interface index
+		const unsigned char* bytes = static_cast<const unsigned char*>(Data);
+
+		for (size_t i = 0; i < Size; i++)
+			Hash = (Hash ^ bytes[i]) * 0x100000001B3;
+
+		return Hash;
 	}
 
-	AurieStatus Internal::MdpQueryModuleInformation(
-		IN HMODULE Module, 
-		OPTIONAL OUT PVOID* ModuleBase,
-		OPTIONAL OUT uint32_t* SizeOfModule, 
-		OPTIONAL OUT PVOID* EntryPoint
+	AurieStatus Internal::MdpQueryImageFingerprint(
+		IN const fs::path& ImagePath,
+		OUT MdpImageFingerprint& Fingerprint
 	)
 	{
-		// Query the information by asking Windows
-		MODULEINFO module_info = {};
-		if (!GetModuleInformation(
-			GetCurrentProcess(),
-			Module,
-			&module_info,
-			sizeof(module_info)
-		))
-		{
-			return AURIE_EXTERNAL_ERROR;
-		}
+		std::error_code ec;
 
-		// Fill in what the caller wants
-		if (ModuleBase)
-			*ModuleBase = module_info.lpBaseOfDll;
+		uintmax_t file_size = fs::file_size(ImagePath, ec);
+		if (ec)
+			return AURIE_FILE_NOT_FOUND;
 
-		if (SizeOfModule)
-			*SizeOfModule = module_info.SizeOfImage;
+		fs::file_time_type last_write_time = fs::last_write_time(ImagePath, ec);
+		if (ec)
+			return AURIE_FILE_NOT_FOUND;
 
-		if (EntryPoint)
-			*EntryPoint = module_info.EntryPoint;
+		// Size and timestamp can be preserved by copying tools, the headers rarely survive a rebuild unchanged
+		char header_data[MDP_MANIFEST_CACHE_HEADER_BYTES] = {};
+
+		std::ifstream image_file(ImagePath, std::ios::binary);
+		if (!image_file.is_open())
+			return AURIE_ACCESS_DENIED;
+
+		image_file.read(header_data, sizeof(header_data));
+
+		Fingerprint.ImagePath = ImagePath.wstring();
+		Fingerprint.FileSize = static_cast<uint64_t>(file_size);
+		Fingerprint.LastWriteTime = static_cast<int64_t>(last_write_time.time_since_epoch().count());
+		Fingerprint.HeaderHash = MdpHashBytes(header_data, static_cast<size_t>(image_file.gcount()));
 
 		return AURIE_SUCCESS;
 	}
 
-	fs::path& Internal::MdpGetImagePath(
-		IN AurieModule* Module
+	bool Internal::MdpLookupManifestCache(
+		IN const MdpImageFingerprint& Fingerprint,
+		OUT MdpImageDescriptor& Descriptor
 	)
 	{
-		return Module->ImagePath;
+		AurieSharedLock cache_lock(g_LdrManifestCache.Lock);
+
+		auto iterator = g_LdrManifestCache.Entries.find(Fingerprint.ImagePath);
+		if (iterator == g_LdrManifestCache.Entries.end())
+			return false;
+
+		const MdpManifestCacheEntry& cache_entry = iterator->second;
+		if (cache_entry.Fingerprint.FileSize != Fingerprint.FileSize ||
+			cache_entry.Fingerprint.LastWriteTime != Fingerprint.LastWriteTime ||
+			cache_entry.Fingerprint.HeaderHash != Fingerprint.HeaderHash)
+		{
+			return false;
+		}
+
+		Descriptor = cache_entry.Descriptor;
+		return true;
 	}
 
-	AurieStatus Internal::MdpGetImageFolder(
-		IN AurieModule* Module, 
-		OUT fs::path& Path
+	void Internal::MdpStoreManifestCache(
+		IN const MdpImageFingerprint& Fingerprint,
+		IN const MdpImageDescriptor& Descriptor
 	)
 	{
-		fs::path& module_path = Internal::MdpGetImagePath(Module);
+		AurieExclusiveLock cache_lock(g_LdrManifestCache.Lock);
 
-		if (!module_path.has_parent_path())
-			return AURIE_INVALID_PARAMETER;
+		g_LdrManifestCache.Entries.insert_or_assign(
+			Fingerprint.ImagePath,
+			MdpManifestCacheEntry{ Fingerprint, Descriptor }
+		);
 
-		Path = module_path.parent_path();
-		return AURIE_SUCCESS;
+		g_LdrManifestCache.IsDirty = true;
 	}
 
-	AurieStatus Internal::MdpGetNextModule(
-		IN AurieModule* Module, 
-		OUT AurieModule*& NextModule
+	void Internal::MdpLoadManifestCache(
+		IN const fs::path& CachePath
 	)
 	{
-		// Find the module in our list (gets an iterator)
-		auto list_iterator = std::find(
-			g_LdrModuleList.begin(),
-			g_LdrModuleList.end(),
-			*Module
-		);
+		AurieExclusiveLock cache_lock(g_LdrManifestCache.Lock);
 
-		// Make sure that module is indeed in our list
-		if (list_iterator == std::end(g_LdrModuleList))
-			return AURIE_INVALID_PARAMETER;
+		g_LdrManifestCache.CachePath = CachePath;
+		g_LdrManifestCache.Entries.clear();
+		g_LdrManifestCache.IsDirty = false;
 
-		// Compute the distance from the beginning of the list to the module
-		size_t distance = std::distance(g_LdrModuleList.begin(), list_iterator);
+		void* cache_data = nullptr;
+		size_t cache_size = 0;
+		if (!AurieSuccess(PpiMapFileToMemory(CachePath, cache_data, cache_size)))
+			return;
 
-		// Advance to the next element
-		distance = (distance + 1) % g_LdrModuleList.size();
-		AurieModule& next_module = *std::next(g_LdrModuleList.begin(), distance);
+		// Anything wrong with the file just means starting over, it gets rewritten on the next save
+		const char* cache_bytes = static_cast<const char*>(cache_data);
+		do
+		{
+			if (cache_size < sizeof(MdpManifestCacheFileHeader))
+				break;
 
-		NextModule = &next_module;
-		
-		return AURIE_SUCCESS;
-	}
+			const MdpManifestCacheFileHeader* file_header = reinterpret_cast<const MdpManifestCacheFileHeader*>(cache_bytes);
+			if (file_header->Magic != MDP_MANIFEST_CACHE_MAGIC || file_header->Version != MDP_MANIFEST_CACHE_VERSION)
+				break;
 
-	PVOID Internal::MdpGetModuleBaseAddress(
-		IN AurieModule* Module
-	)
-	{
-		return Module->ImageBase.Pointer;
+			// Entries parsed by a different framework version might be missing something
+			if (file_header->FrameworkVersion != MDP_MANIFEST_CACHE_FRAMEWORK_VERSION)
+				break;
+
+			// The counts come straight from the file, they could overflow size_t on x86 if taken at face value
+			const uint64_t payload_size = cache_size - sizeof(MdpManifestCacheFileHeader);
+			if (file_header->EntryCount > payload_size / sizeof(MdpManifestCacheFileEntry))
+				break;
+
+			const uint64_t expected_entries_size = uint64_t(file_header->EntryCount) * sizeof(MdpManifestCacheFileEntry);
+			if (payload_size != expected_entries_size + file_header->StringTableSize)
+				break;
+
+			const size_t entries_size = static_cast<size_t>(expected_entries_size);
+
+			const char* payload = cache_bytes + sizeof(MdpManifestCacheFileHeader);
+			if (MdpHashBytes(payload, entries_size + file_header->StringTableSize) != file_header->Checksum)
+				break;
+
+			const MdpManifestCacheFileEntry* file_entries = reinterpret_cast<const MdpManifestCacheFileEntry*>(payload);
+			const char* string_table = payload + entries_size;
+
+			for (uint32_t i = 0; i < file_header->EntryCount; i++)
+			{
+				const MdpManifestCacheFileEntry& file_entry = file_entries[i];
+
+				const uint64_t path_end = uint64_t(file_entry.PathOffset) + uint64_t(file_entry.PathLength) * sizeof(wchar_t);
+				const uint64_t manifest_end = uint64_t(file_entry.ManifestOffset) + file_entry.ManifestLength;
+				if (path_end > file_header->StringTableSize || manifest_end > file_header->StringTableSize)
+					continue;
+
+				MdpManifestCacheEntry cache_entry = {};
+				cache_entry.Fingerprint.ImagePath.assign(
+					reinterpret_cast<const wchar_t*>(string_table + file_entry.PathOffset),
+					file_entry.PathLength
+				);
+				cache_entry.Fingerprint.FileSize = file_entry.FileSize;
+				cache_entry.Fingerprint.LastWriteTime = file_entry.LastWriteTime;
+				cache_entry.Fingerprint.HeaderHash = file_entry.HeaderHash;
+
+				MdpImageDescriptor& descriptor = cache_entry.Descriptor;
+				descriptor.ImagePath = cache_entry.Fingerprint.ImagePath;
+				descriptor.PreflightStatus = static_cast<AurieStatus>(file_entry.PreflightStatus);
+				descriptor.FrameworkInitializeOffset = static_cast<uintptr_t>(file_entry.FrameworkInitializeOffset);
+				descriptor.ModuleInitializeOffset = static_cast<uintptr_t>(file_entry.ModuleInitializeOffset);
+				descriptor.ModulePreinitializeOffset = static_cast<uintptr_t>(file_entry.ModulePreinitializeOffset);
+				descriptor.ModuleUnloadOffset = static_cast<uintptr_t>(file_entry.ModuleUnloadOffset);
+				descriptor.ModuleCallbackOffset = static_cast<uintptr_t>(file_entry.ModuleCallbackOffset);
+				descriptor.ModuleReloadOffset = static_cast<uintptr_t>(file_entry.ModuleReloadOffset);
+
+				if (file_entry.ManifestLength)
+				{
+					MdpParseManifestEntries(
+						std::string_view(string_table + file_entry.ManifestOffset, file_entry.ManifestLength),
+						descriptor
+					);
+				}
+
+				g_LdrManifestCache.Entries.insert_or_assign(
+					cache_entry.Fingerprint.ImagePath,
+					std::move(cache_entry)
+				);
+			}
+		} while (false);
+
+		delete[] static_cast<char*>(cache_data);
 	}
 
-	EXPORTED AurieStatus Internal::MdpLookupModuleByPath(
-		IN const fs::path& ModulePath,
-		OUT AurieModule*& Module
-	)
+	AurieStatus Internal::MdpSaveManifestCache()
 	{
-		auto iterator = std::find_if(
-			g_LdrModuleList.begin(),
-			g_LdrModuleList.end(),
-			[ModulePath](const AurieModule& Module) -> bool
+		AurieExclusiveLock cache_lock(g_LdrManifestCache.Lock);
+
+		if (!g_LdrManifestCache.IsDirty || g_LdrManifestCache.CachePath.empty())
+			return AURIE_SUCCESS;
+
+		std::vector<MdpManifestCacheFileEntry> file_entries;
+		std::string string_table;
+
+		for (auto iterator = g_LdrManifestCache.Entries.begin(); iterator != g_LdrManifestCache.Entries.end();)
+		{
+			const MdpManifestCacheEntry& cache_entry = iterator->second;
+
+			// Forget about images that are gone
+			std::error_code ec;
+			if (!fs::exists(cache_entry.Fingerprint.ImagePath, ec))
 			{
-				return fs::equivalent(ModulePath, Module.ImagePath);
+				iterator = g_LdrManifestCache.Entries.erase(iterator);
+				continue;
 			}
-		);
 
-		if (iterator == g_LdrModuleList.end())
-			return AURIE_OBJECT_NOT_FOUND;
+			const MdpImageDescriptor& descriptor = cache_entry.Descriptor;
+
+			MdpManifestCacheFileEntry file_entry = {};
+			file_entry.FileSize = cache_entry.Fingerprint.FileSize;
+			file_entry.LastWriteTime = cache_entry.Fingerprint.LastWriteTime;
+			file_entry.HeaderHash = cache_entry.Fingerprint.HeaderHash;
+			file_entry.FrameworkInitializeOffset = descriptor.FrameworkInitializeOffset;
+			file_entry.ModuleInitializeOffset = descriptor.ModuleInitializeOffset;
+			file_entry.ModulePreinitializeOffset = descriptor.ModulePreinitializeOffset;
+			file_entry.ModuleUnloadOffset = descriptor.ModuleUnloadOffset;
+			file_entry.ModuleCallbackOffset = descriptor.ModuleCallbackOffset;
+			file_entry.ModuleReloadOffset = descriptor.ModuleReloadOffset;
+			file_entry.PreflightStatus = descriptor.PreflightStatus;
+
+			// Keep wide strings aligned, so the table can be used in place
+			string_table.resize((string_table.size() + alignof(wchar_t) - 1) & ~(alignof(wchar_t) - 1));
+
+			file_entry.PathOffset = static_cast<uint32_t>(string_table.size());
+			file_entry.PathLength = static_cast<uint32_t>(cache_entry.Fingerprint.ImagePath.size());
+			string_table.append(
+				reinterpret_cast<const char*>(cache_entry.Fingerprint.ImagePath.data()),
+				cache_entry.Fingerprint.ImagePath.size() * sizeof(wchar_t)
+			);
 
-		Module = &(*iterator);
-		
-		return AURIE_SUCCESS;
-	}
+			// The manifest is stored the same way the image exports it
+			std::string manifest_data;
+			for (const auto& interface_name : descriptor.RequiredInterfaces)
+				manifest_data.append("requires=").append(interface_name).push_back('\0');
+
+			for (const auto& interface_name : descriptor.ProvidedInterfaces)
+				manifest_data.append("provides=").append(interface_name).push_back('\0');
+
+			if (descriptor.ParallelInitialize)
+				manifest_data.append("parallel").push_back('\0');
+
+			if (descriptor.AsyncInitialize)
+				manifest_data.append("async").push_back('\0');
+
+			if (descriptor.LazyLoad)
+				manifest_data.append("lazy").push_back('\0');
+
+			if (!manifest_data.empty())
+				manifest_data.push_back('\0');
+
+			file_entry.ManifestOffset = static_cast<uint32_t>(string_table.size());
+			file_entry.ManifestLength = static_cast<uint32_t>(manifest_data.size());
+			string_table.append(manifest_data);
+
+			file_entries.push_back(file_entry);
+			++iterator;
+		}
+
+		MdpManifestCacheFileHeader file_header = {};
+		file_header.Magic = MDP_MANIFEST_CACHE_MAGIC;
+		file_header.Version = MDP_MANIFEST_CACHE_VERSION;
+		file_header.FrameworkVersion = MDP_MANIFEST_CACHE_FRAMEWORK_VERSION;
+		file_header.EntryCount = static_cast<uint32_t>(file_entries.size());
+		file_header.StringTableSize = static_cast<uint32_t>(string_table.size());
+
+		const size_t entries_size = file_entries.size() * sizeof(MdpManifestCacheFileEntry);
+		file_header.Checksum = MdpHashBytes(file_entries.data(), entries_size);
+		file_header.Checksum = MdpHashBytes(string_table.data(), string_table.size(), file_header.Checksum);
+
+		// Write a copy and swap it in, so a crash halfway through never leaves a torn cache behind
+		fs::path temporary_path = g_LdrManifestCache.CachePath;
+		temporary_path += L".tmp";
+
+		{
+			std::ofstream cache_file(temporary_path, std::ios::binary | std::ios::trunc);
+			if (!cache_file.is_open())
+				return AURIE_ACCESS_DENIED;
+
+			cache_file.write(reinterpret_cast<const char*>(&file_header), sizeof(file_header));
+			cache_file.write(reinterpret_cast<const char*>(file_entries.data()), entries_size);
+			cache_file.write(string_table.data(), string_table.size());
+
+			if (!cache_file.good())
+				return AURIE_EXTERNAL_ERROR;
+		}
+
+		std::error_code ec;
+		fs::rename(temporary_path, g_LdrManifestCache.CachePath, ec);
+		if (ec)
+			return AURIE_EXTERNAL_ERROR;
+
+		g_LdrManifestCache.IsDirty = false;
+		return AURIE_SUCCESS;
+	}
+
+	void Internal::MdpOrderImages(
+		IN OUT std::vector<MdpImageDescriptor>& Descriptors
+	)
+	{
+		// Interface names are case-insensitive everywhere else, so they are here too
+		std::unordered_map<std::string, size_t> interface_providers;
+		for (size_t i = 0; i < Descriptors.size(); i++)
+		{
+			if (!AurieSuccess(Descriptors[i].PreflightStatus))
+				continue;
+
+			for (const auto& interface_name : Descriptors[i].ProvidedInterfaces)
+			{
+				std::string folded_name;
+				ObpFoldInterfaceName(interface_name.c_str(), folded_name);
+
+				interface_providers.emplace(std::move(folded_name), i);
+			}
+		}
+
+		// Edges go from a provider to the modules requiring it.
+		// Interfaces nobody in this batch provides are assumed to come from an already loaded module.
+		std::vector<std::vector<size_t>> dependents(Descriptors.size());
+		std::vector<size_t> unresolved_count(Descriptors.size(), 0);
+
+		for (size_t i = 0; i < Descriptors.size(); i++)
+		{
+			if (!AurieSuccess(Descriptors[i].PreflightStatus))
+				continue;
+
+			for (const auto& interface_name : Descriptors[i].RequiredInterfaces)
+			{
+				std::string folded_name;
+				ObpFoldInterfaceName(interface_name.c_str(), folded_name);
+
+				auto provider = interface_providers.find(folded_name);
+				if (provider == interface_providers.end() || provider->second == i)
+					continue;
+
+				dependents[provider->second].push_back(i);
+				unresolved_count[i]++;
+			}
+		}
+
+		// Peel off the modules with no unresolved dependencies, one wave at a time
+		std::vector<size_t> current_wave;
+		for (size_t i = 0; i < Descriptors.size(); i++)
+		{
+			if (AurieSuccess(Descriptors[i].PreflightStatus) && !unresolved_count[i])
+				current_wave.push_back(i);
+		}
+
+		std::vector<bool> is_ordered(Descriptors.size(), false);
+		for (uint32_t wave = 0; !current_wave.empty(); wave++)
+		{
+			std::vector<size_t> next_wave;
+
+			for (size_t index : current_wave)
+			{
+				Descriptors[index].InitializationWave = wave;
+				is_ordered[index] = true;
+
+				for (size_t dependent : dependents[index])
+				{
+					if (--unresolved_count[dependent] == 0)
+						next_wave.push_back(dependent);
+				}
+			}
+
+			// Keep the alphabetical order within a wave
+			std::sort(next_wave.begin(), next_wave.end());
+			current_wave = std::move(next_wave);
+		}
+
+		// Whatever is left is either in a cycle or depends on one
+		for (size_t i = 0; i < Descriptors.size(); i++)
+		{
+			if (!AurieSuccess(Descriptors[i].PreflightStatus) || is_ordered[i])
+				continue;
+
+			Descriptors[i].PreflightStatus = AURIE_MODULE_DEPENDENCY_NOT_RESOLVED;
+
+			std::wstring message = L"[Aurie] Not loading " + Descriptors[i].ImagePath.filename().wstring() + L", it's part of a dependency cycle or depends on one\n";
+			OutputDebugStringW(message.c_str());
+		}
+
+		// Failed images sort last, they're skipped anyway
+		std::stable_sort(
+			Descriptors.begin(),
+			Descriptors.end(),
+			[](const MdpImageDescriptor& First, const MdpImageDescriptor& Second) -> bool
+			{
+				const bool first_loads = AurieSuccess(First.PreflightStatus);
+				const bool second_loads = AurieSuccess(Second.PreflightStatus);
+
+				if (first_loads != second_loads)
+					return first_loads;
+
+				return First.InitializationWave < Second.InitializationWave;
+			}
+		);
+	}
+
+	void Internal::MdpDispatchInWaves(
+		IN const std::function<void(AurieModule* Module)>& Dispatch
+	)
+	{
+		// The list can change under us, modules may load or purge other modules from their entries.
+		// Rather than holding on to iterators, every pass looks for the first wave that hasn't been dispatched yet.
+		std::unordered_set<AurieModule*> dispatched_modules;
+
+		while (true)
+		{
+			std::vector<AurieModule*> parallel_modules;
+			std::vector<AurieModule*> serial_modules;
+			std::optional<uint32_t> current_wave;
+
+			{
+				AurieRcuReadGuard rcu_guard;
+
+				const MdpModuleSnapshot* module_snapshot = g_LdrModuleSnapshot.Load();
+				if (!module_snapshot)
+					break;
+
+				// Modules of one wave are next to each other, MdpMapFolder loads them in that order
+				for (AurieModule* module : module_snapshot->Modules)
+				{
+					if (dispatched_modules.contains(module))
+					{
+						if (current_wave)
+							break;
+
+						continue;
+					}
+
+					if (!current_wave)
+						current_wave = module->InitializationWave;
+					else if (module->InitializationWave != *current_wave)
+						break;
+
+					dispatched_modules.insert(module);
+
+					if (module->Flags.AllowsParallelInitialize)
+						parallel_modules.push_back(module);
+					else
+						serial_modules.push_back(module);
+				}
+			}
+
+			if (!current_wave)
+				break;
+
+			MdpDispatchBatch dispatch_batch = { parallel_modules, Dispatch };
+
+			PTP_WORK dispatch_work = nullptr;
+			if (parallel_modules.size() > 1)
+			{
+				dispatch_work = CreateThreadpoolWork(
+					MdpDispatchWorker,
+					&dispatch_batch,
+					nullptr
+				);
+			}
+
+			if (dispatch_work)
+			{
+				for (size_t i = 1; i < parallel_modules.size(); i++)
+					SubmitThreadpoolWork(dispatch_work);
+			}
+
+			for (AurieModule* module : serial_modules)
+				Dispatch(module);
+
+			// Picks up whatever the pool didn't get to, or everything if it couldn't be used
+			MdpDispatchWorker(
+				nullptr,
+				&dispatch_batch,
+				nullptr
+			);
+
+			if (dispatch_work)
+			{
+				WaitForThreadpoolWorkCallbacks(dispatch_work, FALSE);
+				CloseThreadpoolWork(dispatch_work);
+			}
+
+			// Everything the workers raised, in the order they raised it
+			for (const MdpDeferredOperation& operation : dispatch_batch.DeferredOperations)
+			{
+				// Another module of the wave may have unloaded it in the meantime
+				bool is_module_loaded = false;
+
+				{
+					AurieRcuReadGuard rcu_guard;
+
+					const MdpModuleSnapshot* module_snapshot = g_LdrModuleSnapshot.Load();
+					is_module_loaded = module_snapshot && std::find(
+						module_snapshot->Modules.begin(),
+						module_snapshot->Modules.end(),
+						operation.Module
+					) != module_snapshot->Modules.end();
+				}
+
+				if (is_module_loaded)
+				{
+					ObpDispatchModuleOperationCallbacks(
+						operation.Module,
+						operation.Entry,
+						operation.IsFutureCall
+					);
+				}
+			}
+		}
+	}
+
+	void CALLBACK Internal::MdpDispatchWorker(
+		IN OPTIONAL PTP_CALLBACK_INSTANCE Instance,
+		IN PVOID Context,
+		IN OPTIONAL PTP_WORK
+	)
+	{
+		MdpDispatchBatch* dispatch_batch = reinterpret_cast<MdpDispatchBatch*>(Context);
+
+		// The loader thread picks up modules too, it delivers their events right away.
+		// Pool threads are reused, so the batch is only set for as long as this runs.
+		MdpDispatchBatch* previous_batch = g_LdrWorkerBatch;
+		if (Instance)
+			g_LdrWorkerBatch = dispatch_batch;
+
+		for (
+			size_t module_index = dispatch_batch->NextModule.fetch_add(1, std::memory_order_relaxed);
+			module_index < dispatch_batch->Modules.size();
+			module_index = dispatch_batch->NextModule.fetch_add(1, std::memory_order_relaxed)
+		)
+		{
+			dispatch_batch->Dispatch(dispatch_batch->Modules[module_index]);
+		}
+
+		g_LdrWorkerBatch = previous_batch;
+	}
+
+	void Internal::MdpDispatchOperationEvent(
+		IN AurieModule* Module,
+		IN AurieEntry Entry,
+		IN bool IsFutureCall
+	)
+	{
+		if (MdpDispatchBatch* worker_batch = g_LdrWorkerBatch)
+		{
+			AurieExclusiveLock operation_lock(worker_batch->OperationLock);
+			worker_batch->DeferredOperations.push_back({ Module, Entry, IsFutureCall });
+
+			return;
+		}
+
+		// Same as the flag update in MdpAsyncInitializationWorker, and dropped along with the module's other tasks
+		if (g_LdrIsAsyncWorker)
+		{
+			ObpPostServiceTask(
+				Module,
+				[Module, Entry, IsFutureCall]
+				{
+					ObpDispatchModuleOperationCallbacks(
+						Module,
+						Entry,
+						IsFutureCall
+					);
+				}
+			);
+
+			return;
+		}
+
+		ObpDispatchModuleOperationCallbacks(
+			Module,
+			Entry,
+			IsFutureCall
+		);
+	}
+
+	bool Internal::MdpBeginAsyncInitialization(
+		IN AurieModule* Module
+	)
+	{
+		AurieAsyncInitialization* async_initialization = Module->AsyncInitialization.get();
+		if (!async_initialization)
+			return false;
+
+		// Has to be visible before the worker can finish, MdpUnmapImage waits for the module if it's set
+		async_initialization->HasStarted = true;
+
+		if (TrySubmitThreadpoolCallback(MdpAsyncInitializationWorker, Module, nullptr))
+			return true;
+
+		async_initialization->HasStarted = false;
+		return false;
+	}
+
+	void CALLBACK Internal::MdpAsyncInitializationWorker(
+		IN OPTIONAL PTP_CALLBACK_INSTANCE,
+		IN PVOID Context
+	)
+	{
+		AurieModule* module = reinterpret_cast<AurieModule*>(Context);
+		AurieAsyncInitialization* async_initialization = module->AsyncInitialization.get();
+
+		// Its operation events go through the service thread too, along with those of anything it maps
+		g_LdrIsAsyncWorker = true;
+
+		AurieStatus last_status = MdpDispatchEntry(
+			module,
+			module->ModuleInitialize
+		);
+
+		g_LdrIsAsyncWorker = false;
+
+		// Module flags are only ever written from the service thread, so the result is applied there.
+		// Until then, MdIsImageInitialized goes by the status.
+		ObpPostServiceTask(
+			module,
+			[module, last_status]
+			{
+				// Mark mods failed for loading for the purge
+				if (!AurieSuccess(last_status))
+					MdpMarkModuleForPurge(module);
+				else
+					module->Flags.IsInitialized = true;
+			}
+		);
+
+		async_initialization->Status = last_status;
+		async_initialization->IsComplete = true;
+
+		// The module may be unloaded as soon as this is set
+		SetEvent(async_initialization->CompletionEvent);
+	}
+
+	bool Internal::MdpIsAsyncInitializationPending(
+		IN AurieModule* Module
+	)
+	{
+		const AurieAsyncInitialization* async_initialization = Module->AsyncInitialization.get();
+		if (!async_initialization || !async_initialization->HasStarted)
+			return false;
+
+		return WaitForSingleObject(async_initialization->CompletionEvent, 0) == WAIT_TIMEOUT;
+	}
+
+	void Internal::MdpWaitForAsyncInitializations(
+		IN uint32_t Wave
+	)
+	{
+		// Waiting happens outside of the read section, the initializations keep themselves alive
+		std::vector<std::shared_ptr<AurieAsyncInitialization>> pending_initializations;
+
+		{
+			AurieRcuReadGuard rcu_guard;
+
+			const MdpModuleSnapshot* module_snapshot = g_LdrModuleSnapshot.Load();
+			if (!module_snapshot)
+				return;
+
+			for (AurieModule* module : module_snapshot->Modules)
+			{
+				if (module->InitializationWave >= Wave || !module->AsyncInitialization)
+					continue;
+
+				if (module->AsyncInitialization->HasStarted && !module->AsyncInitialization->IsComplete)
+					pending_initializations.push_back(module->AsyncInitialization);
+			}
+		}
+
+		for (const auto& async_initialization : pending_initializations)
+			WaitForSingleObject(async_initialization->CompletionEvent, INFINITE);
+	}
+
+	void Internal::MdpPreflightImages(
+		IN const std::vector<fs::path>& ImagePaths,
+		OUT std::vector<MdpImageDescriptor>& Descriptors
+	)
+	{
+		MmpTraceSpan trace_span("PreflightImages");
+
+		Descriptors.clear();
+		Descriptors.resize(ImagePaths.size());
+
+		MdpPreflightBatch preflight_batch = { ImagePaths, Descriptors };
+
+		SYSTEM_INFO system_info = {};
+		GetSystemInfo(&system_info);
+
+		// The current thread takes part too, so only spin up what's left of the cores
+		size_t worker_count = std::min<size_t>(system_info.dwNumberOfProcessors, ImagePaths.size());
+
+		PTP_WORK preflight_work = nullptr;
+		if (worker_count > 1)
+		{
+			preflight_work = CreateThreadpoolWork(
+				MdpPreflightWorker,
+				&preflight_batch,
+				nullptr
+			);
+		}
+
+		if (preflight_work)
+		{
+			for (size_t i = 1; i < worker_count; i++)
+				SubmitThreadpoolWork(preflight_work);
+		}
+
+		MdpPreflightWorker(
+			nullptr,
+			&preflight_batch,
+			nullptr
+		);
+
+		// If the pool couldn't be used, the loop above already went through every image
+		if (preflight_work)
+		{
+			WaitForThreadpoolWorkCallbacks(preflight_work, FALSE);
+			CloseThreadpoolWork(preflight_work);
+		}
+	}
+
+	void CALLBACK Internal::MdpPreflightWorker(
+		IN OPTIONAL PTP_CALLBACK_INSTANCE,
+		IN PVOID Context,
+		IN OPTIONAL PTP_WORK
+	)
+	{
+		MdpPreflightBatch* preflight_batch = reinterpret_cast<MdpPreflightBatch*>(Context);
+
+		// Images are handed out one at a time, so a few large files don't hold up a single worker
+		for (
+			size_t image_index = preflight_batch->NextImage.fetch_add(1, std::memory_order_relaxed);
+			image_index < preflight_batch->ImagePaths.size();
+			image_index = preflight_batch->NextImage.fetch_add(1, std::memory_order_relaxed)
+		)
+		{
+			MdpPreflightImage(
+				preflight_batch->ImagePaths[image_index],
+				true,
+				preflight_batch->Descriptors[image_index]
+			);
+		}
+	}
+
+	AurieStatus Internal::MdpMapPreflightedImage(
+		IN const MdpImageDescriptor& Descriptor,
+		OUT HMODULE& ImageBase,
+		OPTIONAL OUT fs::path* ShadowImagePath
+	)
+	{
+		if (!AurieSuccess(Descriptor.PreflightStatus))
+			return Descriptor.PreflightStatus;
+
+		// This can't be decided in preflight, since it depends on what was loaded before
+		AurieModule* potential_loaded_copy = nullptr;
+		AurieStatus last_status = MdpLookupModuleByPath(
+			Descriptor.ImagePath,
+			potential_loaded_copy
+		);
+
+		// If there's a module that's already loaded from the same path, deny loading it twice
+		if (AurieSuccess(last_status))
+		{
+			MdpDiscardShadowImage(Descriptor);
+			return AURIE_OBJECT_ALREADY_EXISTS;
+		}
+
+		// Windows won't let anyone write to a loaded image, so in hot reload mode we load the copy preflight checked
+		const fs::path& load_path = Descriptor.ShadowImagePath.empty() ? Descriptor.ImagePath : Descriptor.ShadowImagePath;
+
+		// Load the image into memory and make sure we loaded it
+		HMODULE image_module = LoadLibraryW(load_path.wstring().c_str());
+
+		if (!image_module)
+		{
+			MdpDiscardShadowImage(Descriptor);
+			return AURIE_EXTERNAL_ERROR;
+		}
+
+		if (ShadowImagePath && load_path != Descriptor.ImagePath)
+			*ShadowImagePath = load_path;
+
+		ImageBase = image_module;
+		return AURIE_SUCCESS;
+	}
+
+	void Internal::MdpBuildModuleList(
+		IN const fs::path& BaseFolder, 
+		IN bool Recursive, 
+		IN std::function<bool(const fs::directory_entry& Entry)> Predicate,
+		OUT std::vector<fs::path>& Files
+	)
+	{
+		std::error_code ec;
+		Files.clear();
+
+		if (Recursive)
+		{
+			for (auto& entry : fs::recursive_directory_iterator(BaseFolder, ec))
+				if (Predicate(entry))
+					Files.push_back(entry.path());
+
+			return;
+		}
+
+		for (auto& entry : fs::recursive_directory_iterator(BaseFolder, ec))
+			if (Predicate(entry))
+				Files.push_back(entry.path());	
+	}
+
+	AurieModule* Internal::MdpAddModuleToList(
+		IN AurieModule&& Module
+	)
+	{
+		AurieModule* module_object = nullptr;
+
+		{
+			AurieExclusiveLock module_list_lock(g_LdrModuleListLock);
+
+			uint32_t slot_index = 0;
+			if (g_LdrModuleRegistry.FreeSlots.empty())
+			{
+				slot_index = static_cast<uint32_t>(g_LdrModuleRegistry.Slots.size());
+				g_LdrModuleRegistry.Slots.emplace_back();
+			}
+			else
+			{
+				slot_index = g_LdrModuleRegistry.FreeSlots.back();
+				g_LdrModuleRegistry.FreeSlots.pop_back();
+			}
+
+			MdpModuleSlot& slot = g_LdrModuleRegistry.Slots[slot_index];
+			slot.Module = std::make_unique<AurieModule>(std::move(Module));
+			slot.Module->RegistrySlot = slot_index;
+
+			module_object = slot.Module.get();
+			g_LdrModuleRegistry.Modules.push_back(module_object);
+
+			MdpPublishModuleSnapshot();
+		}
+
+		// The arena is registered by address, so only do this once it's in its final place
+		MmpInitializeArena(module_object->MemoryArena);
+
+		// Same goes for event subscriptions, which hold on to the module pointer
+		if (module_object->ModuleOperationCallback)
+		{
+			ObpSetModuleOperationCallback(
+				module_object,
+				module_object->ModuleOperationCallback
+			);
+		}
+
+		return module_object;
+	}
+
+	AurieStatus Internal::MdpQueryModuleInformation(
+		IN HMODULE Module, 
+		OPTIONAL OUT PVOID* ModuleBase,
+		OPTIONAL OUT uint32_t* SizeOfModule, 
+		OPTIONAL OUT PVOID* EntryPoint
+	)
+	{
+		// Query the information by asking Windows
+		MODULEINFO module_info = {};
+		if (!GetModuleInformation(
+			GetCurrentProcess(),
+			Module,
+			&module_info,
+			sizeof(module_info)
+		))
+		{
+			return AURIE_EXTERNAL_ERROR;
+		}
+
+		// Fill in what the caller wants
+		if (ModuleBase)
+			*ModuleBase = module_info.lpBaseOfDll;
+
+		if (SizeOfModule)
+			*SizeOfModule = module_info.SizeOfImage;
+
+		if (EntryPoint)
+			*EntryPoint = module_info.EntryPoint;
+
+		return AURIE_SUCCESS;
+	}
+
+	fs::path& Internal::MdpGetImagePath(
+		IN AurieModule* Module
+	)
+	{
+		return Module->ImagePath;
+	}
+
+	AurieStatus Internal::MdpGetImageFolder(
+		IN AurieModule* Module, 
+		OUT fs::path& Path
+	)
+	{
+		fs::path& module_path = Internal::MdpGetImagePath(Module);
+
+		if (!module_path.has_parent_path())
+			return AURIE_INVALID_PARAMETER;
+
+		Path = module_path.parent_path();
+		return AURIE_SUCCESS;
+	}
+
+	AurieStatus Internal::MdpGetNextModule(
+		IN AurieModule* Module, 
+		OUT AurieModule*& NextModule
+	)
+	{
+		AurieRcuReadGuard rcu_guard;
+
+		const MdpModuleSnapshot* module_snapshot = g_LdrModuleSnapshot.Load();
+		if (!module_snapshot)
+			return AURIE_INVALID_PARAMETER;
+
+		// Make sure that module is indeed in our list
+		size_t position = 0;
+		if (!MdpLocateModule(*module_snapshot, Module, position))
+			return AURIE_INVALID_PARAMETER;
+
+		// Advance to the next element
+		position = (position + 1) % module_snapshot->Modules.size();
+		NextModule = module_snapshot->Modules[position];
+		
+		return AURIE_SUCCESS;
+	}
+
+	AurieStatus Internal::MdpGetPreviousModule(
+		IN AurieModule* Module,
+		OUT AurieModule*& PreviousModule
+	)
+	{
+		AurieRcuReadGuard rcu_guard;
+
+		const MdpModuleSnapshot* module_snapshot = g_LdrModuleSnapshot.Load();
+		if (!module_snapshot)
+			return AURIE_INVALID_PARAMETER;
+
+		size_t position = 0;
+		if (!MdpLocateModule(*module_snapshot, Module, position))
+			return AURIE_INVALID_PARAMETER;
+
+		position = (position + module_snapshot->Modules.size() - 1) % module_snapshot->Modules.size();
+		PreviousModule = module_snapshot->Modules[position];
+
+		return AURIE_SUCCESS;
+	}
+
+	PVOID Internal::MdpGetModuleBaseAddress(
+		IN AurieModule* Module
+	)
+	{
+		return Module->ImageBase.Pointer;
+	}
+
+	EXPORTED AurieStatus Internal::MdpLookupModuleByPath(
+		IN const fs::path& ModulePath,
+		OUT AurieModule*& Module
+	)
+	{
+		AurieRcuReadGuard rcu_guard;
+
+		const MdpModuleSnapshot* module_snapshot = g_LdrModuleSnapshot.Load();
+		if (!module_snapshot)
+			return AURIE_OBJECT_NOT_FOUND;
+
+		// The same spelling of the path is the common case, and needs no file system access at all
+		auto path_iterator = module_snapshot->PathIndex.find(MdpCanonicalizePath(ModulePath));
+		if (path_iterator != module_snapshot->PathIndex.end())
+		{
+			Module = path_iterator->second;
+			return AURIE_SUCCESS;
+		}
+
+		// Otherwise it might still be the same file through a link or a different volume path,
+		// which only takes opening the file we were asked about
+		AurieFileIdentity file_identity = {};
+		if (!AurieSuccess(MdpQueryFileIdentity(ModulePath, file_identity)))
+			return AURIE_OBJECT_NOT_FOUND;
+
+		auto identity_iterator = module_snapshot->IdentityIndex.find(file_identity);
+		if (identity_iterator == module_snapshot->IdentityIndex.end())
+			return AURIE_OBJECT_NOT_FOUND;
+
+		Module = identity_iterator->second;
+		
+		return AURIE_SUCCESS;
+	}
 
 	AurieStatus Internal::MdpProcessImageExports(
 		IN const fs::path& ImagePath, 
@@ -299,184 +1432,598 @@ namespace Aurie
 		IN OUT AurieModule* ModuleImage
 	)
 	{
-		// Find all the required functions
-		uintptr_t framework_init_offset = PpFindFileExportByName(ImagePath, "__AurieFrameworkInit");
-		uintptr_t module_init_offset = PpFindFileExportByName(ImagePath, "ModuleInitialize");
+		// The image is already loaded, only its exports are needed
+		MdpImageDescriptor image_descriptor = {};
+		MdpPreflightImage(
+			ImagePath,
+			false,
+			image_descriptor
+		);
+
+		return MdpApplyImageExports(
+			image_descriptor,
+			ImageBaseAddress,
+			ModuleImage
+		);
+	}
+
+	AurieStatus Internal::MdpApplyImageExports(
+		IN const MdpImageDescriptor& Descriptor,
+		IN HMODULE ImageBaseAddress,
+		IN OUT AurieModule* ModuleImage
+	)
+	{
+		// Cast the problems away
+		char* image_base = reinterpret_cast<char*>(ImageBaseAddress);
+
+		AurieEntry module_init = reinterpret_cast<AurieEntry>(image_base + Descriptor.ModuleInitializeOffset);
+		AurieEntry module_preload = reinterpret_cast<AurieEntry>(image_base + Descriptor.ModulePreinitializeOffset);
+		AurieEntry module_unload = reinterpret_cast<AurieEntry>(image_base + Descriptor.ModuleUnloadOffset);
+		AurieLoaderEntry framework_init = reinterpret_cast<AurieLoaderEntry>(image_base + Descriptor.FrameworkInitializeOffset);
+		AurieModuleCallback module_callback = reinterpret_cast<AurieModuleCallback>(image_base + Descriptor.ModuleCallbackOffset);
+		AurieReloadEntry module_reload = reinterpret_cast<AurieReloadEntry>(image_base + Descriptor.ModuleReloadOffset);
+
+		// If the offsets are zero, the function wasn't found, which means we shouldn't populate the field.
+		if (Descriptor.ModuleInitializeOffset)
+			ModuleImage->ModuleInitialize = module_init;
+
+		if (Descriptor.ModulePreinitializeOffset)
+			ModuleImage->ModulePreinitialize = module_preload;
+
+		if (Descriptor.FrameworkInitializeOffset)
+			ModuleImage->FrameworkInitialize = framework_init;
+
+		if (Descriptor.ModuleCallbackOffset)
+			ModuleImage->ModuleOperationCallback = module_callback;
+
+		if (Descriptor.ModuleUnloadOffset)
+			ModuleImage->ModuleUnload = module_unload;
+
+		if (Descriptor.ModuleReloadOffset)
+			ModuleImage->ModuleReload = module_reload;
+
+		// We always need __AurieFrameworkInit to exist.
+		// We also need either a ModuleInitialize or a ModulePreinitialize function.
+		bool has_either_entry = Descriptor.ModuleInitializeOffset || Descriptor.ModulePreinitializeOffset;
+		return (has_either_entry && Descriptor.FrameworkInitializeOffset) ? AURIE_SUCCESS : AURIE_FILE_PART_NOT_FOUND;
+	}
+
+	// The ignoring of return values here is on purpose, we just have to power through
+	// and unload / free what we can.
+	AurieStatus Internal::MdpUnmapImage(
+		IN AurieModule* Module,
+		IN bool RemoveFromList,
+		IN bool CallUnloadRoutine
+	)
+	{
+		AurieStatus last_status = AURIE_SUCCESS;
+
+		// Its code can't go away while its ModuleInitialize is still running on the thread pool.
+		// If it doesn't return in time, the module is left loaded rather than risking a deadlock.
+		const AurieAsyncInitialization* async_initialization = Module->AsyncInitialization.get();
+		if (async_initialization && async_initialization->HasStarted)
+		{
+			if (WaitForSingleObject(async_initialization->CompletionEvent, MDP_ASYNC_UNLOAD_TIMEOUT_MS) != WAIT_OBJECT_0)
+			{
+				std::wstring message = L"[Aurie] Not unloading " + Module->ImagePath.filename().wstring();
+				message += L", its ModuleInitialize is still running\n";
+				OutputDebugStringW(message.c_str());
+
+				return AURIE_UNAVAILABLE;
+			}
+		}
+
+		// We don't have to do anything else, since SafetyHook will handle everything for us.
+		// Truly a GOATed library, thank you @localcc for telling me about it love ya
+		MmpRemoveAllHooks(Module);
+
+		// Call the unload entry if needed
+		if (CallUnloadRoutine)
+		{
+			last_status = MdpDispatchEntry(
+				Module,
+				Module->ModuleUnload
+			);
+		}
+
+		// Remove the module's operation callback, along with anything else it subscribed to
+		Module->ModuleOperationCallback = nullptr;
+		ObpRemoveModuleSubscriptions(Module);
+
+		// Same goes for tasks it posted that haven't run yet
+		ObpRemoveModuleTasks(Module);
+
+		// Destory all interfaces created by the module
+		for (auto& module_interface : Module->InterfaceTable)
+		{
+			if (module_interface.Interface)
+				module_interface.Interface->Destroy();
+		}
+
+		// Wipe them off the interface table
+		// Note these can't be freed, they're allocated by the owner module
+		ObpRemoveModuleInterfaces(Module);
+
+		// Free all memory allocated by the module (except persistent memory)
+		MmpReleaseArena(Module->MemoryArena);
+
+		// Free the module
+		FreeLibrary(Module->ImageBase.Module);
+
+		// The copy it was loaded from is of no use to anyone now
+		std::error_code ec;
+		if (!Module->ShadowImagePath.empty())
+			fs::remove(Module->ShadowImagePath, ec);
+
+		// Remove the module from our list if needed
+		if (RemoveFromList)
+		{
+			AurieExclusiveLock module_list_lock(g_LdrModuleListLock);
+			MdpRetireModule(Module);
+		}
+
+		return last_status;
+	}
+
+	AurieStatus Internal::MdpDispatchEntry(
+		IN AurieModule* Module,
+		IN AurieEntry Entry
+	)
+	{
+		// Ignore dispatch attempts for the initial module
+		if (Module == g_ArInitialImage)
+			return AURIE_SUCCESS;
+
+		const char* entry_name = "ModuleEntry";
+		if (Entry == Module->ModulePreinitialize)
+			entry_name = "ModulePreinitialize";
+		else if (Entry == Module->ModuleInitialize)
+			entry_name = "ModuleInitialize";
+		else if (Entry == Module->ModuleUnload)
+			entry_name = "ModuleUnload";
+
+		MmpTraceSpan trace_span(entry_name, Module->ImagePath);
+
+		MdpDispatchOperationEvent(
+			Module, 
+			Entry, 
+			true
+		);
+
+		AurieStatus module_status = Module->FrameworkInitialize(
+			g_ArInitialImage,
+			PpGetFrameworkRoutine,
+			Entry,
+			MdpGetImagePath(Module),
+			Module
+		);
+
+		MdpDispatchOperationEvent(
+			Module, 
+			Entry, 
+			false
+		);
+
+		return module_status;
+	}
+
+	void Internal::MdpMapFolder(
+		IN const fs::path& Folder, 
+		IN bool Recursive,
+		IN bool IsRuntimeLoad,
+		OPTIONAL OUT size_t* NumberOfMappedModules
+	)
+	{
+		MmpTraceSpan trace_span("MapFolder", Folder);
+
+		std::vector<fs::path> modules_to_map;
+		uint32_t scan_trace_event = MmpBeginTraceSpan("ScanFolder", Folder);
+
+		MdpBuildModuleList(
+			Folder,
+			Recursive,
+			[](const fs::directory_entry& entry) -> bool
+			{
+				if (!entry.is_regular_file())
+					return false;
+
+				if (!entry.path().has_filename())
+					return false;
+
+				if (!entry.path().filename().has_extension())
+					return false;
+
+				if (entry.path().filename().extension().compare(L".dll"))
+					return false;
+
+				return true;
+			},
+			modules_to_map
+		);
+
+		std::sort(
+			modules_to_map.begin(),
+			modules_to_map.end()
+		);
+
+		MmpEndTraceSpan(scan_trace_event);
+
+		// Parsing and validating the files doesn't depend on load order, so it's done all at once.
+		// Only the mapping and entry dispatch below have to happen in order.
+		std::vector<MdpImageDescriptor> image_descriptors;
+		MdpPreflightImages(
+			modules_to_map,
+			image_descriptors
+		);
+
+		// Modules that declare dependencies are loaded after what they depend on
+		{
+			MmpTraceSpan order_trace_span("OrderImages");
+			MdpOrderImages(image_descriptors);
+		}
+
+		size_t loaded_count = 0;
+		for (auto& image_descriptor : image_descriptors)
+		{
+			AurieModule* loaded_module = nullptr;
+
+			if (!AurieSuccess(image_descriptor.PreflightStatus))
+				continue;
+
+			// Without anything to ask for, the image would never get loaded.
+			// It's preflighted again once it is, so the copy isn't needed until then.
+			if (image_descriptor.LazyLoad && !image_descriptor.ProvidedInterfaces.empty())
+			{
+				MdpDiscardShadowImage(image_descriptor);
+				MdpDeferImage(image_descriptor);
+				continue;
+			}
+
+			if (AurieSuccess(MdpLoadPreflightedImage(image_descriptor, IsRuntimeLoad, loaded_module)))
+				loaded_count++;
+		}
+
+		// Only does anything if something new was parsed
+		{
+			MmpTraceSpan save_trace_span("SaveManifestCache");
+			MdpSaveManifestCache();
+		}
+
+		if (NumberOfMappedModules)
+			*NumberOfMappedModules = loaded_count;
+	}
+
+	AurieStatus Internal::MdpEnableHotReload(
+		IN const fs::path& Folder
+	)
+	{
+		std::error_code ec;
+		fs::path shadow_root = fs::temp_directory_path(ec) / "aurie_hot_reload";
+		if (ec)
+			return AURIE_EXTERNAL_ERROR;
+
+		// Copies left behind by earlier runs, the ones still loaded by another process just fail to delete
+		for (auto& entry : fs::directory_iterator(shadow_root, ec))
+			fs::remove_all(entry.path(), ec);
+
+		fs::path shadow_folder = shadow_root / std::to_wstring(GetCurrentProcessId());
+		fs::create_directories(shadow_folder, ec);
+		if (ec)
+			return AURIE_EXTERNAL_ERROR;
+
+		g_LdrHotReload.WatchedFolder = Folder;
+		g_LdrHotReload.ShadowFolder = shadow_folder;
+		g_LdrHotReload.IsEnabled = true;
+
+		return AURIE_SUCCESS;
+	}
+
+	AurieStatus Internal::MdpStartHotReloadWatcher()
+	{
+		if (!g_LdrHotReload.IsEnabled)
+			return AURIE_ACCESS_DENIED;
+
+		if (g_LdrHotReload.WatcherThread)
+			return AURIE_OBJECT_ALREADY_EXISTS;
+
+		g_LdrHotReload.StopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+		if (!g_LdrHotReload.StopEvent)
+			return AURIE_EXTERNAL_ERROR;
+
+		g_LdrHotReload.WatcherThread = CreateThread(
+			nullptr,
+			0,
+			MdpHotReloadWatcher,
+			nullptr,
+			0,
+			nullptr
+		);
+
+		if (!g_LdrHotReload.WatcherThread)
+		{
+			CloseHandle(g_LdrHotReload.StopEvent);
+			g_LdrHotReload.StopEvent = nullptr;
+
+			return AURIE_EXTERNAL_ERROR;
+		}
+
+		return AURIE_SUCCESS;
+	}
+
+	void Internal::MdpStopHotReloadWatcher()
+	{
+		if (!g_LdrHotReload.WatcherThread)
+			return;
+
+		SetEvent(g_LdrHotReload.StopEvent);
+		WaitForSingleObject(g_LdrHotReload.WatcherThread, INFINITE);
+
+		CloseHandle(g_LdrHotReload.WatcherThread);
+		CloseHandle(g_LdrHotReload.StopEvent);
+
+		g_LdrHotReload.WatcherThread = nullptr;
+		g_LdrHotReload.StopEvent = nullptr;
+	}
+
+	AurieStatus Internal::MdpCreateShadowImage(
+		IN const fs::path& ImagePath,
+		OUT fs::path& ShadowImagePath
+	)
+	{
+		// A new name every time, the previous copy may still be loaded
+		uint32_t shadow_index = g_LdrHotReload.ShadowCounter.fetch_add(1);
+
+		fs::path shadow_image_path = g_LdrHotReload.ShadowFolder / ImagePath.stem();
+		shadow_image_path += L"." + std::to_wstring(shadow_index);
+		shadow_image_path += ImagePath.extension();
+
+		std::error_code ec;
+		fs::copy_file(ImagePath, shadow_image_path, fs::copy_options::overwrite_existing, ec);
+		if (ec)
+			return AURIE_ACCESS_DENIED;
+
+		ShadowImagePath = shadow_image_path;
+		return AURIE_SUCCESS;
+	}
+
+	void Internal::MdpDiscardShadowImage(
+		IN const MdpImageDescriptor& Descriptor
+	)
+	{
+		std::error_code ec;
+		if (!Descriptor.ShadowImagePath.empty())
+			fs::remove(Descriptor.ShadowImagePath, ec);
+	}
+
+	AurieStatus Internal::MdpReloadImage(
+		IN const fs::path& ImagePath
+	)
+	{
+		MmpTraceSpan trace_span("ReloadImage", ImagePath);
+
+		AurieStatus last_status = AURIE_SUCCESS;
+
+		// Only modules that are loaded get reloaded, images that are new in the folder are left alone
+		AurieModule* old_module = nullptr;
+		last_status = MdpLookupModuleByPath(
+			ImagePath,
+			old_module
+		);
+
+		if (!AurieSuccess(last_status))
+			return last_status;
 
-		uintptr_t module_callback_offset = PpFindFileExportByName(ImagePath, "ModuleOperationCallback");
-		uintptr_t module_preload_offset = PpFindFileExportByName(ImagePath, "ModulePreinitialize");
-		uintptr_t module_unload_offset = PpFindFileExportByName(ImagePath, "ModuleUnload");
+		if (old_module == g_ArInitialImage)
+			return AURIE_ACCESS_DENIED;
 
-		// Cast the problems away
-		char* image_base = reinterpret_cast<char*>(ImageBaseAddress);
+		// Don't give up a working module for an image that can't be loaded.
+		// The copy is made first, the original may be written to again while we check it.
+		MdpImageDescriptor image_descriptor = {};
+		last_status = MdpPreflightImage(
+			ImagePath,
+			true,
+			image_descriptor
+		);
 
-		AurieEntry module_init = reinterpret_cast<AurieEntry>(image_base + module_init_offset);
-		AurieEntry module_preload = reinterpret_cast<AurieEntry>(image_base + module_preload_offset);
-		AurieEntry module_unload = reinterpret_cast<AurieEntry>(image_base + module_unload_offset);
-		AurieLoaderEntry framework_init = reinterpret_cast<AurieLoaderEntry>(image_base + framework_init_offset);
-		AurieModuleCallback module_callback = reinterpret_cast<AurieModuleCallback>(image_base + module_callback_offset);
+		if (!AurieSuccess(last_status))
+			return last_status;
 
-		// If the offsets are zero, the function wasn't found, which means we shouldn't populate the field.
-		if (module_init_offset)
-			ModuleImage->ModuleInitialize = module_init;
+		// Its ModuleUnload gets the last chance to write into the reload state
+		MdpUnmapImage(
+			old_module,
+			true,
+			true
+		);
 
-		if (module_preload_offset)
-			ModuleImage->ModulePreinitialize = module_preload;
+		AurieModule* new_module = nullptr;
+		last_status = MdpLoadPreflightedImage(
+			image_descriptor,
+			true,
+			new_module
+		);
 
-		if (framework_init_offset)
-			ModuleImage->FrameworkInitialize = framework_init;
+		if (!AurieSuccess(last_status))
+			return last_status;
 
-		if (module_callback_offset)
-			ModuleImage->ModuleOperationCallback = module_callback;
+		if (!new_module->ModuleReload)
+			return AURIE_SUCCESS;
 
-		if (module_unload_offset)
-			ModuleImage->ModuleUnload = module_unload;
+		PVOID reload_state = nullptr;
+		size_t reload_state_size = 0;
 
-		// We always need __AurieFrameworkInit to exist.
-		// We also need either a ModuleInitialize or a ModulePreinitialize function.
-		return ((module_init_offset || module_preload_offset) && framework_init_offset) ? AURIE_SUCCESS : AURIE_FILE_PART_NOT_FOUND;
+		{
+			AurieSharedLock state_lock(g_LdrHotReload.StateLock);
+
+			auto iterator = g_LdrHotReload.States.find(new_module->CanonicalImagePath);
+			if (iterator != g_LdrHotReload.States.end())
+			{
+				reload_state = iterator->second.data();
+				reload_state_size = iterator->second.size();
+			}
+		}
+
+		return new_module->ModuleReload(
+			new_module,
+			new_module->ImagePath,
+			reload_state,
+			reload_state_size
+		);
 	}
 
-	// The ignoring of return values here is on purpose, we just have to power through
-	// and unload / free what we can.
-	AurieStatus Internal::MdpUnmapImage(
-		IN AurieModule* Module,
-		IN bool RemoveFromList,
-		IN bool CallUnloadRoutine
+	DWORD WINAPI Internal::MdpHotReloadWatcher(
+		IN PVOID
 	)
 	{
-		AurieStatus last_status = AURIE_SUCCESS;
+		HANDLE stop_event = g_LdrHotReload.StopEvent;
+		fs::path watched_folder = g_LdrHotReload.WatchedFolder;
+
+		HANDLE directory_handle = CreateFileW(
+			watched_folder.wstring().c_str(),
+			FILE_LIST_DIRECTORY,
+			FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+			nullptr,
+			OPEN_EXISTING,
+			FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+			nullptr
+		);
 
-		// We don't have to do anything else, since SafetyHook will handle everything for us.
-		// Truly a GOATed library, thank you @localcc for telling me about it love ya
-		Module->InlineHooks.clear();
-		Module->MidHooks.clear();
+		HANDLE change_event = CreateEventW(nullptr, FALSE, FALSE, nullptr);
 
-		// Call the unload entry if needed
-		if (CallUnloadRoutine)
+		// ReadDirectoryChangesW wants a DWORD aligned buffer
+		DWORD change_buffer[4096] = {};
+		OVERLAPPED overlapped = {};
+		overlapped.hEvent = change_event;
+
+		auto watch_folder = [&]() -> bool
 		{
-			last_status = MdpDispatchEntry(
-				Module,
-				Module->ModuleUnload
+			return ReadDirectoryChangesW(
+				directory_handle,
+				change_buffer,
+				sizeof(change_buffer),
+				TRUE,
+				FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE,
+				nullptr,
+				&overlapped,
+				nullptr
 			);
-		}
+		};
 
-		// Remove the module's operation callback
-		Module->ModuleOperationCallback = nullptr;
+		bool is_watching = directory_handle != INVALID_HANDLE_VALUE && change_event && watch_folder();
 
-		// Destory all interfaces created by the module
-		for (auto& module_interface : Module->InterfaceTable)
+		// Images that changed, and when they're due for a reload if they don't change again
+		std::unordered_map<std::wstring, ULONGLONG> pending_images;
+
+		while (is_watching)
 		{
-			if (module_interface.Interface)
-				module_interface.Interface->Destroy();
-		}
+			ULONGLONG current_time = GetTickCount64();
 
-		// Wipe them off the interface table
-		// Note these can't be freed, they're allocated by the owner module
-		Module->InterfaceTable.clear();
+			// Nothing to do but wait for changes if nothing's pending
+			DWORD timeout = INFINITE;
+			for (const auto& [image_path, deadline] : pending_images)
+				timeout = std::min<DWORD>(timeout, deadline > current_time ? static_cast<DWORD>(deadline - current_time) : 0);
 
-		// Free all memory allocated by the module (except persistent memory)
-		for (auto& memory_allocation : Module->MemoryAllocations)
-		{
-			MmpFreeMemory(
-				memory_allocation.OwnerModule,
-				memory_allocation.AllocationBase,
-				false
-			);
-		}
+			HANDLE wait_handles[] = { stop_event, change_event };
+			DWORD wait_status = WaitForMultipleObjects(2, wait_handles, FALSE, timeout);
+
+			if (wait_status == WAIT_OBJECT_0 + 1)
+			{
+				// Zero bytes means the buffer overflowed. Whatever was missed gets written again
+				// when it's done building, so there's no need to go looking for it.
+				DWORD bytes_transferred = 0;
+				if (GetOverlappedResult(directory_handle, &overlapped, &bytes_transferred, FALSE) && bytes_transferred)
+				{
+					MdpQueueChangedImages(
+						change_buffer,
+						GetTickCount64() + MDP_HOT_RELOAD_DEBOUNCE_MS,
+						pending_images
+					);
+				}
+
+				is_watching = watch_folder();
+				continue;
+			}
 
-		// Remove all the allocation entries, they're now invalid
-		Module->MemoryAllocations.clear();
+			if (wait_status != WAIT_TIMEOUT)
+				break;
 
-		// Free the module
-		FreeLibrary(Module->ImageBase.Module);
+			// Every image whose deadline passed is done being written
+			std::vector<std::wstring> due_images;
+			current_time = GetTickCount64();
 
-		// Remove the module from our list if needed
-		if (RemoveFromList)
-			g_LdrModuleList.remove(*Module);
+			std::erase_if(
+				pending_images,
+				[current_time, &due_images](const auto& Entry) -> bool
+				{
+					if (Entry.second > current_time)
+						return false;
 
-		return last_status;
-	}
+					due_images.push_back(Entry.first);
+					return true;
+				}
+			);
 
-	AurieStatus Internal::MdpDispatchEntry(
-		IN AurieModule* Module,
-		IN AurieEntry Entry
-	)
-	{
-		// Ignore dispatch attempts for the initial module
-		if (Module == g_ArInitialImage)
-			return AURIE_SUCCESS;
+			// The service thread does the actual reloading, so modules are only ever swapped out from there
+			for (const auto& image_path : due_images)
+			{
+				ObpPostServiceTask(
+					g_ArInitialImage,
+					[image_path]()
+					{
+						AurieStatus last_status = MdpReloadImage(image_path);
+
+						std::wstring message = L"[Aurie] Reloading " + fs::path(image_path).filename().wstring();
+						message += AurieSuccess(last_status) ? L" succeeded\n" : L" failed with status " + std::to_wstring(last_status) + L"\n";
+						OutputDebugStringW(message.c_str());
+					}
+				);
+			}
+		}
 
-		ObpDispatchModuleOperationCallbacks(
-			Module, 
-			Entry, 
-			true
-		);
+		// The pending read has to be done with the buffer before it goes away
+		if (directory_handle != INVALID_HANDLE_VALUE)
+		{
+			DWORD bytes_transferred = 0;
+			if (CancelIoEx(directory_handle, &overlapped))
+				GetOverlappedResult(directory_handle, &overlapped, &bytes_transferred, TRUE);
 
-		AurieStatus module_status = Module->FrameworkInitialize(
-			g_ArInitialImage,
-			PpGetFrameworkRoutine,
-			Entry,
-			MdpGetImagePath(Module),
-			Module
-		);
+			CloseHandle(directory_handle);
+		}
 
-		ObpDispatchModuleOperationCallbacks(
-			Module, 
-			Entry, 
-			false
-		);
+		if (change_event)
+			CloseHandle(change_event);
 
-		return module_status;
+		return 0;
 	}
 
-	void Internal::MdpMapFolder(
-		IN const fs::path& Folder, 
-		IN bool Recursive,
-		IN bool IsRuntimeLoad,
-		OPTIONAL OUT size_t* NumberOfMappedModules
+	void Internal::MdpQueueChangedImages(
+		IN const void* ChangeBuffer,
+		IN ULONGLONG Deadline,
+		IN OUT std::unordered_map<std::wstring, ULONGLONG>& PendingImages
 	)
 	{
-		std::vector<fs::path> modules_to_map;
-
-		MdpBuildModuleList(
-			Folder,
-			Recursive,
-			[](const fs::directory_entry& entry) -> bool
-			{
-				if (!entry.is_regular_file())
-					return false;
-
-				if (!entry.path().has_filename())
-					return false;
+		const char* current_entry = static_cast<const char*>(ChangeBuffer);
 
-				if (!entry.path().filename().has_extension())
-					return false;
+		while (true)
+		{
+			const FILE_NOTIFY_INFORMATION* change = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(current_entry);
 
-				if (entry.path().filename().extension().compare(L".dll"))
-					return false;
+			// Removals and the old names of renamed files can't be reloaded
+			bool is_new_content = change->Action == FILE_ACTION_ADDED ||
+				change->Action == FILE_ACTION_MODIFIED ||
+				change->Action == FILE_ACTION_RENAMED_NEW_NAME;
 
-				return true;
-			},
-			modules_to_map
-		);
+			// Names are relative to the watched folder, and not null-terminated
+			fs::path image_path = g_LdrHotReload.WatchedFolder / std::wstring_view(change->FileName, change->FileNameLength / sizeof(wchar_t));
 
-		std::sort(
-			modules_to_map.begin(),
-			modules_to_map.end()
-		);
+			// Same filter as MdpMapFolder, every further change pushes the deadline back
+			if (is_new_content && !image_path.extension().compare(L".dll"))
+				PendingImages[image_path.lexically_normal().wstring()] = Deadline;
 
-		size_t loaded_count = 0;
-		for (auto& module : modules_to_map)
-		{
-			AurieModule* loaded_module = nullptr;
+			if (!change->NextEntryOffset)
+				break;
 
-			if (AurieSuccess(MdMapImageEx(module, IsRuntimeLoad, loaded_module)))
-				loaded_count++;
+			current_entry += change->NextEntryOffset;
 		}
-
-		if (NumberOfMappedModules)
-			*NumberOfMappedModules = loaded_count;
 	}
 
 	AurieStatus MdMapImage(
@@ -497,25 +2044,74 @@ namespace Aurie
 		OUT AurieModule*& Module
 	)
 	{
+		Internal::MdpImageDescriptor image_descriptor = {};
+		Internal::MdpPreflightImage(
+			ImagePath,
+			true,
+			image_descriptor
+		);
+
+		return Internal::MdpLoadPreflightedImage(
+			image_descriptor,
+			IsRuntimeLoad,
+			Module
+		);
+	}
+
+	AurieStatus Internal::MdpLoadPreflightedImage(
+		IN const MdpImageDescriptor& Descriptor,
+		IN bool IsRuntimeLoad,
+		OUT AurieModule*& Module
+	)
+	{
+		MmpTraceSpan trace_span("LoadImage", Descriptor.ImagePath);
+
 		AurieStatus last_status = AURIE_SUCCESS;
 		HMODULE image_base = nullptr;
+		fs::path shadow_image_path;
 
 		// Map the image
-		last_status = Internal::MdpMapImage(ImagePath, image_base);
+		last_status = MdpMapPreflightedImage(Descriptor, image_base, &shadow_image_path);
 
 		if (!AurieSuccess(last_status))
 			return last_status;
 
-		// Create the module object
+		// Create the module object, the exports were already found in preflight
 		AurieModule module_object = {};
-		last_status = Internal::MdpCreateModule(
-			ImagePath,
+		last_status = MdpCreateModule(
+			Descriptor.ImagePath,
 			image_base,
-			true,
+			false,
 			0,
 			module_object
 		);
 
+		if (AurieSuccess(last_status))
+		{
+			last_status = MdpApplyImageExports(
+				Descriptor,
+				image_base,
+				&module_object
+			);
+		}
+
+		module_object.InitializationWave = Descriptor.InitializationWave;
+		module_object.Flags.AllowsParallelInitialize = Descriptor.ParallelInitialize;
+
+		// Without the event, the module is simply initialized on the loader thread
+		if (Descriptor.AsyncInitialize)
+		{
+			auto async_initialization = std::make_shared<AurieAsyncInitialization>();
+			async_initialization->CompletionEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+
+			if (async_initialization->CompletionEvent)
+			{
+				module_object.Flags.AllowsAsyncInitialize = true;
+				module_object.AsyncInitialization = std::move(async_initialization);
+			}
+		}
+		module_object.ShadowImagePath = shadow_image_path;
+
 		// Verify image integrity
 		last_status = Internal::MmpVerifyCallback(module_object.ImageBase.Module, module_object.FrameworkInitialize);
 		if (!AurieSuccess(last_status))
@@ -597,7 +2193,15 @@ namespace Aurie
 		IN AurieModule* Module
 	)
 	{
-		return Module->Flags.IsInitialized;
+		if (Module->Flags.IsInitialized)
+			return true;
+
+		// Asynchronous initializations complete before the service thread gets to set the flag
+		const AurieAsyncInitialization* async_initialization = Module->AsyncInitialization.get();
+		if (!async_initialization || !async_initialization->IsComplete)
+			return false;
+
+		return AurieSuccess(async_initialization->Status);
 	}
 
 	AurieStatus MdMapFolder(
@@ -649,4 +2253,171 @@ namespace Aurie
 
 		return Internal::MdpUnmapImage(Module, true, true);
 	}
+
+	AurieStatus MdScheduleUnmapImage(
+		IN AurieModule* Module
+	)
+	{
+		if (Module == g_ArInitialImage)
+			return AURIE_ACCESS_DENIED;
+
+		// Something else may unload the module first, the handle won't resolve then
+		AurieModuleHandle module_handle = {};
+		AurieStatus last_status = MdAcquireModuleHandle(
+			Module,
+			module_handle
+		);
+
+		if (!AurieSuccess(last_status))
+			return last_status;
+
+		return Internal::ObpPostServiceTask(
+			g_ArInitialImage,
+			[module_handle]()
+			{
+				AurieModule* module = nullptr;
+				if (AurieSuccess(MdResolveModuleHandle(module_handle, module)))
+					Internal::MdpUnmapImage(module, true, true);
+			}
+		);
+	}
+
+	AurieStatus MdGetReloadState(
+		IN AurieModule* Module,
+		IN size_t Size,
+		OUT PVOID& State
+	)
+	{
+		if (!Module || !Size)
+			return AURIE_INVALID_PARAMETER;
+
+		AurieExclusiveLock state_lock(Internal::g_LdrHotReload.StateLock);
+
+		// Zero-fills whatever's new, and keeps what's already there
+		std::vector<uint8_t>& reload_state = Internal::g_LdrHotReload.States[Module->CanonicalImagePath];
+		reload_state.resize(Size);
+
+		State = reload_state.data();
+		return AURIE_SUCCESS;
+	}
+
+	AurieStatus MdAcquireModuleHandle(
+		IN AurieModule* Module,
+		OUT AurieModuleHandle& Handle
+	)
+	{
+		AurieRcuReadGuard rcu_guard;
+
+		const Internal::MdpModuleSnapshot* module_snapshot = Internal::g_LdrModuleSnapshot.Load();
+		if (!module_snapshot)
+			return AURIE_INVALID_PARAMETER;
+
+		size_t position = 0;
+		if (!Internal::MdpLocateModule(*module_snapshot, Module, position))
+			return AURIE_INVALID_PARAMETER;
+
+		Handle.Index = Module->RegistrySlot;
+		Handle.Generation = module_snapshot->SlotGenerations[Module->RegistrySlot];
+
+		return AURIE_SUCCESS;
+	}
+
+	AurieStatus MdResolveModuleHandle(
+		IN AurieModuleHandle Handle,
+		OUT AurieModule*& Module
+	)
+	{
+		AurieRcuReadGuard rcu_guard;
+
+		const Internal::MdpModuleSnapshot* module_snapshot = Internal::g_LdrModuleSnapshot.Load();
+		if (!module_snapshot || Handle.Index >= module_snapshot->SlotPositions.size())
+			return AURIE_INVALID_PARAMETER;
+
+		uint32_t position = module_snapshot->SlotPositions[Handle.Index];
+		if (module_snapshot->SlotGenerations[Handle.Index] != Handle.Generation || position == Internal::MDP_INVALID_POSITION)
+			return AURIE_OBJECT_NOT_FOUND;
+
+		Module = module_snapshot->Modules[position];
+		return AURIE_SUCCESS;
+	}
+
+	void Internal::MdpDeferImage(
+		IN const MdpImageDescriptor& Descriptor
+	)
+	{
+		auto lazy_image = std::make_shared<MdpLazyImage>();
+		lazy_image->ImagePath = Descriptor.ImagePath;
+
+		AurieExclusiveLock lazy_image_lock(g_LdrLazyImageLock);
+
+		// The first image providing a name keeps it, same as in MdpOrderImages
+		for (const auto& interface_name : Descriptor.ProvidedInterfaces)
+		{
+			std::string folded_name;
+			ObpFoldInterfaceName(interface_name.c_str(), folded_name);
+
+			g_LdrLazyImages.emplace(std::move(folded_name), lazy_image);
+		}
+	}
+
+	AurieStatus Internal::MdpLoadLazyImage(
+		IN const char* InterfaceName
+	)
+	{
+		std::string folded_name;
+		ObpFoldInterfaceName(InterfaceName, folded_name);
+
+		std::shared_ptr<MdpLazyImage> lazy_image;
+
+		{
+			AurieExclusiveLock lazy_image_lock(g_LdrLazyImageLock);
+
+			auto iterator = g_LdrLazyImages.find(folded_name);
+			if (iterator == g_LdrLazyImages.end())
+				return AURIE_OBJECT_NOT_FOUND;
+
+			lazy_image = iterator->second;
+
+			if (lazy_image->LoaderThreadId)
+			{
+				// The module is asking for its own interface before creating it, waiting would never end
+				if (lazy_image->LoaderThreadId == GetCurrentThreadId())
+					return AURIE_OBJECT_NOT_FOUND;
+
+				while (lazy_image->LoaderThreadId)
+					SleepConditionVariableSRW(&g_LdrLazyImageLoaded, &g_LdrLazyImageLock, INFINITE, 0);
+
+				return lazy_image->LoadStatus;
+			}
+
+			lazy_image->LoaderThreadId = GetCurrentThreadId();
+		}
+
+		MmpTraceSpan trace_span("LoadLazyImage", std::string_view(InterfaceName));
+
+		// Preflight happens again, the file may have changed since the folder was mapped
+		AurieModule* loaded_module = nullptr;
+		AurieStatus last_status = MdMapImage(
+			lazy_image->ImagePath,
+			loaded_module
+		);
+
+		{
+			AurieExclusiveLock lazy_image_lock(g_LdrLazyImageLock);
+
+			lazy_image->LoadStatus = last_status;
+			lazy_image->LoaderThreadId = 0;
+
+			std::erase_if(
+				g_LdrLazyImages,
+				[&lazy_image](const auto& Entry)
+				{
+					return Entry.second == lazy_image;
+				}
+			);
+		}
+
+		WakeAllConditionVariable(&g_LdrLazyImageLoaded);
+		return last_status;
+	}
 }
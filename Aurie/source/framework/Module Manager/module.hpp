@@ -2,6 +2,11 @@
 #define AURIE_MODULE_H_
 
 #include "../framework.hpp"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 #include <functional>
 
@@ -47,6 +52,31 @@ namespace Aurie
 		IN AurieModule* Module
 	);
 
+	// Unmaps the module from the service thread, so a module can unload itself from its own code
+	EXPORTED AurieStatus MdScheduleUnmapImage(
+		IN AurieModule* Module
+	);
+
+	// Gets memory that survives hot reloads of the module, and is handed to the new image's ModuleReload.
+	// It's allocated zeroed on the first call, a different Size resizes it and invalidates earlier pointers.
+	EXPORTED AurieStatus MdGetReloadState(
+		IN AurieModule* Module,
+		IN size_t Size,
+		OUT PVOID& State
+	);
+
+	// Gets a handle that stays safe to resolve after the module is unloaded
+	EXPORTED AurieStatus MdAcquireModuleHandle(
+		IN AurieModule* Module,
+		OUT AurieModuleHandle& Handle
+	);
+
+	// Fails with AURIE_OBJECT_NOT_FOUND once the module is unloaded
+	EXPORTED AurieStatus MdResolveModuleHandle(
+		IN AurieModuleHandle Handle,
+		OUT AurieModule*& Module
+	);
+
 	namespace Internal
 	{
 		// Creates an AurieModule object - for internal use only
@@ -69,12 +99,290 @@ namespace Aurie
 
 		void MdpPurgeMarkedModules();
 
+		// Everything that's known about an image from its file alone, before it's mapped
+		struct MdpImageDescriptor
+		{
+			fs::path ImagePath;
+
+			// Why the image can't be loaded, if it can't
+			AurieStatus PreflightStatus = AURIE_SUCCESS;
+
+			// Export offsets from the image base, zero if the export doesn't exist
+			uintptr_t FrameworkInitializeOffset = 0;
+			uintptr_t ModuleInitializeOffset = 0;
+			uintptr_t ModulePreinitializeOffset = 0;
+			uintptr_t ModuleUnloadOffset = 0;
+			uintptr_t ModuleCallbackOffset = 0;
+			uintptr_t ModuleReloadOffset = 0;
+
+			// From the image's AurieModuleManifest export, if it has one
+			std::vector<std::string> RequiredInterfaces;
+			std::vector<std::string> ProvidedInterfaces;
+			bool ParallelInitialize = false;
+			bool AsyncInitialize = false;
+			bool LazyLoad = false;
+
+			// Assigned by MdpOrderImages
+			uint32_t InitializationWave = 0;
+
+			// In hot reload mode, the copy that was preflighted and is the one to load
+			fs::path ShadowImagePath;
+		};
+
+		// Identifies one version of an image file in the manifest cache
+		struct MdpImageFingerprint
+		{
+			std::wstring ImagePath;
+			uint64_t FileSize = 0;
+			int64_t LastWriteTime = 0;
+
+			// Hash of the first MDP_MANIFEST_CACHE_HEADER_BYTES of the file
+			uint64_t HeaderHash = 0;
+		};
+
+		struct MdpManifestCacheEntry
+		{
+			MdpImageFingerprint Fingerprint;
+			MdpImageDescriptor Descriptor;
+		};
+
+		// Preflight results of previous launches, by image path
+		struct MdpManifestCache
+		{
+			SRWLOCK Lock = SRWLOCK_INIT;
+			fs::path CachePath;
+			std::unordered_map<std::wstring, MdpManifestCacheEntry> Entries;
+
+			// Set if Entries differ from what's on disk
+			bool IsDirty = false;
+		};
+
+		inline MdpManifestCache g_LdrManifestCache;
+
+		// The cache file is a header, an array of fixed-size entries and a table of the strings they point into.
+		// Nothing in it is a pointer, so the file can be read in place.
+		constexpr uint32_t MDP_MANIFEST_CACHE_MAGIC = 0x43464D41; // 'AMFC'
+		constexpr uint32_t MDP_MANIFEST_CACHE_VERSION = 4;
+		constexpr uint32_t MDP_MANIFEST_CACHE_FRAMEWORK_VERSION = (AURIE_FWK_MAJOR << 16) | (AURIE_FWK_MINOR << 8) | AURIE_FWK_PATCH;
+		constexpr size_t MDP_MANIFEST_CACHE_HEADER_BYTES = 0x1000;
+
+		struct MdpManifestCacheFileHeader
+		{
+			uint32_t Magic;
+			uint32_t Version;
+			uint32_t FrameworkVersion;
+			uint32_t EntryCount;
+			uint32_t StringTableSize;
+			uint32_t Reserved;
+
+			// Hash of the entries and the string table
+			uint64_t Checksum;
+		};
+
+		struct MdpManifestCacheFileEntry
+		{
+			uint64_t FileSize;
+			int64_t LastWriteTime;
+			uint64_t HeaderHash;
+
+			uint64_t FrameworkInitializeOffset;
+			uint64_t ModuleInitializeOffset;
+			uint64_t ModulePreinitializeOffset;
+			uint64_t ModuleUnloadOffset;
+			uint64_t ModuleCallbackOffset;
+			uint64_t ModuleReloadOffset;
+			uint32_t PreflightStatus;
+
+			// Offsets into the string table, the path is in wchar_t units
+			uint32_t PathOffset;
+			uint32_t PathLength;
+
+			// Same format as the AurieModuleManifest export
+			uint32_t ManifestOffset;
+			uint32_t ManifestLength;
+			uint32_t Reserved;
+		};
+
+		// Shared by the workers of MdpPreflightImages
+		struct MdpPreflightBatch
+		{
+			const std::vector<fs::path>& ImagePaths;
+			std::vector<MdpImageDescriptor>& Descriptors;
+			std::atomic<size_t> NextImage = 0;
+		};
+
 		// Internal routine responsible for ensuring module compatibility
 		AurieStatus MdpMapImage(
 			IN const fs::path& ImagePath,
 			OUT HMODULE& ImageBase
 		);
 
+		// Reads the image from disk once, checks its architecture and looks up its exports.
+		// Touches no framework state, so any number of these can run at once.
+		// With UseShadowImage in hot reload mode, the image is copied first and the copy is what gets read,
+		// so whatever is loaded later is exactly what passed preflight.
+		AurieStatus MdpPreflightImage(
+			IN const fs::path& ImagePath,
+			IN bool UseShadowImage,
+			OUT MdpImageDescriptor& Descriptor
+		);
+
+		// Does the actual work of MdpPreflightImage when the manifest cache doesn't know the image
+		AurieStatus MdpInspectImage(
+			IN const fs::path& ImagePath,
+			IN OUT MdpImageDescriptor& Descriptor
+		);
+
+		uint64_t MdpHashBytes(
+			IN const void* Data,
+			IN size_t Size,
+			IN uint64_t Hash = 0xCBF29CE484222325
+		);
+
+		AurieStatus MdpQueryImageFingerprint(
+			IN const fs::path& ImagePath,
+			OUT MdpImageFingerprint& Fingerprint
+		);
+
+		// Fills in Descriptor if the cache has an entry for this exact version of the image
+		bool MdpLookupManifestCache(
+			IN const MdpImageFingerprint& Fingerprint,
+			OUT MdpImageDescriptor& Descriptor
+		);
+
+		void MdpStoreManifestCache(
+			IN const MdpImageFingerprint& Fingerprint,
+			IN const MdpImageDescriptor& Descriptor
+		);
+
+		// Reads the cache file, a missing or damaged file just leaves the cache empty
+		void MdpLoadManifestCache(
+			IN const fs::path& CachePath
+		);
+
+		// Rewrites the cache file if anything changed since it was loaded
+		AurieStatus MdpSaveManifestCache();
+
+		// Reads the entries of the AurieModuleManifest export from an image read by MdpPreflightImage
+		AurieStatus MdpParseImageManifest(
+			IN void* Image,
+			IN size_t ImageSize,
+			IN OUT MdpImageDescriptor& Descriptor
+		);
+
+		// Parses manifest entries, either from an image or from the manifest cache
+		AurieStatus MdpParseManifestEntries(
+			IN std::string_view ManifestData,
+			IN OUT MdpImageDescriptor& Descriptor
+		);
+
+		// Sorts preflighted images so that every module comes after the modules providing the interfaces it requires,
+		// and groups them into waves of modules that don't depend on each other.
+		// Modules that are part of a dependency cycle fail with AURIE_MODULE_DEPENDENCY_NOT_RESOLVED.
+		void MdpOrderImages(
+			IN OUT std::vector<MdpImageDescriptor>& Descriptors
+		);
+
+		// Calls Dispatch on every module in the registry, one initialization wave at a time.
+		// Modules that allow it are dispatched concurrently with the rest of their wave.
+		// Operation events of entries that ran on the thread pool are delivered from the calling thread once their wave is done.
+		void MdpDispatchInWaves(
+			IN const std::function<void(AurieModule* Module)>& Dispatch
+		);
+
+		// An operation event raised on a wave worker, kept until the loader thread can deliver it
+		struct MdpDeferredOperation
+		{
+			AurieModule* Module;
+			AurieEntry Entry;
+			bool IsFutureCall;
+		};
+
+		// Shared by the workers of MdpDispatchInWaves
+		struct MdpDispatchBatch
+		{
+			const std::vector<AurieModule*>& Modules;
+			const std::function<void(AurieModule* Module)>& Dispatch;
+			std::atomic<size_t> NextModule = 0;
+
+			// Subscribers only ever hear about module operations from the loader thread
+			SRWLOCK OperationLock = SRWLOCK_INIT;
+			std::vector<MdpDeferredOperation> DeferredOperations;
+		};
+
+		// Set while a thread pool thread works on a wave, see MdpDispatchOperationEvent
+		inline thread_local MdpDispatchBatch* g_LdrWorkerBatch = nullptr;
+
+		// Set while a thread pool thread runs an asynchronous ModuleInitialize, see MdpDispatchOperationEvent
+		inline thread_local bool g_LdrIsAsyncWorker = false;
+
+		// Raises the operation events for Module's Entry.
+		// On a wave worker, they're queued on the batch for the loader thread instead,
+		// and asynchronous initializations post them to the service thread.
+		void MdpDispatchOperationEvent(
+			IN AurieModule* Module,
+			IN AurieEntry Entry,
+			IN bool IsFutureCall
+		);
+
+		void CALLBACK MdpDispatchWorker(
+			IN OPTIONAL PTP_CALLBACK_INSTANCE Instance,
+			IN PVOID Context,
+			IN OPTIONAL PTP_WORK Work
+		);
+
+		// Submits the module's ModuleInitialize to the system thread pool.
+		// Returns false if it couldn't, in which case it has to be called on the current thread.
+		bool MdpBeginAsyncInitialization(
+			IN AurieModule* Module
+		);
+
+		void CALLBACK MdpAsyncInitializationWorker(
+			IN OPTIONAL PTP_CALLBACK_INSTANCE Instance,
+			IN PVOID Context
+		);
+
+		// How long unloading a module waits for its asynchronous ModuleInitialize to return.
+		// The initialization might itself be waiting on the thread that's unloading it.
+		constexpr DWORD MDP_ASYNC_UNLOAD_TIMEOUT_MS = 5000;
+
+		// Whether the module's ModuleInitialize is still running on the thread pool, doesn't block
+		bool MdpIsAsyncInitializationPending(
+			IN AurieModule* Module
+		);
+
+		// Blocks until every asynchronous initialization of a wave before Wave has returned
+		void MdpWaitForAsyncInitializations(
+			IN uint32_t Wave
+		);
+
+		// Preflights every image on the system thread pool, Descriptors line up with ImagePaths
+		void MdpPreflightImages(
+			IN const std::vector<fs::path>& ImagePaths,
+			OUT std::vector<MdpImageDescriptor>& Descriptors
+		);
+
+		void CALLBACK MdpPreflightWorker(
+			IN OPTIONAL PTP_CALLBACK_INSTANCE Instance,
+			IN PVOID Context,
+			IN OPTIONAL PTP_WORK Work
+		);
+
+		// Loads an image that passed preflight, unless it's already loaded.
+		// In hot reload mode the image is loaded from the copy preflight made, so the original can be rebuilt while it's loaded.
+		AurieStatus MdpMapPreflightedImage(
+			IN const MdpImageDescriptor& Descriptor,
+			OUT HMODULE& ImageBase,
+			OPTIONAL OUT fs::path* ShadowImagePath
+		);
+
+		// MdMapImageEx, minus the parts already done in preflight
+		AurieStatus MdpLoadPreflightedImage(
+			IN const MdpImageDescriptor& Descriptor,
+			IN bool IsRuntimeLoad,
+			OUT AurieModule*& Module
+		);
+
 		void MdpBuildModuleList(
 			IN const fs::path& BaseFolder,
 			IN bool Recursive,
@@ -104,11 +412,17 @@ namespace Aurie
 			OUT fs::path& Path
 		);
 
+		// Both wrap around at the ends of the module list
 		EXPORTED AurieStatus MdpGetNextModule(
 			IN AurieModule* Module,
 			OUT AurieModule*& NextModule
 		);
 
+		EXPORTED AurieStatus MdpGetPreviousModule(
+			IN AurieModule* Module,
+			OUT AurieModule*& PreviousModule
+		);
+
 		EXPORTED PVOID MdpGetModuleBaseAddress(
 			IN AurieModule* Module
 		);
@@ -124,6 +438,13 @@ namespace Aurie
 			OUT AurieModule* ModuleImage
 		);
 
+		// Fills in the module's entries from the export offsets found in preflight
+		AurieStatus MdpApplyImageExports(
+			IN const MdpImageDescriptor& Descriptor,
+			IN HMODULE ImageBaseAddress,
+			OUT AurieModule* ModuleImage
+		);
+
 		AurieStatus MdpUnmapImage(
 			IN AurieModule* Module,
 			IN bool RemoveFromList,
@@ -142,7 +463,176 @@ namespace Aurie
 			OPTIONAL OUT size_t* NumberOfMappedModules
 		);
 
-		inline std::list<AurieModule> g_LdrModuleList;
+		// Rebuilds the snapshot of g_LdrModuleRegistry, the caller must hold g_LdrModuleListLock exclusively
+		void MdpPublishModuleSnapshot();
+
+		// Takes a module out of g_LdrModuleRegistry, it's freed once no reader can still be using it.
+		// The caller must hold g_LdrModuleListLock exclusively.
+		void MdpRetireModule(
+			IN AurieModule* Module
+		);
+
+		// Modules are allocated one by one, since their address is what everyone refers to them by.
+		// The generation changes every time the slot's module is removed.
+		struct MdpModuleSlot
+		{
+			std::unique_ptr<AurieModule> Module;
+			uint32_t Generation = 0;
+		};
+
+		struct MdpModuleRegistry
+		{
+			std::vector<MdpModuleSlot> Slots;
+			std::vector<uint32_t> FreeSlots;
+
+			// Every module in load order, this is what gets iterated
+			std::vector<AurieModule*> Modules;
+		};
+
+		// Owns the modules, only touched by the loader under g_LdrModuleListLock
+		inline MdpModuleRegistry g_LdrModuleRegistry;
+		inline SRWLOCK g_LdrModuleListLock = SRWLOCK_INIT;
+
+		struct MdpFileIdentityHash
+		{
+			size_t operator()(const AurieFileIdentity& Identity) const
+			{
+				return static_cast<size_t>(Identity.FileIndex ^ (Identity.VolumeSerial * 0x9E3779B97F4A7C15));
+			}
+		};
+
+		// Marks a registry slot that has no module in the snapshot
+		constexpr uint32_t MDP_INVALID_POSITION = UINT32_MAX;
+
+		struct MdpModuleSnapshot
+		{
+			std::vector<AurieModule*> Modules;
+
+			// Both indexed by registry slot, so a module's position is known without searching for it
+			std::vector<uint32_t> SlotPositions;
+			std::vector<uint32_t> SlotGenerations;
+
+			// Both keyed by what was computed once when the module was created
+			std::unordered_map<std::wstring, AurieModule*> PathIndex;
+			std::unordered_map<AurieFileIdentity, AurieModule*, MdpFileIdentityHash> IdentityIndex;
+		};
+
+		// What everyone else walks, read without locking (see AurieRcuPointer)
+		inline AurieRcuPointer<MdpModuleSnapshot> g_LdrModuleSnapshot;
+
+		// Position of a module in the snapshot's module list, if the snapshot has it
+		bool MdpLocateModule(
+			IN const MdpModuleSnapshot& Snapshot,
+			IN AurieModule* Module,
+			OUT size_t& Position
+		);
+
+		// Absolute, normalized and lowercased, only string operations and no file system access
+		std::wstring MdpCanonicalizePath(
+			IN const fs::path& Path
+		);
+
+		// Opens the file once to get its volume serial number and file index
+		AurieStatus MdpQueryFileIdentity(
+			IN const fs::path& Path,
+			OUT AurieFileIdentity& Identity
+		);
+
+		// Set in the environment to turn hot reload mode on, it's meant for module development only
+		inline constexpr const wchar_t* MDP_HOT_RELOAD_VARIABLE = L"AURIE_HOT_RELOAD";
+
+		// How long an image has to stay untouched after a change before it's reloaded.
+		// Compilers and linkers write their output in several goes.
+		constexpr ULONGLONG MDP_HOT_RELOAD_DEBOUNCE_MS = 500;
+
+		struct MdpHotReload
+		{
+			bool IsEnabled = false;
+			fs::path WatchedFolder;
+
+			// Images are loaded from copies in here, per process
+			fs::path ShadowFolder;
+			std::atomic<uint32_t> ShadowCounter = 0;
+
+			HANDLE WatcherThread = nullptr;
+			HANDLE StopEvent = nullptr;
+
+			// Reload state of every module that asked for one, by canonical image path
+			SRWLOCK StateLock = SRWLOCK_INIT;
+			std::unordered_map<std::wstring, std::vector<uint8_t>> States;
+		};
+
+		inline MdpHotReload g_LdrHotReload;
+
+		// Has to be called before any module is loaded, so every module gets loaded from a shadow copy
+		AurieStatus MdpEnableHotReload(
+			IN const fs::path& Folder
+		);
+
+		// Starts watching the folder once the initial modules are loaded and initialized
+		AurieStatus MdpStartHotReloadWatcher();
+
+		// Waits for the watcher thread to exit, must not be called under the loader lock
+		void MdpStopHotReloadWatcher();
+
+		// Copies an image into the shadow folder under a name that wasn't used before
+		AurieStatus MdpCreateShadowImage(
+			IN const fs::path& ImagePath,
+			OUT fs::path& ShadowImagePath
+		);
+
+		// Deletes the copy made by preflight, for images that end up not being loaded from it
+		void MdpDiscardShadowImage(
+			IN const MdpImageDescriptor& Descriptor
+		);
+
+		// Swaps a loaded module for the current version of its image file, then calls its ModuleReload.
+		// The old module stays loaded if the new image doesn't pass preflight.
+		AurieStatus MdpReloadImage(
+			IN const fs::path& ImagePath
+		);
+
+		DWORD WINAPI MdpHotReloadWatcher(
+			IN PVOID Context
+		);
+
+		// Adds every image named in a ReadDirectoryChangesW buffer to PendingImages, due at Deadline
+		void MdpQueueChangedImages(
+			IN const void* ChangeBuffer,
+			IN ULONGLONG Deadline,
+			IN OUT std::unordered_map<std::wstring, ULONGLONG>& PendingImages
+		);
+
+		// An image MdpMapFolder skipped, it's mapped the first time one of its interfaces is asked for
+		struct MdpLazyImage
+		{
+			fs::path ImagePath;
+
+			// Set while a thread maps the image, other threads asking for it wait until it's cleared
+			DWORD LoaderThreadId = 0;
+
+			// What mapping it returned, once LoaderThreadId is cleared
+			AurieStatus LoadStatus = AURIE_SUCCESS;
+		};
+
+		// Guards the map below and the fields of every image in it
+		inline SRWLOCK g_LdrLazyImageLock = SRWLOCK_INIT;
+		inline CONDITION_VARIABLE g_LdrLazyImageLoaded = CONDITION_VARIABLE_INIT;
+
+		// Images by the case-folded names of the interfaces they provide.
+		// An image is taken out under every name as soon as it's been mapped, whether it worked or not.
+		inline std::unordered_map<std::string, std::shared_ptr<MdpLazyImage>> g_LdrLazyImages;
+
+		// Keeps an image out of the module list until one of its interfaces is asked for
+		void MdpDeferImage(
+			IN const MdpImageDescriptor& Descriptor
+		);
+
+		// Maps the image providing InterfaceName if it was deferred, or waits for whoever is mapping it.
+		// Fails with AURIE_OBJECT_NOT_FOUND if no deferred image provides it.
+		AurieStatus MdpLoadLazyImage(
+			IN const char* InterfaceName
+		);
 	}
 }
 
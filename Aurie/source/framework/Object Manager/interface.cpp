@@ -0,0 +1,412 @@
+#include "object.hpp"
+
+namespace Aurie
+{
+	AurieStatus ObCreateInterface(
+		IN AurieModule* Module, 
+		IN AurieInterfaceBase* Interface, 
+		IN const char* InterfaceName
+	)
+	{
+		// Cheap early out, ObpAddInterfaceToTable has the final say under the interface lock
+		if (ObInterfaceExists(InterfaceName))
+			return AURIE_OBJECT_ALREADY_EXISTS;
+
+		AurieInterfaceTableEntry table_entry = {};
+		table_entry.Interface = Interface;
+		table_entry.InterfaceName = InterfaceName;
+		table_entry.OwnerModule = Module;
+
+		// Make sure the interface knows it's being set up,
+		// and that it succeeds at doing so. We don't want an
+		// uninitialized, half-broken interface exposed!
+
+		AurieStatus last_status = Interface->Create();
+		if (!AurieSuccess(last_status))
+			return last_status;
+
+		last_status = Internal::ObpAddInterfaceToTable(
+			Module,
+			table_entry
+		);
+
+		// Someone else registered the name in the meantime
+		if (!AurieSuccess(last_status))
+			Interface->Destroy();
+
+		return last_status;
+	}
+
+	bool ObInterfaceExists(
+		IN const char* InterfaceName
+	)
+	{
+		AurieModule* containing_module = nullptr;
+		AurieInterfaceTableEntry* table_entry = nullptr;
+		
+		// If we find a module containing the interface, that means the interface exists!
+		// ObpLookupInterfaceOwner will return AURIE_INTERFACE_NOT_FOUND if it doesn't exist.
+		return AurieSuccess(
+			Internal::ObpLookupInterfaceOwner(
+				InterfaceName,
+				true,
+				containing_module,
+				table_entry
+			)
+		);
+	}
+
+	namespace Internal
+	{
+		AurieStatus ObpDestroyInterfaceByName(
+			IN const char* InterfaceName
+		)
+		{
+			AurieRcuReadGuard rcu_guard;
+
+			AurieModule* owner_module = nullptr;
+			AurieInterfaceTableEntry* table_entry = nullptr;
+			AurieStatus last_status = AURIE_SUCCESS;
+
+			last_status = ObpLookupInterfaceOwner(
+				InterfaceName,
+				true,
+				owner_module,
+				table_entry
+			);
+
+			if (!AurieSuccess(last_status))
+				return last_status;
+
+			return ObpDestroyInterface(
+				owner_module,
+				table_entry->Interface,
+				true,
+				true
+			);
+		}
+
+		AurieStatus ObpAddInterfaceToTable(
+			IN AurieModule* Module, 
+			IN AurieInterfaceTableEntry& Entry
+		)
+		{
+			std::string folded_name;
+			const uint64_t name_hash = ObpFoldInterfaceName(
+				Entry.InterfaceName,
+				folded_name
+			);
+
+			AurieExclusiveLock interface_lock(g_ObInterfaceLock);
+
+			// Writers are serialized by the lock, so the published tables can't change under us
+			const ObpInterfaceTables* current_tables = g_ObInterfaceTables.Load();
+			if (current_tables && current_tables->Index.contains(ObpInterfaceKey{ name_hash, folded_name }))
+				return AURIE_OBJECT_ALREADY_EXISTS;
+
+			AurieInterfaceTableEntry& table_entry = Module->InterfaceTable.emplace_back(Entry);
+			table_entry.NameHash = name_hash;
+			table_entry.FoldedName = std::move(folded_name);
+
+			ObpUpdateInterfaceTables(
+				[&table_entry](ObpInterfaceTables& Tables)
+				{
+					Tables.Index.emplace(
+						ObpInterfaceKey{ table_entry.NameHash, table_entry.FoldedName },
+						&table_entry
+					);
+
+					// Give it a handle slot, generations start at 1 so a zeroed handle never resolves
+					if (Tables.FreeSlots.empty())
+					{
+						table_entry.HandleIndex = static_cast<uint32_t>(Tables.Slots.size());
+						Tables.Slots.push_back({ &table_entry, 1 });
+					}
+					else
+					{
+						table_entry.HandleIndex = Tables.FreeSlots.back();
+						Tables.FreeSlots.pop_back();
+						Tables.Slots[table_entry.HandleIndex].Entry = &table_entry;
+					}
+				}
+			);
+
+			return AURIE_SUCCESS;
+		}
+
+		void ObpUpdateInterfaceTables(
+			IN const std::function<void(ObpInterfaceTables& Tables)>& Editor
+		)
+		{
+			const ObpInterfaceTables* current_tables = g_ObInterfaceTables.Load();
+
+			auto new_tables = current_tables ? std::make_unique<ObpInterfaceTables>(*current_tables) : std::make_unique<ObpInterfaceTables>();
+			Editor(*new_tables);
+
+			g_ObInterfaceTables.Publish(std::move(new_tables));
+		}
+
+		uint64_t ObpFoldInterfaceName(
+			IN const char* InterfaceName,
+			OUT std::string& FoldedName
+		)
+		{
+			// FNV-1a over the lowercased name, which is what _stricmp compares
+			uint64_t hash = 0xCBF29CE484222325;
+
+			FoldedName.clear();
+			for (const char* character = InterfaceName; *character; character++)
+			{
+				const char folded_character = static_cast<char>(tolower(static_cast<unsigned char>(*character)));
+
+				FoldedName.push_back(folded_character);
+				hash = (hash ^ static_cast<unsigned char>(folded_character)) * 0x100000001B3;
+			}
+
+			return hash;
+		}
+
+		void ObpRemoveModuleInterfaces(
+			IN AurieModule* Module
+		)
+		{
+			AurieExclusiveLock interface_lock(g_ObInterfaceLock);
+
+			ObpUpdateInterfaceTables(
+				[Module](ObpInterfaceTables& Tables)
+				{
+					for (auto& table_entry : Module->InterfaceTable)
+						ObpUnregisterInterface(Tables, table_entry);
+				}
+			);
+
+			// Readers may still hold entries from the old tables, so they're freed once those are done
+			auto removed_entries = std::make_unique<std::list<AurieInterfaceTableEntry>>();
+			removed_entries->splice(removed_entries->end(), Module->InterfaceTable);
+
+			ObpRcuRetireObject(std::move(removed_entries));
+		}
+
+		void ObpUnregisterInterface(
+			IN OUT ObpInterfaceTables& Tables,
+			IN AurieInterfaceTableEntry& Entry
+		)
+		{
+			Tables.Index.erase(ObpInterfaceKey{ Entry.NameHash, Entry.FoldedName });
+
+			// Bumping the generation is what makes outstanding handles stale
+			ObpInterfaceSlot& slot = Tables.Slots[Entry.HandleIndex];
+			slot.Entry = nullptr;
+			slot.Generation++;
+
+			Tables.FreeSlots.push_back(Entry.HandleIndex);
+		}
+
+		AurieStatus ObpDestroyInterface(
+			IN AurieModule* Module, 
+			IN AurieInterfaceBase* Interface,
+			IN bool Notify,
+			IN bool RemoveFromList
+		)
+		{
+			if (Notify)
+			{
+				Interface->Destroy();
+			}
+
+			if (RemoveFromList)
+			{
+				AurieExclusiveLock interface_lock(g_ObInterfaceLock);
+
+				// Unindex them first, the keys point into the entries
+				ObpUpdateInterfaceTables(
+					[Module, Interface](ObpInterfaceTables& Tables)
+					{
+						for (auto& table_entry : Module->InterfaceTable)
+						{
+							if (table_entry.Interface == Interface)
+								ObpUnregisterInterface(Tables, table_entry);
+						}
+					}
+				);
+
+				// Move all interface entries with this one interface out of the table,
+				// they're freed once no reader can still be looking at them
+				auto removed_entries = std::make_unique<std::list<AurieInterfaceTableEntry>>();
+				for (auto iterator = Module->InterfaceTable.begin(); iterator != Module->InterfaceTable.end();)
+				{
+					auto next_iterator = std::next(iterator);
+
+					if (iterator->Interface == Interface)
+						removed_entries->splice(removed_entries->end(), Module->InterfaceTable, iterator);
+
+					iterator = next_iterator;
+				}
+
+				ObpRcuRetireObject(std::move(removed_entries));
+			}
+
+			return AURIE_SUCCESS;
+		}
+
+		AurieStatus ObpLookupInterfaceOwner(
+			IN const char* InterfaceName,
+			IN bool CaseInsensitive,
+			OUT AurieModule*& Module,
+			OUT AurieInterfaceTableEntry*& TableEntry
+		)
+		{
+			std::string folded_name;
+			const uint64_t name_hash = ObpFoldInterfaceName(
+				InterfaceName,
+				folded_name
+			);
+
+			AurieRcuReadGuard rcu_guard;
+
+			const ObpInterfaceTables* interface_tables = g_ObInterfaceTables.Load();
+			if (!interface_tables)
+				return AURIE_OBJECT_NOT_FOUND;
+
+			auto iterator = interface_tables->Index.find(ObpInterfaceKey{ name_hash, folded_name });
+			if (iterator != interface_tables->Index.end())
+			{
+				AurieInterfaceTableEntry* table_entry = iterator->second;
+
+				// The index only knows about case-folded names
+				if (CaseInsensitive || !strcmp(table_entry->InterfaceName, InterfaceName))
+				{
+					Module = table_entry->OwnerModule;
+					TableEntry = table_entry;
+					return AURIE_SUCCESS;
+				}
+			}
+
+			// We didn't find any interface with that name.
+			return AURIE_OBJECT_NOT_FOUND;
+		}
+	}
+
+	AurieStatus ObGetInterface(
+		IN const char* InterfaceName,
+		OUT AurieInterfaceBase*& Interface
+	)
+	{
+		AurieStatus last_status = AURIE_SUCCESS;
+
+		{
+			AurieRcuReadGuard rcu_guard;
+
+			AurieModule* owner_module = nullptr;
+			AurieInterfaceTableEntry* interface_entry = nullptr;
+
+			last_status = Internal::ObpLookupInterfaceOwner(
+				InterfaceName,
+				true,
+				owner_module,
+				interface_entry
+			);
+
+			if (AurieSuccess(last_status))
+			{
+				Interface = interface_entry->Interface;
+				return AURIE_SUCCESS;
+			}
+		}
+
+		// A deferred module may provide it. Once loaded it's no longer deferred, so this only recurses once.
+		if (last_status != AURIE_OBJECT_NOT_FOUND || !AurieSuccess(Internal::MdpLoadLazyImage(InterfaceName)))
+			return last_status;
+
+		return ObGetInterface(InterfaceName, Interface);
+	}
+
+	AurieStatus ObDestroyInterface(
+		IN AurieModule* Module,
+		IN const char* InterfaceName
+	)
+	{
+		AurieRcuReadGuard rcu_guard;
+
+		AurieModule* owner_module = nullptr;
+		AurieInterfaceTableEntry* table_entry = nullptr;
+
+		AurieStatus last_status = Internal::ObpLookupInterfaceOwner(
+			InterfaceName,
+			true,
+			owner_module,
+			table_entry
+		);
+
+		if (!AurieSuccess(last_status))
+			return last_status;
+
+		if (owner_module != Module)
+			return AURIE_ACCESS_DENIED;
+
+		last_status = Internal::ObpDestroyInterface(
+			Module,
+			table_entry->Interface,
+			true,
+			true
+		);
+
+		return AURIE_SUCCESS;
+	}
+
+	AurieStatus ObAcquireInterfaceHandle(
+		IN const char* InterfaceName,
+		OUT AurieInterfaceHandle& Handle
+	)
+	{
+		AurieStatus last_status = AURIE_SUCCESS;
+
+		{
+			AurieRcuReadGuard rcu_guard;
+
+			AurieModule* owner_module = nullptr;
+			AurieInterfaceTableEntry* table_entry = nullptr;
+
+			last_status = Internal::ObpLookupInterfaceOwner(
+				InterfaceName,
+				true,
+				owner_module,
+				table_entry
+			);
+
+			if (AurieSuccess(last_status))
+			{
+				// The lookup found the entry, so the tables it loaded from exist
+				Handle.Index = table_entry->HandleIndex;
+				Handle.Generation = Internal::g_ObInterfaceTables.Load()->Slots[table_entry->HandleIndex].Generation;
+
+				return AURIE_SUCCESS;
+			}
+		}
+
+		// Same as in ObGetInterface
+		if (last_status != AURIE_OBJECT_NOT_FOUND || !AurieSuccess(Internal::MdpLoadLazyImage(InterfaceName)))
+			return last_status;
+
+		return ObAcquireInterfaceHandle(InterfaceName, Handle);
+	}
+
+	AurieStatus ObResolveInterfaceHandle(
+		IN AurieInterfaceHandle Handle,
+		OUT AurieInterfaceBase*& Interface
+	)
+	{
+		AurieRcuReadGuard rcu_guard;
+
+		const Internal::ObpInterfaceTables* interface_tables = Internal::g_ObInterfaceTables.Load();
+		if (!interface_tables || Handle.Index >= interface_tables->Slots.size())
+			return AURIE_INVALID_PARAMETER;
+
+		const Internal::ObpInterfaceSlot& slot = interface_tables->Slots[Handle.Index];
+		if (slot.Generation != Handle.Generation || !slot.Entry)
+			return AURIE_OBJECT_NOT_FOUND;
+
+		Interface = slot.Entry->Interface;
+		return AURIE_SUCCESS;
+	}
+}
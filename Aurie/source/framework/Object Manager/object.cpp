@@ -2,87 +2,15 @@
 
 namespace Aurie
 {
-	AurieStatus ObCreateInterface(
-		IN AurieModule* Module, 
-		IN AurieInterfaceBase* Interface, 
-		IN const char* InterfaceName
-	)
-	{
-		if (ObInterfaceExists(InterfaceName))
-			return AURIE_OBJECT_ALREADY_EXISTS;
-
-		AurieInterfaceTableEntry table_entry = {};
-		table_entry.Interface = Interface;
-		table_entry.InterfaceName = InterfaceName;
-		table_entry.OwnerModule = Module;
-
-		// Make sure the interface knows it's being set up,
-		// and that it succeeds at doing so. We don't want an
-		// uninitialized, half-broken interface exposed!
-
-		AurieStatus last_status = Interface->Create();
-		if (!AurieSuccess(last_status))
-			return last_status;
-
-		return Internal::ObpAddInterfaceToTable(
-			Module,
-			table_entry
-		);
-	}
-
-	bool ObInterfaceExists(
-		IN const char* InterfaceName
-	)
-	{
-		AurieModule* containing_module = nullptr;
-		AurieInterfaceTableEntry* table_entry = nullptr;
-		
-		// If we find a module containing the interface, that means the interface exists!
-		// ObpLookupInterfaceOwner will return AURIE_INTERFACE_NOT_FOUND if it doesn't exist.
-		return AurieSuccess(
-			Internal::ObpLookupInterfaceOwner(
-				InterfaceName,
-				true,
-				containing_module,
-				table_entry
-			)
-		);
-	}
-
 	namespace Internal
 	{
-		AurieStatus ObpDestroyInterfaceByName(
-			IN const char* InterfaceName
-		)
-		{
-			AurieModule* owner_module = nullptr;
-			AurieInterfaceTableEntry* table_entry = nullptr;
-			AurieStatus last_status = AURIE_SUCCESS;
-
-			last_status = ObpLookupInterfaceOwner(
-				InterfaceName,
-				true,
-				owner_module,
-				table_entry
-			);
-
-			if (!AurieSuccess(last_status))
-				return last_status;
-
-			return ObpDestroyInterface(
-				owner_module,
-				table_entry->Interface,
-				true,
-				true
-			);
-		}
-
 		AurieStatus ObpLookupInterfaceOwnerExport(
 			IN const char* InterfaceName, 
 			IN const char* ExportName,
 			OUT PVOID& ExportAddress
 		)
 		{
+			AurieRcuReadGuard rcu_guard;
 			AurieStatus last_status = AURIE_SUCCESS;
 
 			AurieModule* interface_owner = nullptr;
@@ -135,6 +63,45 @@ namespace Aurie
 		)
 		{
 			Module->ModuleOperationCallback = CallbackRoutine;
+
+			// The callback is just another subscriber to the module operation events
+			for (AurieEventId event_id : { AURIE_EVENT_MODULE_PREINITIALIZE, AURIE_EVENT_MODULE_INITIALIZE, AURIE_EVENT_MODULE_UNLOAD })
+			{
+				ObUnsubscribeEvent(
+					Module,
+					event_id,
+					ObpModuleOperationCallbackAdapter
+				);
+
+				if (CallbackRoutine)
+				{
+					ObSubscribeEvent(
+						Module,
+						event_id,
+						ObpModuleOperationCallbackAdapter,
+						Module
+					);
+				}
+			}
+		}
+
+		void ObpModuleOperationCallbackAdapter(
+			IN AurieEventId EventId,
+			IN PVOID EventData,
+			IN PVOID Context
+		)
+		{
+			AurieModule* subscribed_module = reinterpret_cast<AurieModule*>(Context);
+			AurieModuleOperationEvent* operation_event = reinterpret_cast<AurieModuleOperationEvent*>(EventData);
+
+			if (!subscribed_module->ModuleOperationCallback)
+				return;
+
+			subscribed_module->ModuleOperationCallback(
+				operation_event->AffectedModule,
+				operation_event->OperationType,
+				operation_event->OperationInfo
+			);
 		}
 
 		void ObpDispatchModuleOperationCallbacks(
@@ -143,177 +110,427 @@ namespace Aurie
 			IN bool IsFutureCall
 		)
 		{
-			// Determine the operation type
-			// Yes I know, this is ugly, if you know a better solution
-			// feel free to PR / tell me.
-			AurieModuleOperationType current_operation_type = AURIE_OPERATION_UNKNOWN;
+			// Figure out which entry is being called, this only happens once per dispatch
+			AurieModuleOperationEvent operation_event = {};
+			AurieEventId event_id = AURIE_EVENT_INVALID;
 
 			if (Routine == AffectedModule->ModulePreinitialize)
-				current_operation_type = AURIE_OPERATION_PREINITIALIZE;
+			{
+				operation_event.OperationType = AURIE_OPERATION_PREINITIALIZE;
+				event_id = AURIE_EVENT_MODULE_PREINITIALIZE;
+			}
 			else if (Routine == AffectedModule->ModuleInitialize)
-				current_operation_type = AURIE_OPERATION_INITIALIZE;
+			{
+				operation_event.OperationType = AURIE_OPERATION_INITIALIZE;
+				event_id = AURIE_EVENT_MODULE_INITIALIZE;
+			}
 			else if (Routine == AffectedModule->ModuleUnload)
-				current_operation_type = AURIE_OPERATION_UNLOAD;
-			
+			{
+				operation_event.OperationType = AURIE_OPERATION_UNLOAD;
+				event_id = AURIE_EVENT_MODULE_UNLOAD;
+			}
+
+			if (event_id == AURIE_EVENT_INVALID)
+				return;
+
 			AurieOperationInfo operation_information = ObpCreateOperationInfo(
 				AffectedModule,
 				IsFutureCall
 			);
 
-			for (auto& loaded_module : g_LdrModuleList)
-			{
-				if (!loaded_module.ModuleOperationCallback)
-					continue;
+			operation_event.AffectedModule = AffectedModule;
+			operation_event.OperationInfo = &operation_information;
 
-				loaded_module.ModuleOperationCallback(
-					AffectedModule,
-					current_operation_type,
-					&operation_information
-				);
-			}
+			ObPublishEvent(
+				event_id,
+				&operation_event
+			);
 		}
 
-		AurieStatus ObpAddInterfaceToTable(
-			IN AurieModule* Module, 
-			IN AurieInterfaceTableEntry& Entry
+		void ObpUpdateSubscribers(
+			IN AurieEventId EventId,
+			IN const std::function<void(ObpSubscriberList& Subscribers)>& Editor
 		)
 		{
-			Module->InterfaceTable.push_back(Entry);
+			AurieExclusiveLock event_lock(g_ObEventLock);
+
+			// Writers are serialized by the lock, so the published list can't change under us
+			const ObpSubscriberList* current_list = g_ObEventSubscribers[EventId].Load();
+
+			auto new_list = current_list ? std::make_unique<ObpSubscriberList>(*current_list) : std::make_unique<ObpSubscriberList>();
+			Editor(*new_list);
+
+			// Publishers still walking the old list are in a read section, it's retired until they leave it
+			if (new_list->empty())
+				new_list.reset();
+
+			g_ObEventSubscribers[EventId].Publish(std::move(new_list));
+		}
+
+		AurieStatus ObpInitializeServiceQueue()
+		{
+			g_ObServiceQueue.WakeEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+			g_ObServiceQueue.StopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+
+			if (!g_ObServiceQueue.WakeEvent || !g_ObServiceQueue.StopEvent)
+				return AURIE_EXTERNAL_ERROR;
 
 			return AURIE_SUCCESS;
 		}
 
-		AurieOperationInfo ObpCreateOperationInfo(
-			IN AurieModule* Module,
-			IN bool IsFutureCall
-		)
+		void ObpDestroyServiceQueue()
 		{
-			AurieOperationInfo operation_information = {};
+			{
+				AurieExclusiveLock queue_lock(g_ObServiceQueue.Lock);
+				g_ObServiceQueue.Tasks.clear();
+			}
 
-			operation_information.IsFutureCall = IsFutureCall;
-			operation_information.ModuleBaseAddress = MdpGetModuleBaseAddress(Module);
+			if (g_ObServiceQueue.WakeEvent)
+				CloseHandle(g_ObServiceQueue.WakeEvent);
 
-			return operation_information;
+			if (g_ObServiceQueue.StopEvent)
+				CloseHandle(g_ObServiceQueue.StopEvent);
+
+			g_ObServiceQueue.WakeEvent = nullptr;
+			g_ObServiceQueue.StopEvent = nullptr;
 		}
 
-		AurieStatus ObpDestroyInterface(
-			IN AurieModule* Module, 
-			IN AurieInterfaceBase* Interface,
-			IN bool Notify,
-			IN bool RemoveFromList
+		AurieStatus ObpPostServiceTask(
+			IN AurieModule* Owner,
+			IN std::function<void()> Routine
 		)
 		{
-			if (Notify)
 			{
-				Interface->Destroy();
+				AurieExclusiveLock queue_lock(g_ObServiceQueue.Lock);
+				g_ObServiceQueue.Tasks.push_back({ Owner, std::move(Routine) });
 			}
 
-			if (RemoveFromList)
+			SetEvent(g_ObServiceQueue.WakeEvent);
+			return AURIE_SUCCESS;
+		}
+
+		void ObpRunServiceLoop(
+			IN UINT UnloadHotkey
+		)
+		{
+			// The hotkey is delivered as a message to this thread, which is why the wait below pumps messages
+			bool has_hotkey = UnloadHotkey && RegisterHotKey(
+				nullptr,
+				OBP_UNLOAD_HOTKEY_ID,
+				OBP_UNLOAD_HOTKEY_MODIFIERS | MOD_NOREPEAT,
+				UnloadHotkey
+			);
+
+			// Tasks posted while modules were initializing
+			ObpDrainServiceQueue();
+
+			bool is_running = true;
+			while (is_running)
 			{
-				Module->InterfaceTable.remove_if(
-					[Interface](const AurieInterfaceTableEntry& Entry) -> bool
+				HANDLE wait_handles[] = { g_ObServiceQueue.WakeEvent, g_ObServiceQueue.StopEvent };
+				DWORD wait_status = MsgWaitForMultipleObjects(
+					static_cast<DWORD>(std::size(wait_handles)),
+					wait_handles,
+					FALSE,
+					INFINITE,
+					QS_HOTKEY
+				);
+
+				if (wait_status == WAIT_OBJECT_0)
+				{
+					ObpDrainServiceQueue();
+				}
+				else if (wait_status == WAIT_OBJECT_0 + std::size(wait_handles))
+				{
+					MSG message = {};
+					while (PeekMessageW(&message, nullptr, 0, 0, PM_REMOVE))
 					{
-						// Remove all interface entries with this one interface
-						return Entry.Interface == Interface;
+						if (message.message == WM_HOTKEY && message.wParam == OBP_UNLOAD_HOTKEY_ID)
+							is_running = false;
 					}
-				);
+				}
+				else
+				{
+					// Either ObRequestShutdown, or the wait failed and there's no way to keep going
+					is_running = false;
+				}
 			}
 
-			return AURIE_SUCCESS;
+			if (has_hotkey)
+				UnregisterHotKey(nullptr, OBP_UNLOAD_HOTKEY_ID);
+		}
+
+		void ObpDrainServiceQueue()
+		{
+			while (true)
+			{
+				ObpServiceTask service_task;
+
+				// One at a time, a task may unload a module whose tasks are further down the queue
+				{
+					AurieExclusiveLock queue_lock(g_ObServiceQueue.Lock);
+
+					if (g_ObServiceQueue.Tasks.empty())
+						break;
+
+					service_task = std::move(g_ObServiceQueue.Tasks.front());
+					g_ObServiceQueue.Tasks.pop_front();
+				}
+
+				service_task.Routine();
+			}
+
+			// Modules that failed to load at runtime, or were marked by tasks
+			MdpPurgeMarkedModules();
+		}
+
+		void ObpRemoveModuleTasks(
+			IN AurieModule* Module
+		)
+		{
+			AurieExclusiveLock queue_lock(g_ObServiceQueue.Lock);
+
+			std::erase_if(
+				g_ObServiceQueue.Tasks,
+				[Module](const ObpServiceTask& Task) -> bool
+				{
+					return Task.Owner == Module;
+				}
+			);
 		}
 
-		AurieStatus ObpLookupInterfaceOwner(
-			IN const char* InterfaceName,
-			IN bool CaseInsensitive,
-			OUT AurieModule*& Module,
-			OUT AurieInterfaceTableEntry*& TableEntry
+		void ObpRemoveModuleSubscriptions(
+			IN AurieModule* Module
 		)
 		{
-			// Loop every single module
-			for (auto& loaded_module : Internal::g_LdrModuleList)
+			for (AurieEventId event_id = 0; event_id < OBP_MAX_EVENTS; event_id++)
 			{
-				// Check if we found it in this module
-				auto iterator = std::find_if(
-					loaded_module.InterfaceTable.begin(),
-					loaded_module.InterfaceTable.end(),
-					[CaseInsensitive, InterfaceName](const AurieInterfaceTableEntry& entry) -> bool
-					{
-						// Do a case insensitive comparison if needed
-						if (CaseInsensitive)
+				bool is_subscribed = false;
+
+				{
+					AurieRcuReadGuard rcu_guard;
+
+					const ObpSubscriberList* current_list = g_ObEventSubscribers[event_id].Load();
+					if (!current_list)
+						continue;
+
+					is_subscribed = std::any_of(
+						current_list->begin(),
+						current_list->end(),
+						[Module](const ObpEventSubscriber& Subscriber) -> bool
 						{
-							return !_stricmp(entry.InterfaceName, InterfaceName);
+							return Subscriber.Owner == Module;
 						}
+					);
+				}
 
-						return !strcmp(entry.InterfaceName, InterfaceName);
+				if (!is_subscribed)
+					continue;
+
+				ObpUpdateSubscribers(
+					event_id,
+					[Module](ObpSubscriberList& Subscribers)
+					{
+						std::erase_if(
+							Subscribers,
+							[Module](const ObpEventSubscriber& Subscriber) -> bool
+							{
+								return Subscriber.Owner == Module;
+							}
+						);
 					}
 				);
-
-				// We found the interface in the current module!
-				if (iterator != std::end(loaded_module.InterfaceTable))
-				{
-					Module = &loaded_module;
-					TableEntry = &(*iterator);
-					return AURIE_SUCCESS;
-				}
 			}
+		}
 
-			// We didn't find any interface with that name.
-			return AURIE_OBJECT_NOT_FOUND;
+		AurieOperationInfo ObpCreateOperationInfo(
+			IN AurieModule* Module,
+			IN bool IsFutureCall
+		)
+		{
+			AurieOperationInfo operation_information = {};
+
+			operation_information.IsFutureCall = IsFutureCall;
+			operation_information.ModuleBaseAddress = MdpGetModuleBaseAddress(Module);
+
+			return operation_information;
 		}
 	}
 
-	AurieStatus ObGetInterface(
-		IN const char* InterfaceName,
-		OUT AurieInterfaceBase*& Interface
+	AurieStatus ObRegisterEvent(
+		IN const char* EventName,
+		OUT AurieEventId& EventId
 	)
 	{
-		AurieStatus last_status = AURIE_SUCCESS;
-		AurieModule* owner_module = nullptr;
-		AurieInterfaceTableEntry* interface_entry = nullptr;
-
-		last_status = Internal::ObpLookupInterfaceOwner(
-			InterfaceName,
-			true,
-			owner_module,
-			interface_entry
-		);
+		if (!EventName)
+			return AURIE_INVALID_PARAMETER;
+
+		AurieExclusiveLock event_lock(Internal::g_ObEventLock);
+
+		auto iterator = Internal::g_ObCustomEvents.find(EventName);
+		if (iterator != Internal::g_ObCustomEvents.end())
+		{
+			EventId = iterator->second;
+			return AURIE_SUCCESS;
+		}
+
+		if (Internal::g_ObNextCustomEvent >= Internal::OBP_MAX_EVENTS)
+			return AURIE_INSUFFICIENT_MEMORY;
+
+		EventId = Internal::g_ObNextCustomEvent++;
+		Internal::g_ObCustomEvents.emplace(EventName, EventId);
+
+		return AURIE_SUCCESS;
+	}
+
+	AurieStatus ObSubscribeEvent(
+		IN AurieModule* Module,
+		IN AurieEventId EventId,
+		IN AurieEventCallback Callback,
+		IN OPTIONAL PVOID Context
+	)
+	{
+		if (!Module || !Callback || EventId == AURIE_EVENT_INVALID || EventId >= Internal::OBP_MAX_EVENTS)
+			return AURIE_INVALID_PARAMETER;
 
-		if (!AurieSuccess(last_status))
-			return last_status;
+		Internal::ObpUpdateSubscribers(
+			EventId,
+			[Module, Callback, Context](Internal::ObpSubscriberList& Subscribers)
+			{
+				Subscribers.push_back({ Module, Callback, Context });
+			}
+		);
 
-		Interface = interface_entry->Interface;
 		return AURIE_SUCCESS;
 	}
 
-	AurieStatus ObDestroyInterface(
+	AurieStatus ObUnsubscribeEvent(
 		IN AurieModule* Module,
-		IN const char* InterfaceName
+		IN AurieEventId EventId,
+		IN AurieEventCallback Callback
 	)
 	{
-		AurieModule* owner_module = nullptr;
-		AurieInterfaceTableEntry* table_entry = nullptr;
-
-		AurieStatus last_status = Internal::ObpLookupInterfaceOwner(
-			InterfaceName,
-			true,
-			owner_module,
-			table_entry
+		if (EventId == AURIE_EVENT_INVALID || EventId >= Internal::OBP_MAX_EVENTS)
+			return AURIE_INVALID_PARAMETER;
+
+		size_t removed_count = 0;
+
+		Internal::ObpUpdateSubscribers(
+			EventId,
+			[Module, Callback, &removed_count](Internal::ObpSubscriberList& Subscribers)
+			{
+				removed_count = std::erase_if(
+					Subscribers,
+					[Module, Callback](const Internal::ObpEventSubscriber& Subscriber) -> bool
+					{
+						return Subscriber.Owner == Module && Subscriber.Callback == Callback;
+					}
+				);
+			}
 		);
 
-		if (!AurieSuccess(last_status))
-			return last_status;
+		return removed_count ? AURIE_SUCCESS : AURIE_OBJECT_NOT_FOUND;
+	}
+
+	AurieStatus ObPublishEvent(
+		IN AurieEventId EventId,
+		IN OPTIONAL PVOID EventData
+	)
+	{
+		if (EventId == AURIE_EVENT_INVALID || EventId >= Internal::OBP_MAX_EVENTS)
+			return AURIE_INVALID_PARAMETER;
 
-		if (owner_module != Module)
-			return AURIE_ACCESS_DENIED;
+		// The read section keeps the list valid even if someone (un)subscribes from a callback
+		AurieRcuReadGuard rcu_guard;
+
+		const Internal::ObpSubscriberList* subscribers = Internal::g_ObEventSubscribers[EventId].Load();
+		if (!subscribers)
+			return AURIE_SUCCESS;
+
+		for (const auto& subscriber : *subscribers)
+		{
+			subscriber.Callback(
+				EventId,
+				EventData,
+				subscriber.Context
+			);
+		}
+
+		return AURIE_SUCCESS;
+	}
+
+	AurieStatus ObPostTask(
+		IN AurieModule* Module,
+		IN AurieTaskRoutine Routine,
+		IN OPTIONAL PVOID Context
+	)
+	{
+		if (!Module || !Routine)
+			return AURIE_INVALID_PARAMETER;
 
-		last_status = Internal::ObpDestroyInterface(
+		return Internal::ObpPostServiceTask(
 			Module,
-			table_entry->Interface,
-			true,
-			true
+			[Routine, Context]()
+			{
+				Routine(Context);
+			}
 		);
+	}
+
+	AurieStatus ObRequestShutdown(
+		IN AurieModule* Module
+	)
+	{
+		if (!Internal::g_ObServiceQueue.StopEvent)
+			return AURIE_OBJECT_NOT_FOUND;
 
+		if (Module)
+		{
+			std::wstring message = L"[Aurie] Shutdown requested by " + Module->ImagePath.filename().wstring() + L"\n";
+			OutputDebugStringW(message.c_str());
+		}
+
+		SetEvent(Internal::g_ObServiceQueue.StopEvent);
 		return AURIE_SUCCESS;
 	}
-}
 
+	AurieStatus ObWaitForModuleInitialization(
+		IN AurieModule* Module,
+		IN uint32_t Timeout
+	)
+	{
+		if (!Module)
+			return AURIE_INVALID_PARAMETER;
+
+		// Our own reference, the module may be unloaded while we wait
+		std::shared_ptr<AurieAsyncInitialization> async_initialization;
+
+		{
+			AurieRcuReadGuard rcu_guard;
+
+			// The module may have been unloaded already, only touch it if it's still in the list
+			const Internal::MdpModuleSnapshot* module_snapshot = Internal::g_LdrModuleSnapshot.Load();
+
+			size_t position = 0;
+			if (!module_snapshot || !Internal::MdpLocateModule(*module_snapshot, Module, position))
+				return AURIE_INVALID_PARAMETER;
+
+			if (MdIsImageInitialized(Module))
+				return AURIE_SUCCESS;
+
+			async_initialization = Module->AsyncInitialization;
+		}
+
+		if (!async_initialization || !async_initialization->HasStarted)
+			return AURIE_OBJECT_NOT_FOUND;
+
+		DWORD wait_result = WaitForSingleObject(async_initialization->CompletionEvent, Timeout);
+		if (wait_result == WAIT_TIMEOUT)
+			return AURIE_UNAVAILABLE;
+
+		if (wait_result != WAIT_OBJECT_0)
+			return AURIE_EXTERNAL_ERROR;
+
+		return async_initialization->Status;
+	}
+}
\ No newline at end of file
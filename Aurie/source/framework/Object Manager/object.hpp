@@ -2,6 +2,13 @@
 #define AURIE_OBJECT_H_
 
 #include "../framework.hpp"
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 namespace Aurie
 {
@@ -11,6 +18,7 @@ namespace Aurie
 		IN const char* InterfaceName
 	);
 
+	// Doesn't load modules deferred with AURIE_MANIFEST_LAZY_LOAD, unlike ObGetInterface
 	EXPORTED bool ObInterfaceExists(
 		IN const char* InterfaceName
 	);
@@ -20,13 +28,197 @@ namespace Aurie
 		IN const char* InterfaceName
 	);
 
+	// Loads the module providing the interface first if it was deferred with AURIE_MANIFEST_LAZY_LOAD
 	EXPORTED AurieStatus ObGetInterface(
 		IN const char* InterfaceName,
 		OUT AurieInterfaceBase*& Interface
 	);
 
+	// Returns the ID of a custom event, allocating one the first time a name is seen.
+	// Every module registering the same name gets the same ID.
+	EXPORTED AurieStatus ObRegisterEvent(
+		IN const char* EventName,
+		OUT AurieEventId& EventId
+	);
+
+	// Callback gets called on every ObPublishEvent of EventId until unsubscribed or Module is unloaded
+	EXPORTED AurieStatus ObSubscribeEvent(
+		IN AurieModule* Module,
+		IN AurieEventId EventId,
+		IN AurieEventCallback Callback,
+		IN OPTIONAL PVOID Context
+	);
+
+	EXPORTED AurieStatus ObUnsubscribeEvent(
+		IN AurieModule* Module,
+		IN AurieEventId EventId,
+		IN AurieEventCallback Callback
+	);
+
+	// Calls every subscriber of EventId on the current thread
+	EXPORTED AurieStatus ObPublishEvent(
+		IN AurieEventId EventId,
+		IN OPTIONAL PVOID EventData
+	);
+
+	// Queues Routine to run on the framework's service thread once every module is initialized.
+	// Tasks that haven't run yet are dropped when Module is unloaded.
+	EXPORTED AurieStatus ObPostTask(
+		IN AurieModule* Module,
+		IN AurieTaskRoutine Routine,
+		IN OPTIONAL PVOID Context
+	);
+
+	// Stops the service thread, which unloads the framework and every module.
+	// Module is only used to say who asked in the debugger output.
+	EXPORTED AurieStatus ObRequestShutdown(
+		IN AurieModule* Module
+	);
+
+	// Waits for a module's asynchronous ModuleInitialize and returns what it returned.
+	// Timeout is in milliseconds and may be INFINITE, AURIE_UNAVAILABLE is returned if it runs out.
+	// Fails with AURIE_OBJECT_NOT_FOUND if Module isn't initialized and isn't initializing in the background,
+	// and with AURIE_INVALID_PARAMETER if it isn't loaded (anymore).
+	EXPORTED AurieStatus ObWaitForModuleInitialization(
+		IN AurieModule* Module,
+		IN uint32_t Timeout
+	);
+
+	// Looks an interface up once, the handle can then be resolved without going through its name
+	EXPORTED AurieStatus ObAcquireInterfaceHandle(
+		IN const char* InterfaceName,
+		OUT AurieInterfaceHandle& Handle
+	);
+
+	// Fails with AURIE_OBJECT_NOT_FOUND once the interface is destroyed or its owner unloaded
+	EXPORTED AurieStatus ObResolveInterfaceHandle(
+		IN AurieInterfaceHandle Handle,
+		OUT AurieInterfaceBase*& Interface
+	);
+
 	namespace Internal
 	{
+		// Identifies an interface in the index, the hash is computed once when it's registered
+		struct ObpInterfaceKey
+		{
+			uint64_t Hash;
+			std::string_view FoldedName;
+
+			bool operator==(const ObpInterfaceKey& Other) const
+			{
+				return Hash == Other.Hash && FoldedName == Other.FoldedName;
+			}
+		};
+
+		struct ObpInterfaceKeyHash
+		{
+			size_t operator()(const ObpInterfaceKey& Key) const
+			{
+				return static_cast<size_t>(Key.Hash);
+			}
+		};
+
+		struct ObpInterfaceSlot
+		{
+			AurieInterfaceTableEntry* Entry;
+			uint32_t Generation;
+		};
+
+		// Highest event ID the bus can hold
+		constexpr AurieEventId OBP_MAX_EVENTS = 1024;
+
+		struct ObpEventSubscriber
+		{
+			AurieModule* Owner;
+			AurieEventCallback Callback;
+			PVOID Context;
+		};
+
+		// Subscriber lists are never modified in place. Writers copy, modify and publish a new list,
+		// so ObPublishEvent only has to load the current one and walk it. Read without locking, see AurieRcuPointer.
+		using ObpSubscriberList = std::vector<ObpEventSubscriber>;
+		inline AurieRcuPointer<ObpSubscriberList> g_ObEventSubscribers[OBP_MAX_EVENTS];
+
+		struct ObpServiceTask
+		{
+			AurieModule* Owner;
+			std::function<void()> Routine;
+		};
+
+		struct ObpServiceQueue
+		{
+			SRWLOCK Lock = SRWLOCK_INIT;
+			std::deque<ObpServiceTask> Tasks;
+
+			// Auto-reset, set whenever a task is posted
+			HANDLE WakeEvent = nullptr;
+
+			// Manual-reset, set by ObRequestShutdown
+			HANDLE StopEvent = nullptr;
+		};
+
+		inline ObpServiceQueue g_ObServiceQueue;
+
+		// Hotkey ID the unload hotkey is registered under on the service thread
+		constexpr int OBP_UNLOAD_HOTKEY_ID = 0x4155;
+
+		// Hotkeys are system-wide and swallow the key for every other application,
+		// so the unload hotkey is never a bare key.
+		constexpr UINT OBP_UNLOAD_HOTKEY_MODIFIERS = MOD_CONTROL | MOD_SHIFT;
+
+		// Set in the environment to the virtual key code that unloads the framework together with
+		// Ctrl+Shift, zero disables it. VK_END (so Ctrl+Shift+End) if it's not set.
+		inline constexpr const wchar_t* OBP_UNLOAD_HOTKEY_VARIABLE = L"AURIE_UNLOAD_HOTKEY";
+
+		// Serializes writers of the above, and guards custom event registration
+		inline SRWLOCK g_ObEventLock = SRWLOCK_INIT;
+		inline std::unordered_map<std::string, AurieEventId> g_ObCustomEvents;
+		inline AurieEventId g_ObNextCustomEvent = AURIE_EVENT_FIRST_CUSTOM;
+
+		struct ObpInterfaceTables
+		{
+			// Every interface of every loaded module by case-folded name.
+			// Keys point into the FoldedName of the table entry they map to.
+			std::unordered_map<ObpInterfaceKey, AurieInterfaceTableEntry*, ObpInterfaceKeyHash> Index;
+
+			// Slots referred to by interface handles, and the ones that are free to reuse
+			std::vector<ObpInterfaceSlot> Slots;
+			std::vector<uint32_t> FreeSlots;
+		};
+
+		// Read without locking, see AurieRcuPointer
+		inline AurieRcuPointer<ObpInterfaceTables> g_ObInterfaceTables;
+
+		// Serializes writers of the above and of every module's InterfaceTable
+		inline SRWLOCK g_ObInterfaceLock = SRWLOCK_INIT;
+
+		// A thread's position in the RCU scheme, registered on its first read section
+		struct ObpRcuThreadRecord
+		{
+			// Global epoch when the thread entered its outermost read section, zero outside one
+			std::atomic<uint64_t> ActiveEpoch = 0;
+			uint32_t Nesting = 0;
+
+			ObpRcuThreadRecord();
+			~ObpRcuThreadRecord();
+		};
+
+		struct ObpRcuRetiredObject
+		{
+			const void* Object;
+			void(*Deleter)(const void* Object);
+
+			// Epoch the object was unpublished in, readers that entered after it can't see the object
+			uint64_t Epoch;
+		};
+
+		inline std::atomic<uint64_t> g_ObRcuEpoch = 1;
+
+		// Guards the thread records and the retired objects
+		inline SRWLOCK g_ObRcuLock = SRWLOCK_INIT;
+		inline std::vector<ObpRcuThreadRecord*> g_ObRcuThreads;
+		inline std::vector<ObpRcuRetiredObject> g_ObRcuRetired;
+
 		EXPORTED void ObpSetModuleOperationCallback(
 			IN AurieModule* Module,
 			IN AurieModuleCallback CallbackRoutine
@@ -55,6 +247,7 @@ namespace Aurie
 			IN bool RemoveFromList
 		);
 
+		// TableEntry is only valid for as long as the caller stays in an RCU read section
 		AurieStatus ObpLookupInterfaceOwner(
 			IN const char* InterfaceName,
 			IN bool CaseInsensitive,
@@ -62,6 +255,74 @@ namespace Aurie
 			OUT AurieInterfaceTableEntry*& TableEntry
 		);
 
+		// Lowercases InterfaceName into FoldedName and returns its hash
+		uint64_t ObpFoldInterfaceName(
+			IN const char* InterfaceName,
+			OUT std::string& FoldedName
+		);
+
+		// Drops every interface of a module from the index and handle table, and clears its interface table
+		void ObpRemoveModuleInterfaces(
+			IN AurieModule* Module
+		);
+
+		// Publishes a new copy of the interface tables, Editor gets the copy to modify.
+		// The caller must hold g_ObInterfaceLock exclusively.
+		void ObpUpdateInterfaceTables(
+			IN const std::function<void(ObpInterfaceTables& Tables)>& Editor
+		);
+
+		// Frees every retired object regardless of readers, only safe while the framework shuts down
+		void ObpRcuReclaimAll();
+
+		// Has to be called before any module is loaded, modules may post tasks from their entries
+		AurieStatus ObpInitializeServiceQueue();
+
+		void ObpDestroyServiceQueue();
+
+		AurieStatus ObpPostServiceTask(
+			IN AurieModule* Owner,
+			IN std::function<void()> Routine
+		);
+
+		// Runs tasks as they're posted until ObRequestShutdown is called or UnloadHotkey is pressed with Ctrl+Shift.
+		// Sleeps in between, nothing here polls.
+		void ObpRunServiceLoop(
+			IN UINT UnloadHotkey
+		);
+
+		// Runs every queued task, including ones posted by the tasks themselves
+		void ObpDrainServiceQueue();
+
+		// Drops the tasks of a module that's going away
+		void ObpRemoveModuleTasks(
+			IN AurieModule* Module
+		);
+
+		// Drops every subscription made by a module, its callbacks are about to go away
+		void ObpRemoveModuleSubscriptions(
+			IN AurieModule* Module
+		);
+
+		// Rewrites the subscriber list of an event, Editor gets a private copy to modify
+		void ObpUpdateSubscribers(
+			IN AurieEventId EventId,
+			IN const std::function<void(ObpSubscriberList& Subscribers)>& Editor
+		);
+
+		// Forwards the module operation events to a module's ModuleOperationCallback export
+		void ObpModuleOperationCallbackAdapter(
+			IN AurieEventId EventId,
+			IN PVOID EventData,
+			IN PVOID Context
+		);
+
+		// Takes an entry out of the index and invalidates handles to it
+		void ObpUnregisterInterface(
+			IN OUT ObpInterfaceTables& Tables,
+			IN AurieInterfaceTableEntry& Entry
+		);
+
 		AurieStatus ObpDestroyInterfaceByName(
 			IN const char* InterfaceName
 		);
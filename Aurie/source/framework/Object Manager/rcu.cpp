@@ -0,0 +1,91 @@
+#include "object.hpp"
+
+namespace Aurie
+{
+	namespace Internal
+	{
+		static thread_local ObpRcuThreadRecord g_ObpRcuThreadRecord;
+
+		ObpRcuThreadRecord::ObpRcuThreadRecord()
+		{
+			AurieExclusiveLock rcu_lock(g_ObRcuLock);
+			g_ObRcuThreads.push_back(this);
+		}
+
+		ObpRcuThreadRecord::~ObpRcuThreadRecord()
+		{
+			AurieExclusiveLock rcu_lock(g_ObRcuLock);
+			std::erase(g_ObRcuThreads, this);
+		}
+
+		void ObpRcuReadLock()
+		{
+			ObpRcuThreadRecord& thread_record = g_ObpRcuThreadRecord;
+
+			// Only the outermost section announces itself. The store has to be visible
+			// before any snapshot is loaded, which sequential consistency guarantees.
+			if (thread_record.Nesting++ == 0)
+				thread_record.ActiveEpoch.store(g_ObRcuEpoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+		}
+
+		void ObpRcuReadUnlock()
+		{
+			ObpRcuThreadRecord& thread_record = g_ObpRcuThreadRecord;
+
+			if (--thread_record.Nesting == 0)
+				thread_record.ActiveEpoch.store(0, std::memory_order_release);
+		}
+
+		void ObpRcuRetire(
+			IN const void* Object,
+			IN void(*Deleter)(const void* Object)
+		)
+		{
+			std::vector<ObpRcuRetiredObject> reclaimable_objects;
+
+			{
+				AurieExclusiveLock rcu_lock(g_ObRcuLock);
+
+				// The object is already unpublished, so only readers that entered in this epoch or before can see it
+				g_ObRcuRetired.push_back({ Object, Deleter, g_ObRcuEpoch.fetch_add(1, std::memory_order_seq_cst) });
+
+				uint64_t oldest_epoch = UINT64_MAX;
+				for (ObpRcuThreadRecord* thread_record : g_ObRcuThreads)
+				{
+					uint64_t active_epoch = thread_record->ActiveEpoch.load(std::memory_order_seq_cst);
+					if (active_epoch)
+						oldest_epoch = std::min(oldest_epoch, active_epoch);
+				}
+
+				std::erase_if(
+					g_ObRcuRetired,
+					[oldest_epoch, &reclaimable_objects](const ObpRcuRetiredObject& Retired) -> bool
+					{
+						if (Retired.Epoch >= oldest_epoch)
+							return false;
+
+						reclaimable_objects.push_back(Retired);
+						return true;
+					}
+				);
+			}
+
+			// Deleters may retire objects of their own, so they can't run under the lock
+			for (const auto& retired_object : reclaimable_objects)
+				retired_object.Deleter(retired_object.Object);
+		}
+
+		void ObpRcuReclaimAll()
+		{
+			std::vector<ObpRcuRetiredObject> retired_objects;
+
+			{
+				AurieExclusiveLock rcu_lock(g_ObRcuLock);
+				retired_objects.swap(g_ObRcuRetired);
+			}
+
+			for (const auto& retired_object : retired_objects)
+				retired_object.Deleter(retired_object.Object);
+		}
+	}
+}
@@ -444,6 +444,48 @@ namespace Aurie
 		return AURIE_OBJECT_NOT_FOUND;
 	}
 
+	AurieStatus Internal::PpiGetExportFileOffset(
+		IN void* Image,
+		IN const char* ImageExportName,
+		OUT uint32_t& FileOffset
+	)
+	{
+		AurieStatus last_status = AURIE_SUCCESS;
+
+		uintptr_t export_rva = 0;
+		last_status = PpiGetExportOffset(
+			Image,
+			ImageExportName,
+			export_rva
+		);
+
+		if (!AurieSuccess(last_status))
+			return last_status;
+
+		// PpiGetExportOffset already made sure the headers are valid
+		void* nt_headers = nullptr;
+		last_status = PpiGetNtHeader(
+			Image,
+			nt_headers
+		);
+
+		if (!AurieSuccess(last_status))
+			return last_status;
+
+		// Section headers are laid out the same for both bitnesses
+		uint32_t file_offset = PpiRvaToFileOffset(
+			reinterpret_cast<PIMAGE_NT_HEADERS>(nt_headers),
+			static_cast<uint32_t>(export_rva)
+		);
+
+		// The export points into uninitialized data, or outside of any section
+		if (!file_offset)
+			return AURIE_FILE_PART_NOT_FOUND;
+
+		FileOffset = file_offset;
+		return AURIE_SUCCESS;
+	}
+
 	uint32_t Internal::PpiRvaToFileOffset(
 		IN PIMAGE_NT_HEADERS ImageHeaders, 
 		IN uint32_t Rva
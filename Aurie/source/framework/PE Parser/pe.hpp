@@ -69,6 +69,13 @@ namespace Aurie
 			OUT uintptr_t& ExportOffset
 		);
 
+		// Finds where an exported variable's data is in the file itself, for reading it without loading the image
+		AurieStatus PpiGetExportFileOffset(
+			IN void* Image,
+			IN const char* ImageExportName,
+			OUT uint32_t& FileOffset
+		);
+
 		// Convert an section RVA to an offset from the image base
 		EXPORTED uint32_t PpiRvaToFileOffset(
 			IN PIMAGE_NT_HEADERS ImageHeaders,
@@ -18,6 +18,9 @@
 #include <winternl.h>
 #include <list>
 #include <map>
+#include <atomic>
+#include <memory>
+#include <vector>
 #include <SafetyHook/safetyhook.hpp>
 
 namespace Aurie
@@ -37,21 +40,309 @@ namespace Aurie
 		const char* InterfaceName = nullptr;
 		AurieInterfaceBase* Interface = nullptr;
 
+		// Lowercase copy of InterfaceName and its hash, the key in the interface index
+		std::string FoldedName;
+		uint64_t NameHash = 0;
+
+		// Slot in the interface handle table
+		uint32_t HandleIndex = 0;
+
 		virtual AurieObjectType GetObjectType() override
 		{
 			return AURIE_OBJECT_INTERFACE;
 		}
 	};
 
-	struct AurieMemoryAllocation : AurieObject
+	// Arenas grow in chunks of this size, allocations that don't fit in one get a chunk of their own.
+	// It's also the VirtualAlloc allocation granularity, so every chunk starts on a multiple of it,
+	// and every block starts within this many bytes of the start of its chunk.
+	constexpr size_t AURIE_ARENA_CHUNK_SIZE = 64 * 1024;
+
+	// Small allocations are rounded up to a power of two between 16 bytes and 16 KB
+	constexpr size_t AURIE_ARENA_MIN_BLOCK_SHIFT = 4;
+	constexpr size_t AURIE_ARENA_SIZE_CLASSES = 11;
+	static_assert(AURIE_ARENA_SIZE_CLASSES + 1 == AURIE_MEMORY_HISTOGRAM_BUCKETS);
+
+	// Marks a block that has a chunk to itself
+	constexpr uint32_t AURIE_ARENA_LARGE_BLOCK = UINT32_MAX;
+
+	// Marks the header of an over-aligned block, the low bits hold the distance back to the block it lives in
+	constexpr uint32_t AURIE_ARENA_OFFSET_BLOCK = 0x80000000;
+	constexpr uint32_t AURIE_ARENA_OFFSET_MASK = 0xFFFF;
+
+	// Over-aligned blocks keep the log2 of their alignment above the offset, see MmReallocateMemory
+	constexpr uint32_t AURIE_ARENA_ALIGNMENT_SHIFT = 16;
+
+	// Arena chunks are committed in pages, which is also the largest alignment MmAllocateMemoryEx supports
+	constexpr size_t AURIE_ARENA_PAGE_SIZE = 0x1000;
+
+	// Mixed with the header address to form the canary of a live block, freed blocks store its complement
+	constexpr uint32_t AURIE_ARENA_CANARY = 0x4152414E;
+
+	// Placed at the start of every chunk owned by an arena
+	struct alignas(16) AurieArenaChunk
 	{
-		PVOID AllocationBase = nullptr;
-		size_t AllocationSize = 0;
-		AurieModule* OwnerModule = nullptr;
+		AurieArenaChunk* Next = nullptr;
+		AurieArenaChunk* Previous = nullptr;
+		size_t Size = 0;
+	};
 
-		virtual AurieObjectType GetObjectType() override
+	struct AurieArena;
+
+	// Placed right in front of every block handed out by an arena.
+	// Lets MmFreeMemory validate and free a block without searching for it.
+	struct alignas(16) AurieArenaBlockHeader
+	{
+		// The arena the block was carved from
+		AurieArena* Owner;
+
+		// Index into AurieArena::FreeLists, or AURIE_ARENA_LARGE_BLOCK
+		uint32_t SizeClass;
+
+		// AURIE_ARENA_CANARY mixed with the header address while the block is handed out
+		uint32_t Canary;
+	};
+
+	// How many arenas a thread keeps cached blocks for at once
+	constexpr size_t AURIE_ARENA_CACHE_ARENAS = 4;
+
+	// How many blocks of one size class a thread may hold before handing some back to the arena
+	constexpr size_t AURIE_ARENA_CACHE_DEPTH = 32;
+
+	// How many blocks move between a thread cache and its arena at a time
+	constexpr size_t AURIE_ARENA_CACHE_BATCH = 16;
+
+	// Freed small blocks are linked through their own storage
+	struct AurieArenaFreeBlock
+	{
+		AurieArenaFreeBlock* Next;
+	};
+
+	// Holds an SRW lock exclusively for the lifetime of the object
+	class AurieExclusiveLock
+	{
+		SRWLOCK& m_Lock;
+
+	public:
+		explicit AurieExclusiveLock(SRWLOCK& Lock) : m_Lock(Lock)
 		{
-			return AURIE_OBJECT_ALLOCATION;
+			AcquireSRWLockExclusive(&m_Lock);
+		}
+
+		~AurieExclusiveLock()
+		{
+			ReleaseSRWLockExclusive(&m_Lock);
+		}
+
+		AurieExclusiveLock(const AurieExclusiveLock&) = delete;
+		AurieExclusiveLock& operator=(const AurieExclusiveLock&) = delete;
+	};
+
+	// Holds an SRW lock in shared mode for the lifetime of the object
+	class AurieSharedLock
+	{
+		SRWLOCK& m_Lock;
+
+	public:
+		explicit AurieSharedLock(SRWLOCK& Lock) : m_Lock(Lock)
+		{
+			AcquireSRWLockShared(&m_Lock);
+		}
+
+		~AurieSharedLock()
+		{
+			ReleaseSRWLockShared(&m_Lock);
+		}
+
+		AurieSharedLock(const AurieSharedLock&) = delete;
+		AurieSharedLock& operator=(const AurieSharedLock&) = delete;
+	};
+
+	namespace Internal
+	{
+		// Epoch-based reclamation backing AurieRcuPointer, implemented by the object manager
+		void ObpRcuReadLock();
+
+		void ObpRcuReadUnlock();
+
+		void ObpRcuRetire(
+			IN const void* Object,
+			IN void(*Deleter)(const void* Object)
+		);
+
+		// Frees Object once no thread can still be reading it
+		template <typename T>
+		void ObpRcuRetireObject(
+			IN std::unique_ptr<T> Object
+		)
+		{
+			if (!Object)
+				return;
+
+			ObpRcuRetire(
+				Object.release(),
+				[](const void* Object)
+				{
+					delete static_cast<const T*>(Object);
+				}
+			);
+		}
+	}
+
+	// Marks the current thread as reading RCU-published tables for the lifetime of the object.
+	// Snapshots loaded inside stay valid until the guard is destroyed. Guards may nest.
+	class AurieRcuReadGuard
+	{
+	public:
+		AurieRcuReadGuard()
+		{
+			Internal::ObpRcuReadLock();
+		}
+
+		~AurieRcuReadGuard()
+		{
+			Internal::ObpRcuReadUnlock();
+		}
+
+		AurieRcuReadGuard(const AurieRcuReadGuard&) = delete;
+		AurieRcuReadGuard& operator=(const AurieRcuReadGuard&) = delete;
+	};
+
+	// An immutable snapshot of a table, readers load it without locking.
+	// Writers build a new snapshot and publish it, the old one is freed once every reader is done with it.
+	// Writers have to be serialized by the owner of the table.
+	template <typename T>
+	class AurieRcuPointer
+	{
+		std::atomic<const T*> m_Snapshot = nullptr;
+
+	public:
+		AurieRcuPointer() = default;
+
+		// Moving only happens while the owning object isn't published yet
+		AurieRcuPointer(AurieRcuPointer&& Other) noexcept
+		{
+			m_Snapshot.store(Other.m_Snapshot.exchange(nullptr));
+		}
+
+		AurieRcuPointer& operator=(AurieRcuPointer&& Other) noexcept
+		{
+			Publish(std::unique_ptr<const T>(Other.m_Snapshot.exchange(nullptr)));
+			return *this;
+		}
+
+		~AurieRcuPointer()
+		{
+			delete m_Snapshot.load();
+		}
+
+		// Only valid inside an AurieRcuReadGuard, may be null
+		const T* Load() const
+		{
+			return m_Snapshot.load(std::memory_order_seq_cst);
+		}
+
+		void Publish(
+			IN std::unique_ptr<const T> Snapshot
+		)
+		{
+			const T* previous_snapshot = m_Snapshot.exchange(Snapshot.release(), std::memory_order_seq_cst);
+			Internal::ObpRcuRetireObject(std::unique_ptr<const T>(previous_snapshot));
+		}
+	};
+
+	struct AurieInlineHook;
+	struct AurieMidHook;
+	struct AurieVmtHook;
+
+	// What hook lookups walk, rebuilt from the module's hook lists whenever they change
+	struct AurieHookTableSnapshot
+	{
+		std::vector<AurieInlineHook*> InlineHooks;
+		std::vector<AurieMidHook*> MidHooks;
+		std::vector<AurieVmtHook*> VmtHooks;
+	};
+
+	// Backs all memory allocated by a module.
+	// Allocation is a pointer bump in the current chunk, freed blocks are reused through per-size-class free lists.
+	// Small blocks pass through per-thread caches, which move them to and from the arena in batches.
+	struct AurieArena
+	{
+		// Guards everything below, threads only take it to refill or drain their caches
+		SRWLOCK Lock = SRWLOCK_INIT;
+
+		// Distinguishes this arena from a previously released one at the same address, zero until initialized
+		uint64_t Id = 0;
+
+		AurieArenaChunk* Chunks = nullptr;
+
+		// Chunks that hold a single large block, doubly linked so they can be released in O(1)
+		AurieArenaChunk* LargeChunks = nullptr;
+
+		char* Cursor = nullptr;
+		char* Limit = nullptr;
+		AurieArenaFreeBlock* FreeLists[AURIE_ARENA_SIZE_CLASSES] = {};
+
+		// Updated without holding the lock, through relaxed std::atomic_ref operations
+		AurieMemoryStatistics Statistics = {};
+	};
+
+	struct AurieObjectPool;
+
+	// Placed at the start of every slab of an object pool, the objects follow it.
+	// Slabs have a chunk to themselves, so an object finds its slab by masking its address.
+	struct alignas(16) AurieObjectPoolSlab
+	{
+		AurieObjectPoolSlab* Next;
+		AurieObjectPool* Pool;
+	};
+
+	// Hands out fixed-size objects carved from slabs in the owner's arena
+	struct AurieObjectPool
+	{
+		AurieModule* Owner = nullptr;
+		SRWLOCK Lock = SRWLOCK_INIT;
+
+		// Object size rounded up to keep every object 16-byte aligned
+		size_t ObjectSize = 0;
+		size_t ObjectsPerSlab = 0;
+
+		// Objects are linked through their own storage once freed
+		AurieObjectPoolSlab* Slabs = nullptr;
+		AurieArenaFreeBlock* FreeObjects = nullptr;
+	};
+
+	// Identifies a file regardless of the path used to reach it
+	struct AurieFileIdentity
+	{
+		uint64_t VolumeSerial = 0;
+		uint64_t FileIndex = 0;
+
+		bool operator==(const AurieFileIdentity& Other) const = default;
+	};
+
+	// A ModuleInitialize running on the thread pool, see AURIE_MANIFEST_ASYNC_INITIALIZE.
+	// Shared, so that threads waiting on it don't depend on the module staying loaded.
+	struct AurieAsyncInitialization
+	{
+		// Manual-reset, set once ModuleInitialize returns
+		HANDLE CompletionEvent = nullptr;
+
+		// Set before the initialization is submitted, nothing ever sets CompletionEvent otherwise
+		std::atomic<bool> HasStarted = false;
+		std::atomic<bool> IsComplete = false;
+
+		// What ModuleInitialize returned, only valid once IsComplete is set
+		std::atomic<AurieStatus> Status = AURIE_SUCCESS;
+
+		AurieAsyncInitialization() = default;
+		AurieAsyncInitialization(const AurieAsyncInitialization&) = delete;
+		AurieAsyncInitialization& operator=(const AurieAsyncInitialization&) = delete;
+
+		~AurieAsyncInitialization()
+		{
+			if (CompletionEvent)
+				CloseHandle(CompletionEvent);
 		}
 	};
 
@@ -83,6 +374,14 @@ namespace Aurie
 				// If this bit is set, the module was loaded by a MdMapImage call from another module.
 				// This makes it such that its ModulePreload function never gets called.
 				bool IsRuntimeLoaded : 1;
+
+				// If this bit is set, the module's manifest allows running its entries
+				// concurrently with other modules of the same initialization wave.
+				bool AllowsParallelInitialize : 1;
+
+				// If this bit is set, the module's manifest allows running its ModuleInitialize
+				// on the thread pool while the framework carries on with other modules.
+				bool AllowsAsyncInitialize : 1;
 			};
 		} Flags;
 
@@ -97,6 +396,25 @@ namespace Aurie
 		// Specifies the image size in memory.
 		uint32_t ImageSize;
 
+		// ImagePath made absolute, normalized and lowercased, the key in the module path index
+		std::wstring CanonicalImagePath;
+
+		// Only valid if HasImageIdentity is set, querying it can fail for files that aren't on a real volume
+		AurieFileIdentity ImageIdentity;
+		bool HasImageIdentity;
+
+		// The module's slot in the module registry, UINT32_MAX until it's added to it
+		uint32_t RegistrySlot;
+
+		// The copy the image was actually loaded from in hot reload mode, empty otherwise
+		fs::path ShadowImagePath;
+
+		// Modules only depend on modules of earlier waves, see MdpOrderImages
+		uint32_t InitializationWave;
+
+		// Only present if AllowsAsyncInitialize is set, never replaced once the module is in the list
+		std::shared_ptr<AurieAsyncInitialization> AsyncInitialization;
+
 		// The path of the loaded image.
 		fs::path ImagePath;
 
@@ -116,6 +434,9 @@ namespace Aurie
 		// An unload routine for the module
 		AurieEntry ModuleUnload;
 
+		// Optional, only ever called in hot reload mode
+		AurieReloadEntry ModuleReload;
+
 		// The __AurieFrameworkInit function
 		AurieLoaderEntry FrameworkInitialize;
 
@@ -125,12 +446,17 @@ namespace Aurie
 		// Memory allocated by the module
 		// 
 		// If the allocation is made in the global context (i.e. by MmAllocatePersistentMemory)
-		// the allocation is put into g_ArInitialImage of the framework module.
-		std::list<AurieMemoryAllocation> MemoryAllocations;
+		// the allocation is made from the arena of the framework module (g_ArInitialImage).
+		AurieArena MemoryArena;
+
+		// Serializes writers of the hook lists below, lookups go through HookSnapshot instead
+		SRWLOCK HookTableLock = SRWLOCK_INIT;
 
 		// Functions hooked by the module by Mm*Hook functions
 		std::list<AurieInlineHook> InlineHooks;
 		std::list<AurieMidHook> MidHooks;
+		std::list<AurieVmtHook> VmtHooks;
+		AurieRcuPointer<AurieHookTableSnapshot> HookSnapshot;
 
 		// If set, notifies the plugin of any module actions
 		AurieModuleCallback ModuleOperationCallback;
@@ -152,20 +478,52 @@ namespace Aurie
 			this->Flags = {};
 			this->ImageBase = {};
 			this->ImageSize = 0;
+			this->InitializationWave = 0;
+			this->HasImageIdentity = false;
+			this->RegistrySlot = UINT32_MAX;
 			this->ImageEntrypoint = {};
 
 			this->ModuleInitialize = nullptr;
 			this->ModulePreinitialize = nullptr;
 			this->ModuleUnload = nullptr;
+			this->ModuleReload = nullptr;
 			this->FrameworkInitialize = nullptr;
 			this->ModuleOperationCallback = nullptr;
 		}
 	};
 
+	// Number of per-thread counter slots kept by each instrumented hook.
+	// Threads are assigned slots round-robin, so a slot is only shared past this many threads.
+	constexpr size_t AURIE_HOOK_COUNTER_SLOTS = 64;
+
+	// One cache line per slot, so threads going through the same hook don't false-share
+	struct alignas(64) AurieHookCounterSlot
+	{
+		std::atomic<uint64_t> CallCount = 0;
+		std::atomic<uint64_t> CycleCount = 0;
+	};
+
+	struct AurieHookCounters
+	{
+		AurieHookCounterSlot Slots[AURIE_HOOK_COUNTER_SLOTS];
+	};
+
+	// Threads can still be inside the thunk's frame after the hook is removed,
+	// so this is never freed once created.
+	struct AurieHookInstrumentation
+	{
+		AurieHookCounters Counters;
+		safetyhook::Allocation Thunk;
+	};
+
 	struct AurieInlineHook : AurieObject
 	{
 		AurieModule* Owner = nullptr;
 		std::string Identifier;
+
+		// Only present if the hook was created with AURIE_HOOK_INSTRUMENTED.
+		AurieHookInstrumentation* Instrumentation = nullptr;
+
 		SafetyHookInline HookInstance;
 
 		bool operator==(const AurieInlineHook& Other) const
@@ -185,13 +543,29 @@ namespace Aurie
 	{
 		AurieModule* Owner = nullptr;
 		std::string Identifier;
+
+		// Only present if the hook was created with AURIE_HOOK_INSTRUMENTED.
+		AurieHookInstrumentation* Instrumentation = nullptr;
+
 		SafetyHookMid HookInstance;
 
+		// Used instead of HookInstance for hooks created by MmCreateLightMidfunctionHook.
+		// LiteHookInstance jumps into LiteStub, which only spills the requested XMM registers.
+		safetyhook::Allocation LiteStub;
+		SafetyHookInline LiteHookInstance;
+
+		bool IsActive() const
+		{
+			return static_cast<bool>(this->HookInstance) || static_cast<bool>(this->LiteHookInstance);
+		}
+
 		bool operator==(const AurieMidHook& Other) const
 		{
 			return
 				this->HookInstance.destination() == Other.HookInstance.destination() &&
-				this->HookInstance.target() == Other.HookInstance.target();
+				this->HookInstance.target() == Other.HookInstance.target() &&
+				this->LiteHookInstance.destination() == Other.LiteHookInstance.destination() &&
+				this->LiteHookInstance.target() == Other.LiteHookInstance.target();
 		}
 
 		virtual AurieObjectType GetObjectType() override
@@ -200,6 +574,32 @@ namespace Aurie
 		}
 	};
 
+	// A cloned VMT shared by every object it's applied to.
+	// Neither creating it nor hooking methods in it patches code or freezes threads.
+	struct AurieVmtHook : AurieObject
+	{
+		AurieModule* Owner = nullptr;
+		std::string Identifier;
+		SafetyHookVmt HookInstance;
+
+		// Number of methods in the cloned VMT, SafetyHook doesn't check indexes against it
+		size_t MethodCount = 0;
+
+		// Hooked methods, keyed by their index in the original VMT.
+		// Destroyed before HookInstance, which puts the original VMT pointers back.
+		std::map<size_t, safetyhook::VmHook> MethodHooks;
+
+		bool operator==(const AurieVmtHook& Other) const
+		{
+			return this == &Other;
+		}
+
+		virtual AurieObjectType GetObjectType() override
+		{
+			return AURIE_OBJECT_VMT_HOOK;
+		}
+	};
+
 	typedef enum _KTHREAD_STATE
 	{
 		Initialized,
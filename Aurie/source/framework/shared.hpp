@@ -10,6 +10,7 @@
 // Includes
 #include <cstdint>
 #include <filesystem>
+#include <string_view>
 
 // Defines
 #ifndef FORCEINLINE
@@ -51,6 +52,34 @@
 #define AURIE_FWK_PATCH 1
 #endif // AURIE_FWK_PATCH
 
+// Optional manifest a module can export, so the loader knows what it needs before running any of its code.
+// Modules requiring an interface are initialized after the module providing it.
+// The manifest is read straight from the file, so it's a list of strings rather than a struct:
+//
+//	AURIE_MODULE_MANIFEST(
+//		AURIE_MANIFEST_REQUIRES("YYTK_Main")
+//		AURIE_MANIFEST_PROVIDES("MyInterface")
+//		AURIE_MANIFEST_PARALLEL_INITIALIZE
+//		AURIE_MANIFEST_ASYNC_INITIALIZE
+//		AURIE_MANIFEST_LAZY_LOAD
+//	);
+#define AURIE_MANIFEST_REQUIRES(InterfaceName) "requires=" InterfaceName "\0"
+#define AURIE_MANIFEST_PROVIDES(InterfaceName) "provides=" InterfaceName "\0"
+
+// The module's entries may run concurrently with other modules that don't depend on each other.
+// Only use this if the module's ModulePreinitialize and ModuleInitialize are thread-safe.
+#define AURIE_MANIFEST_PARALLEL_INITIALIZE "parallel\0"
+
+// The module's ModuleInitialize runs on the thread pool, the framework doesn't wait for it to return.
+// Other modules can wait for it with ObWaitForModuleInitialization, modules of later waves always do.
+#define AURIE_MANIFEST_ASYNC_INITIALIZE "async\0"
+
+// The module isn't loaded with the rest of the folder, but the first time ObGetInterface or
+// ObAcquireInterfaceHandle asks for one of the interfaces it lists with AURIE_MANIFEST_PROVIDES.
+// Ignored if it doesn't list any.
+#define AURIE_MANIFEST_LAZY_LOAD "lazy\0"
+
+#define AURIE_MODULE_MANIFEST(Entries) EXPORTED const char AurieModuleManifest[] = Entries "\0"
 
 namespace Aurie
 {
@@ -60,9 +89,10 @@ namespace Aurie
 	struct AurieModule;
 	struct AurieList;
 	struct AurieObject;
-	struct AurieMemoryAllocation;
 	struct AurieInlineHook;
 	struct AurieMidHook;
+	struct AurieVmtHook;
+	struct AurieObjectPool;
 	struct AurieHook;
 
 	// Forward declarations (not opaque)
@@ -111,12 +141,55 @@ namespace Aurie
 		AURIE_OBJECT_MODULE = 1,
 		// An AurieInterfaceBase object
 		AURIE_OBJECT_INTERFACE = 2,
-		// An AurieMemoryAllocation object
-		AURIE_OBJECT_ALLOCATION = 3,
+		// No longer used, allocations are blocks in the module's arena rather than objects.
+		// The value stays reserved so the types after it keep theirs.
+		AURIE_OBJECT_ALLOCATION [[deprecated("Allocations are no longer objects")]] = 3,
 		// An AurieHook object
 		AURIE_OBJECT_HOOK = 4,
 		// An AurieHook object
 		AURIE_OBJECT_MIDFUNCTION_HOOK = 5,
+		// An AurieVmtHook object
+		AURIE_OBJECT_VMT_HOOK = 6,
+	};
+
+	enum AurieHookFlags : uint32_t
+	{
+		AURIE_HOOK_FLAGS_NONE = 0,
+		// The hook records call counts and inclusive cycle counts.
+		// Query them with MmQueryHookStatistics. Only supported on x64.
+		// Instrumented inline hooks pass on at most 20 arguments to their destination.
+		AURIE_HOOK_INSTRUMENTED = (1 << 0)
+	};
+
+	enum AurieAllocationFlags : uint32_t
+	{
+		AURIE_ALLOCATION_FLAGS_NONE = 0,
+		// The allocation is filled with zeroes before being returned.
+		AURIE_ALLOCATION_ZERO_MEMORY = (1 << 0)
+	};
+
+	// Selects which SSE registers a light midhook handler gets to see.
+	// General purpose registers and RFlags are always captured.
+	enum AurieMidHookRegisters : uint32_t
+	{
+		AURIE_MIDHOOK_GPR_ONLY = 0,
+		AURIE_MIDHOOK_XMM0 = (1 << 0),
+		AURIE_MIDHOOK_XMM1 = (1 << 1),
+		AURIE_MIDHOOK_XMM2 = (1 << 2),
+		AURIE_MIDHOOK_XMM3 = (1 << 3),
+		AURIE_MIDHOOK_XMM4 = (1 << 4),
+		AURIE_MIDHOOK_XMM5 = (1 << 5),
+		AURIE_MIDHOOK_XMM6 = (1 << 6),
+		AURIE_MIDHOOK_XMM7 = (1 << 7),
+		AURIE_MIDHOOK_XMM8 = (1 << 8),
+		AURIE_MIDHOOK_XMM9 = (1 << 9),
+		AURIE_MIDHOOK_XMM10 = (1 << 10),
+		AURIE_MIDHOOK_XMM11 = (1 << 11),
+		AURIE_MIDHOOK_XMM12 = (1 << 12),
+		AURIE_MIDHOOK_XMM13 = (1 << 13),
+		AURIE_MIDHOOK_XMM14 = (1 << 14),
+		AURIE_MIDHOOK_XMM15 = (1 << 15),
+		AURIE_MIDHOOK_ALL_XMM = 0xFFFF
 	};
 
 	enum AurieModuleOperationType : uint32_t
@@ -288,6 +361,84 @@ namespace Aurie
 		) = 0;
 	};
 
+	// Aggregated over all threads that went through the hook
+	struct AurieHookStatistics
+	{
+		// How many times the hook was entered
+		uint64_t CallCount;
+		// Sum of rdtsc deltas measured around the hook destination (inclusive)
+		uint64_t CycleCount;
+	};
+
+	// A per-thread linear allocator for short-lived memory, see MmGetScratchAllocator.
+	// Allocation is a pointer bump done inline, only moving to another chunk calls into the framework.
+	struct AurieScratchAllocator
+	{
+		char* Cursor;
+		char* Limit;
+		PVOID Chunks;
+		PVOID CurrentChunk;
+	};
+
+	// A position in a scratch allocator that it can be reset back to
+	struct AurieScratchMark
+	{
+		PVOID Chunk;
+		char* Cursor;
+	};
+
+	// Buckets in AurieMemoryStatistics::SizeHistogram
+	constexpr size_t AURIE_MEMORY_HISTOGRAM_BUCKETS = 12;
+
+	// Memory currently held by a module, in terms of the blocks it was given
+	struct AurieMemoryStatistics
+	{
+		// Bytes in live blocks (sizes are rounded up to the block size)
+		uint64_t LiveBytes;
+		// Highest LiveBytes has ever been
+		uint64_t PeakBytes;
+		// Blocks allocated and not yet freed
+		uint64_t LiveAllocations;
+		// Blocks ever allocated
+		uint64_t TotalAllocations;
+		// Live blocks by size, bucket N holds blocks of up to 16 << N bytes, the last bucket everything above 16 KB
+		uint64_t SizeHistogram[AURIE_MEMORY_HISTOGRAM_BUCKETS];
+	};
+
+	// Exposed by the framework under AURIE_HOOK_STATISTICS_INTERFACE_NAME.
+	// Mirrors MmQueryHookStatistics / MmResetHookStatistics.
+	struct AurieHookStatisticsInterface : AurieInterfaceBase
+	{
+		virtual AurieStatus QueryHookStatistics(
+			IN AurieModule* Module,
+			IN std::string_view HookIdentifier,
+			OUT AurieHookStatistics& Statistics
+		) = 0;
+
+		virtual AurieStatus ResetHookStatistics(
+			IN AurieModule* Module,
+			IN std::string_view HookIdentifier
+		) = 0;
+	};
+
+	inline constexpr const char* AURIE_HOOK_STATISTICS_INTERFACE_NAME = "AurieHookStatistics";
+
+	// Refers to an interface by slot, see ObAcquireInterfaceHandle.
+	// The slot's generation changes when the interface goes away, so stale handles fail to resolve.
+	struct AurieInterfaceHandle
+	{
+		uint32_t Index;
+		uint32_t Generation;
+	};
+
+	// Refers to a module by registry slot, see MdAcquireModuleHandle.
+	// Same as with interfaces, a handle to an unloaded module fails to resolve rather than dangle.
+	struct AurieModuleHandle
+	{
+		uint32_t Index;
+		uint32_t Generation;
+	};
+
 	struct AurieOperationInfo
 	{
 		union
@@ -312,6 +463,15 @@ namespace Aurie
 		const fs::path& ModulePath
 		);
 
+	// Called after a module is hot reloaded, see MdGetReloadState.
+	// State is null and StateSize is zero if the previous image never asked for any state.
+	using AurieReloadEntry = AurieStatus(*)(
+		IN AurieModule* Module,
+		IN const fs::path& ModulePath,
+		IN OPTIONAL PVOID State,
+		IN size_t StateSize
+		);
+
 	using AurieLoaderEntry = AurieStatus(*)(
 		IN AurieModule* InitialImage,
 		IN void* (*PpGetFrameworkRoutine)(IN const char* ImageExportName),
@@ -326,6 +486,41 @@ namespace Aurie
 		OPTIONAL IN OUT AurieOperationInfo* OperationInfo
 		);
 
+	using AurieEventId = uint32_t;
+
+	// Events published by the framework itself, custom events get their IDs from ObRegisterEvent
+	enum AurieFrameworkEvent : AurieEventId
+	{
+		AURIE_EVENT_INVALID = 0,
+		// A module's ModulePreinitialize is about to be called, or just was.
+		// EventData points to an AurieModuleOperationEvent.
+		AURIE_EVENT_MODULE_PREINITIALIZE = 1,
+		// Same as above, for ModuleInitialize
+		AURIE_EVENT_MODULE_INITIALIZE = 2,
+		// Same as above, for ModuleUnload
+		AURIE_EVENT_MODULE_UNLOAD = 3,
+		// IDs from here on are handed out by ObRegisterEvent
+		AURIE_EVENT_FIRST_CUSTOM = 0x100
+	};
+
+	struct AurieModuleOperationEvent
+	{
+		AurieModule* AffectedModule;
+		AurieModuleOperationType OperationType;
+		AurieOperationInfo* OperationInfo;
+	};
+
+	using AurieEventCallback = void(*)(
+		IN AurieEventId EventId,
+		IN PVOID EventData,
+		IN PVOID Context
+		);
+
+	// Runs on the framework's service thread, see ObPostTask
+	using AurieTaskRoutine = void(*)(
+		IN PVOID Context
+		);
+
 #if _WIN64
 	using AurieMidHookFunction = void(*)(
 		IN ProcessorContext64& Context
@@ -392,8 +587,7 @@ namespace Aurie
 		private:
 			using ReturnType = std::function<TFunction>::result_type;
 		public:
-			template <typename ...TArgs>
-			ReturnType operator()(const char* FunctionName, TArgs&... Args)
+			static TFunction* Resolve(const char* FunctionName)
 			{
 				auto Func = reinterpret_cast<TFunction*>(g_PpGetFrameworkRoutine(FunctionName));
 				if (!Func)
@@ -407,24 +601,18 @@ namespace Aurie
 					exit(0);
 				}
 
-				return Func(Args...);
+				return Func;
 			}
 
-			ReturnType operator()(const char* FunctionName)
+			template <typename ...TArgs>
+			ReturnType operator()(const char* FunctionName, TArgs&... Args)
 			{
-				auto Func = reinterpret_cast<TFunction*>(g_PpGetFrameworkRoutine(FunctionName));
-				if (!Func)
-				{
-					std::string error_string = "Tried to call function ";
-					error_string.append(FunctionName);
-					error_string.append(", but PpGetFrameworkRoutine returns nullptr!\n\n");
-					error_string.append("Is your Aurie installation up-to-date?");
-
-					MessageBoxA(0, error_string.c_str(), "Aurie API Dispatcher", MB_OK | MB_ICONERROR);
-					exit(0);
-				}
+				return Resolve(FunctionName)(Args...);
+			}
 
-				return Func();
+			ReturnType operator()(const char* FunctionName)
+			{
+				return Resolve(FunctionName)();
 			}
 		};
 	}
@@ -480,6 +668,57 @@ namespace Aurie
 		return AURIE_API_CALL(MmFreeMemory, Owner, AllocationBase);
 	}
 
+	inline PVOID MmAllocateMemoryEx(
+		IN AurieModule* Owner,
+		IN size_t Size,
+		IN size_t Alignment,
+		IN AurieAllocationFlags Flags
+	)
+	{
+		return AURIE_API_CALL(MmAllocateMemoryEx, Owner, Size, Alignment, Flags);
+	}
+
+	inline PVOID MmReallocateMemory(
+		IN AurieModule* Owner,
+		IN PVOID AllocationBase,
+		IN size_t NewSize
+	)
+	{
+		return AURIE_API_CALL(MmReallocateMemory, Owner, AllocationBase, NewSize);
+	}
+
+	inline AurieStatus MmCreateObjectPool(
+		IN AurieModule* Owner,
+		IN size_t ObjectSize,
+		OUT AurieObjectPool*& Pool
+	)
+	{
+		return AURIE_API_CALL(MmCreateObjectPool, Owner, ObjectSize, Pool);
+	}
+
+	inline AurieStatus MmDestroyObjectPool(
+		IN AurieModule* Owner,
+		IN AurieObjectPool* Pool
+	)
+	{
+		return AURIE_API_CALL(MmDestroyObjectPool, Owner, Pool);
+	}
+
+	inline PVOID MmAllocatePoolObject(
+		IN AurieObjectPool* Pool
+	)
+	{
+		return AURIE_API_CALL(MmAllocatePoolObject, Pool);
+	}
+
+	inline AurieStatus MmFreePoolObject(
+		IN AurieObjectPool* Pool,
+		IN PVOID Object
+	)
+	{
+		return AURIE_API_CALL(MmFreePoolObject, Pool, Object);
+	}
+
 	inline size_t MmSigscanModule(
 		IN const wchar_t* ModuleName,
 		IN const unsigned char* Pattern,
@@ -520,6 +759,219 @@ namespace Aurie
 		return AURIE_API_CALL(MmCreateMidfunctionHook, Module, HookIdentifier, SourceAddress, TargetHandler);
 	}
 
+	inline AurieStatus MmCreateHookEx(
+		IN AurieModule* Module,
+		IN std::string_view HookIdentifier,
+		IN PVOID SourceFunction,
+		IN PVOID DestinationFunction,
+		OUT OPTIONAL PVOID* Trampoline,
+		IN AurieHookFlags Flags
+	)
+	{
+		return AURIE_API_CALL(MmCreateHookEx, Module, HookIdentifier, SourceFunction, DestinationFunction, Trampoline, Flags);
+	}
+
+	inline AurieStatus MmCreateMidfunctionHookEx(
+		IN AurieModule* Module,
+		IN std::string_view HookIdentifier,
+		IN PVOID SourceAddress,
+		IN AurieMidHookFunction TargetHandler,
+		IN AurieHookFlags Flags
+	)
+	{
+		return AURIE_API_CALL(MmCreateMidfunctionHookEx, Module, HookIdentifier, SourceAddress, TargetHandler, Flags);
+	}
+
+	inline AurieStatus MmCreateLightMidfunctionHook(
+		IN AurieModule* Module,
+		IN std::string_view HookIdentifier,
+		IN PVOID SourceAddress,
+		IN AurieMidHookFunction TargetHandler,
+		IN AurieMidHookRegisters Registers,
+		IN AurieHookFlags Flags
+	)
+	{
+		return AURIE_API_CALL(MmCreateLightMidfunctionHook, Module, HookIdentifier, SourceAddress, TargetHandler, Registers, Flags);
+	}
+
+	inline AurieStatus MmCreateVmtHook(
+		IN AurieModule* Module,
+		IN std::string_view HookIdentifier,
+		IN PVOID Object
+	)
+	{
+		return AURIE_API_CALL(MmCreateVmtHook, Module, HookIdentifier, Object);
+	}
+
+	inline AurieStatus MmApplyVmtHook(
+		IN AurieModule* Module,
+		IN std::string_view HookIdentifier,
+		IN PVOID Object
+	)
+	{
+		return AURIE_API_CALL(MmApplyVmtHook, Module, HookIdentifier, Object);
+	}
+
+	inline AurieStatus MmHookVirtualMethod(
+		IN AurieModule* Module,
+		IN std::string_view HookIdentifier,
+		IN size_t MethodIndex,
+		IN PVOID DestinationFunction,
+		OUT OPTIONAL PVOID* OriginalMethod
+	)
+	{
+		return AURIE_API_CALL(MmHookVirtualMethod, Module, HookIdentifier, MethodIndex, DestinationFunction, OriginalMethod);
+	}
+
+	inline AurieStatus MmQueryMemoryStatistics(
+		IN AurieModule* Module,
+		OUT AurieMemoryStatistics& Statistics
+	)
+	{
+		return AURIE_API_CALL(MmQueryMemoryStatistics, Module, Statistics);
+	}
+
+	inline void MmDumpMemoryStatistics(
+		IN OPTIONAL AurieModule* Module
+	)
+	{
+		return AURIE_API_CALL(MmDumpMemoryStatistics, Module);
+	}
+
+	inline AurieStatus MmGetScratchAllocator(
+		OUT AurieScratchAllocator*& Allocator
+	)
+	{
+		return AURIE_API_CALL(MmGetScratchAllocator, Allocator);
+	}
+
+	inline PVOID MmScratchExpand(
+		IN AurieScratchAllocator* Allocator,
+		IN size_t Size,
+		IN size_t Alignment
+	)
+	{
+		return AURIE_API_CALL(MmScratchExpand, Allocator, Size, Alignment);
+	}
+
+	inline void MmScratchRewind(
+		IN AurieScratchAllocator* Allocator,
+		IN const AurieScratchMark& Mark
+	)
+	{
+		return AURIE_API_CALL(MmScratchRewind, Allocator, Mark);
+	}
+
+	// Alignment must be a power of two no larger than a page
+	inline PVOID MmScratchAllocate(
+		IN AurieScratchAllocator* Allocator,
+		IN size_t Size,
+		IN size_t Alignment = 16
+	)
+	{
+		const uintptr_t allocation = (reinterpret_cast<uintptr_t>(Allocator->Cursor) + Alignment - 1) & ~(Alignment - 1);
+
+		if (Allocator->Cursor && allocation + Size <= reinterpret_cast<uintptr_t>(Allocator->Limit))
+		{
+			Allocator->Cursor = reinterpret_cast<char*>(allocation + Size);
+			return reinterpret_cast<PVOID>(allocation);
+		}
+
+		// Out of room in this chunk
+		return MmScratchExpand(Allocator, Size, Alignment);
+	}
+
+	inline AurieScratchMark MmScratchGetMark(
+		IN AurieScratchAllocator* Allocator
+	)
+	{
+		return { Allocator->CurrentChunk, Allocator->Cursor };
+	}
+
+	// Releases everything allocated since the mark was taken
+	inline void MmScratchReset(
+		IN AurieScratchAllocator* Allocator,
+		IN const AurieScratchMark& Mark
+	)
+	{
+		if (Mark.Chunk && Mark.Chunk == Allocator->CurrentChunk)
+		{
+			Allocator->Cursor = Mark.Cursor;
+			return;
+		}
+
+		// We've moved to another chunk since, let the framework walk back
+		MmScratchRewind(Allocator, Mark);
+	}
+
+	// Resets the current thread's scratch allocator when going out of scope,
+	// releasing everything allocated through it (or otherwise) in the meantime.
+	class AurieScratchScope
+	{
+		AurieScratchAllocator* m_Allocator = nullptr;
+		AurieScratchMark m_Mark = {};
+
+	public:
+		AurieScratchScope()
+		{
+			// The allocator lives as long as the thread does
+			static thread_local AurieScratchAllocator* thread_allocator = nullptr;
+			if (!thread_allocator)
+				MmGetScratchAllocator(thread_allocator);
+
+			m_Allocator = thread_allocator;
+			m_Mark = MmScratchGetMark(m_Allocator);
+		}
+
+		~AurieScratchScope()
+		{
+			MmScratchReset(m_Allocator, m_Mark);
+		}
+
+		AurieScratchScope(const AurieScratchScope&) = delete;
+		AurieScratchScope& operator=(const AurieScratchScope&) = delete;
+
+		PVOID Allocate(
+			IN size_t Size,
+			IN size_t Alignment = 16
+		)
+		{
+			return MmScratchAllocate(m_Allocator, Size, Alignment);
+		}
+
+		template <typename T>
+		T* Allocate(
+			IN size_t Count = 1
+		)
+		{
+			return static_cast<T*>(Allocate(sizeof(T) * Count, alignof(T) > 16 ? alignof(T) : 16));
+		}
+	};
+
+	inline AurieStatus MmQueryHookStatistics(
+		IN AurieModule* Module,
+		IN std::string_view HookIdentifier,
+		OUT AurieHookStatistics& Statistics
+	)
+	{
+		return AURIE_API_CALL(MmQueryHookStatistics, Module, HookIdentifier, Statistics);
+	}
+
+	inline AurieStatus MmResetHookStatistics(
+		IN AurieModule* Module,
+		IN std::string_view HookIdentifier
+	)
+	{
+		return AURIE_API_CALL(MmResetHookStatistics, Module, HookIdentifier);
+	}
+
+	inline AurieStatus MmWriteTrace(
+		IN const fs::path& TracePath
+	)
+	{
+		return AURIE_API_CALL(MmWriteTrace, TracePath);
+	}
+
 	inline AurieStatus MmHookExists(
 		IN AurieModule* Module,
 		IN std::string_view HookIdentifier
@@ -619,6 +1071,38 @@ namespace Aurie
 		return AURIE_API_CALL(MdUnmapImage, Module);
 	}
 
+	inline AurieStatus MdScheduleUnmapImage(
+		IN AurieModule* Module
+	)
+	{
+		return AURIE_API_CALL(MdScheduleUnmapImage, Module);
+	}
+
+	inline AurieStatus MdGetReloadState(
+		IN AurieModule* Module,
+		IN size_t Size,
+		OUT PVOID& State
+	)
+	{
+		return AURIE_API_CALL(MdGetReloadState, Module, Size, State);
+	}
+
+	inline AurieStatus MdAcquireModuleHandle(
+		IN AurieModule* Module,
+		OUT AurieModuleHandle& Handle
+	)
+	{
+		return AURIE_API_CALL(MdAcquireModuleHandle, Module, Handle);
+	}
+
+	inline AurieStatus MdResolveModuleHandle(
+		IN AurieModuleHandle Handle,
+		OUT AurieModule*& Module
+	)
+	{
+		return AURIE_API_CALL(MdResolveModuleHandle, Handle, Module);
+	}
+
 	namespace Internal
 	{
 		inline AurieStatus MdpQueryModuleInformation(
@@ -654,6 +1138,14 @@ namespace Aurie
 			return AURIE_API_CALL(MdpGetNextModule, Module, NextModule);
 		}
 
+		inline AurieStatus MdpGetPreviousModule(
+			IN AurieModule* Module,
+			OUT AurieModule*& PreviousModule
+		)
+		{
+			return AURIE_API_CALL(MdpGetPreviousModule, Module, PreviousModule);
+		}
+
 		inline PVOID MdpGetModuleBaseAddress(
 			IN AurieModule* Module
 		)
@@ -702,6 +1194,91 @@ namespace Aurie
 		return AURIE_API_CALL(ObGetInterface, InterfaceName, Interface);
 	}
 
+	inline AurieStatus ObRegisterEvent(
+		IN const char* EventName,
+		OUT AurieEventId& EventId
+	)
+	{
+		return AURIE_API_CALL(ObRegisterEvent, EventName, EventId);
+	}
+
+	inline AurieStatus ObSubscribeEvent(
+		IN AurieModule* Module,
+		IN AurieEventId EventId,
+		IN AurieEventCallback Callback,
+		IN OPTIONAL PVOID Context
+	)
+	{
+		return AURIE_API_CALL(ObSubscribeEvent, Module, EventId, Callback, Context);
+	}
+
+	inline AurieStatus ObUnsubscribeEvent(
+		IN AurieModule* Module,
+		IN AurieEventId EventId,
+		IN AurieEventCallback Callback
+	)
+	{
+		return AURIE_API_CALL(ObUnsubscribeEvent, Module, EventId, Callback);
+	}
+
+	inline AurieStatus ObPublishEvent(
+		IN AurieEventId EventId,
+		IN OPTIONAL PVOID EventData
+	)
+	{
+		// Some events are published every frame, so the export lookup only happens once
+		static auto* const publish_routine = Internal::AurieApiDispatcher<decltype(ObPublishEvent)>::Resolve(
+			"ObPublishEvent"
+		);
+
+		return publish_routine(EventId, EventData);
+	}
+
+	inline AurieStatus ObPostTask(
+		IN AurieModule* Module,
+		IN AurieTaskRoutine Routine,
+		IN OPTIONAL PVOID Context
+	)
+	{
+		return AURIE_API_CALL(ObPostTask, Module, Routine, Context);
+	}
+
+	inline AurieStatus ObRequestShutdown(
+		IN AurieModule* Module
+	)
+	{
+		return AURIE_API_CALL(ObRequestShutdown, Module);
+	}
+
+	inline AurieStatus ObWaitForModuleInitialization(
+		IN AurieModule* Module,
+		IN uint32_t Timeout
+	)
+	{
+		return AURIE_API_CALL(ObWaitForModuleInitialization, Module, Timeout);
+	}
+
+	inline AurieStatus ObAcquireInterfaceHandle(
+		IN const char* InterfaceName,
+		OUT AurieInterfaceHandle& Handle
+	)
+	{
+		return AURIE_API_CALL(ObAcquireInterfaceHandle, InterfaceName, Handle);
+	}
+
+	inline AurieStatus ObResolveInterfaceHandle(
+		IN AurieInterfaceHandle Handle,
+		OUT AurieInterfaceBase*& Interface
+	)
+	{
+		// Resolved on every interface call, so the export lookup only happens once
+		static auto* const resolve_routine = Internal::AurieApiDispatcher<decltype(ObResolveInterfaceHandle)>::Resolve(
+			"ObResolveInterfaceHandle"
+		);
+
+		return resolve_routine(Handle, Interface);
+	}
+
 	namespace Internal
 	{
 		inline void ObpSetModuleOperationCallback(
@@ -10,7 +10,9 @@
 //
 
 #include <algorithm>
+#include <bit>
 #include <functional>
+#include <iterator>
 #include <limits>
 
 
@@ -181,29 +183,29 @@ void Allocator::free(uint8_t* address, size_t size) {
 
 std::expected<Allocation, Allocator::Error> Allocator::internal_allocate_near(
     const std::vector<uint8_t*>& desired_addresses, size_t size, size_t max_distance) {
-    // First search through our list of allocations for a free block that is large
-    // enough.
-    for (const auto& allocation : m_memory) {
-        if (allocation->size < size) {
-            continue;
-        }
-
-        for (auto node = allocation->freelist.get(); node != nullptr; node = node->next.get()) {
-            // Enough room?
-            if (static_cast<size_t>(node->end - node->start) < size) {
-                continue;
-            }
+    // Every desired address has to be within max_distance, so the usable addresses form a single interval.
+    constexpr auto address_max = std::numeric_limits<uintptr_t>::max();
+    uintptr_t low = 0;
+    uintptr_t high = address_max;
 
-            const auto address = node->start;
+    for (auto desired_address : desired_addresses) {
+        const auto address = reinterpret_cast<uintptr_t>(desired_address);
 
-            // Close enough?
-            if (!in_range(address, desired_addresses, max_distance)) {
-                continue;
-            }
+        low = std::max(low, (address > max_distance) ? address - max_distance : 0);
+        high = std::min(high, (address_max - address > max_distance) ? address + max_distance : address_max);
+    }
 
-            node->start += size;
+    // First search the free ranges in the windows that overlap the interval for one that is large enough.
+    if (low <= high) {
+        const auto first = m_windows.lower_bound(low >> window_shift);
+        const auto last = m_windows.upper_bound(high >> window_shift);
 
-            return Allocation{shared_from_this(), address, size};
+        for (auto window = first; window != last; ++window) {
+            if (auto address = take_free_range(window->second, size, reinterpret_cast<uint8_t*>(low),
+                    reinterpret_cast<uint8_t*>(high));
+                address != nullptr) {
+                return Allocation{shared_from_this(), address, size};
+            }
         }
     }
 
@@ -215,62 +217,107 @@ std::expected<Allocation, Allocator::Error> Allocator::internal_allocate_near(
         return std::unexpected{allocation_address.error()};
     }
 
-    auto& allocation = m_memory.emplace_back(new Memory);
+    auto& allocation = m_memory[*allocation_address];
 
+    allocation.reset(new Memory);
     allocation->address = *allocation_address;
     allocation->size = allocation_size;
-    allocation->freelist = std::make_unique<FreeNode>();
-    allocation->freelist->start = *allocation_address + size;
-    allocation->freelist->end = *allocation_address + allocation_size;
+
+    // Blocks in the same window tend to be placed back to back.
+    m_windows[reinterpret_cast<uintptr_t>(*allocation_address) >> window_shift].next_hint =
+        *allocation_address + allocation_size;
+
+    if (size < allocation_size) {
+        insert_free_range(*allocation, *allocation_address + size, *allocation_address + allocation_size);
+    }
 
     return Allocation{shared_from_this(), *allocation_address, size};
 }
 
 void Allocator::internal_free(uint8_t* address, size_t size) {
-    for (const auto& allocation : m_memory) {
-        if (allocation->address > address || allocation->address + allocation->size < address) {
-            continue;
-        }
+    if (auto memory = find_memory(address); memory != nullptr) {
+        insert_free_range(*memory, address, address + size);
+    }
+}
 
-        // Find the right place for our new freenode.
-        FreeNode* prev{};
+Allocator::Memory* Allocator::find_memory(uint8_t* address) {
+    // The last block starting at or before the address is the only one that can contain it.
+    auto it = m_memory.upper_bound(address);
 
-        for (auto node = allocation->freelist.get(); node != nullptr; prev = node, node = node->next.get()) {
-            if (node->start > address) {
-                break;
+    if (it == m_memory.begin()) {
+        return nullptr;
+    }
+
+    --it;
+
+    auto& memory = it->second;
+
+    if (memory->address + memory->size < address) {
+        return nullptr;
+    }
+
+    return memory.get();
+}
+
+uint8_t* Allocator::take_free_range(Window& window, size_t size, uint8_t* low, uint8_t* high) {
+    for (auto i = size_class(size); i < num_size_classes; ++i) {
+        auto& bin = window.bins[i];
+
+        // Bins are sorted by address, so only the ranges starting inside [low, high] are visited.
+        for (auto it = bin.lower_bound(low); it != bin.end() && *it <= high; ++it) {
+            const auto start = *it;
+            auto memory = find_memory(start);
+            auto range = memory->freelist.find(start);
+            const auto end = range->second;
+
+            // Only ranges in the first bin can be too small.
+            if (static_cast<size_t>(end - start) < size) {
+                continue;
             }
-        }
 
-        // Add new freenode.
-        auto free_node = std::make_unique<FreeNode>();
+            erase_free_range(*memory, range);
 
-        free_node->start = address;
-        free_node->end = address + size;
+            if (start + size != end) {
+                insert_free_range(*memory, start + size, end);
+            }
 
-        if (prev == nullptr) {
-            free_node->next.swap(allocation->freelist);
-            allocation->freelist.swap(free_node);
-        } else {
-            free_node->next.swap(prev->next);
-            prev->next.swap(free_node);
+            return start;
         }
-
-        combine_adjacent_freenodes(*allocation);
-        break;
     }
+
+    return nullptr;
 }
 
-void Allocator::combine_adjacent_freenodes(Memory& memory) {
-    for (auto prev = memory.freelist.get(), node = prev; node != nullptr; node = node->next.get()) {
-        if (prev->end == node->start) {
-            prev->end = node->end;
-            prev->next.swap(node->next);
-            node->next.reset();
-            node = prev;
-        } else {
-            prev = node;
+void Allocator::insert_free_range(Memory& memory, uint8_t* start, uint8_t* end) {
+    auto next = memory.freelist.lower_bound(start);
+
+    // Merge with the range right before us.
+    if (next != memory.freelist.begin()) {
+        if (auto prev = std::prev(next); prev->second == start) {
+            start = prev->first;
+            erase_free_range(memory, prev);
         }
     }
+
+    // Merge with the range right after us.
+    if (next != memory.freelist.end() && next->first == end) {
+        end = next->second;
+        erase_free_range(memory, next);
+    }
+
+    memory.freelist.emplace(start, end);
+    m_windows[reinterpret_cast<uintptr_t>(start) >> window_shift].bins[size_class(end - start)].insert(start);
+}
+
+void Allocator::erase_free_range(Memory& memory, std::map<uint8_t*, uint8_t*>::iterator range) {
+    const auto [start, end] = *range;
+
+    m_windows[reinterpret_cast<uintptr_t>(start) >> window_shift].bins[size_class(end - start)].erase(start);
+    memory.freelist.erase(range);
+}
+
+size_t Allocator::size_class(size_t size) {
+    return std::min<size_t>(std::bit_width(std::max<size_t>(size, 1)), num_size_classes) - 1;
 }
 
 std::expected<uint8_t*, Allocator::Error> Allocator::allocate_nearby_memory(
@@ -289,9 +336,12 @@ std::expected<uint8_t*, Allocator::Error> Allocator::allocate_nearby_memory(
         }
 
         if (auto result = vm_allocate(p, size, VM_ACCESS_RWX)) {
+            invalidate_vm_map(result.value(), size);
             return result.value();
         }
 
+        // Somebody else took this region since we cached it.
+        invalidate_vm_map(p, size);
         return nullptr;
     };
 
@@ -311,48 +361,115 @@ std::expected<uint8_t*, Allocator::Error> Allocator::allocate_nearby_memory(
     search_start = std::max(search_start, si.min_address);
     search_end = std::min(search_end, si.max_address);
     desired_address = align_up(desired_address, si.allocation_granularity);
-    VmBasicInfo mbi{};
 
-    // Search backwards from the desired_address.
-    for (auto p = desired_address; p > search_start && in_range(p, desired_addresses, max_distance);
-         p = align_down(mbi.address - 1, si.allocation_granularity)) {
-        auto result = vm_query(p);
+    // Blocks tend to be placed back to back, so try right after the last one in this window before walking.
+    if (auto window = m_windows.find(reinterpret_cast<uintptr_t>(desired_addresses[0]) >> window_shift);
+        window != m_windows.end() && window->second.next_hint != nullptr) {
+        if (auto result = cached_vm_query(window->second.next_hint); result && result->is_free) {
+            if (auto allocation_address = attempt_allocation(window->second.next_hint); allocation_address != nullptr) {
+                return allocation_address;
+            }
+        }
+    }
 
-        if (!result) {
-            break;
+    auto search = [&]() -> uint8_t* {
+        Region mbi{};
+
+        // Search backwards from the desired_address.
+        for (auto p = desired_address; p > search_start && in_range(p, desired_addresses, max_distance);
+             p = align_down(mbi.address - 1, si.allocation_granularity)) {
+            auto result = cached_vm_query(p);
+
+            if (!result) {
+                break;
+            }
+
+            mbi = result.value();
+
+            if (!mbi.is_free) {
+                continue;
+            }
+
+            if (auto allocation_address = attempt_allocation(p); allocation_address != nullptr) {
+                return allocation_address;
+            }
         }
 
-        mbi = result.value();
+        // Search forwards from the desired_address.
+        for (auto p = desired_address; p < search_end && in_range(p, desired_addresses, max_distance);
+             p += mbi.size) {
+            auto result = cached_vm_query(p);
 
-        if (!mbi.is_free) {
-            continue;
+            if (!result) {
+                break;
+            }
+
+            mbi = result.value();
+
+            if (!mbi.is_free) {
+                continue;
+            }
+
+            if (auto allocation_address = attempt_allocation(p); allocation_address != nullptr) {
+                return allocation_address;
+            }
         }
 
-        if (auto allocation_address = attempt_allocation(p); allocation_address != nullptr) {
+        return nullptr;
+    };
+
+    const auto had_snapshot = !m_vm_map.empty();
+
+    if (auto allocation_address = search(); allocation_address != nullptr) {
+        return allocation_address;
+    }
+
+    // Memory may have been freed behind our back since the snapshot was taken, so retry with a fresh one.
+    if (had_snapshot) {
+        m_vm_map.clear();
+
+        if (auto allocation_address = search(); allocation_address != nullptr) {
             return allocation_address;
         }
     }
 
-    // Search forwards from the desired_address.
-    for (auto p = desired_address; p < search_end && in_range(p, desired_addresses, max_distance); p += mbi.size) {
-        auto result = vm_query(p);
+    return std::unexpected{Error::NO_MEMORY_IN_RANGE};
+}
+
+std::optional<Allocator::Region> Allocator::cached_vm_query(uint8_t* address) {
+    if (auto it = m_vm_map.upper_bound(address); it != m_vm_map.begin()) {
+        --it;
 
-        if (!result) {
-            break;
+        if (address < it->second.address + it->second.size) {
+            return it->second;
         }
+    }
 
-        mbi = result.value();
+    auto result = vm_query(address);
 
-        if (!mbi.is_free) {
-            continue;
-        }
+    if (!result) {
+        return std::nullopt;
+    }
 
-        if (auto allocation_address = attempt_allocation(p); allocation_address != nullptr) {
-            return allocation_address;
+    Region region{.address = result->address, .size = result->size, .is_free = result->is_free};
+
+    invalidate_vm_map(region.address, region.size);
+    m_vm_map.emplace(region.address, region);
+
+    return region;
+}
+
+void Allocator::invalidate_vm_map(uint8_t* address, size_t size) {
+    auto first = m_vm_map.upper_bound(address);
+
+    // The region right before might still overlap us.
+    if (first != m_vm_map.begin()) {
+        if (auto prev = std::prev(first); prev->second.address + prev->second.size > address) {
+            first = prev;
         }
     }
 
-    return std::unexpected{Error::NO_MEMORY_IN_RANGE};
+    m_vm_map.erase(first, m_vm_map.lower_bound(address + size));
 }
 
 bool Allocator::in_range(uint8_t* address, const std::vector<uint8_t*>& desired_addresses, size_t max_distance) {
@@ -61,10 +61,14 @@ import std.compat;
 #pragma once
 
 #ifndef SAFETYHOOK_USE_CXXMODULES
+#include <array>
 #include <cstdint>
 #include <expected>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <set>
 #include <vector>
 #else
 import std.compat;
@@ -156,21 +160,34 @@ protected:
     void free(uint8_t* address, size_t size);
 
 private:
-    struct FreeNode {
-        std::unique_ptr<FreeNode> next{};
-        uint8_t* start{};
-        uint8_t* end{};
-    };
+    /// @brief Free ranges are binned by the log2 of their size.
+    static constexpr size_t num_size_classes = 64;
+
+    /// @brief Memory blocks are bucketed by the 2 GB window their address falls in.
+    static constexpr size_t window_shift = 31;
 
     struct Memory {
         uint8_t* address{};
         size_t size{};
-        std::unique_ptr<FreeNode> freelist{};
+        std::map<uint8_t*, uint8_t*> freelist{}; ///< Free ranges (start -> end), kept sorted for O(log n) coalescing.
 
         ~Memory();
     };
 
-    std::vector<std::unique_ptr<Memory>> m_memory{};
+    struct Region {
+        uint8_t* address{};
+        size_t size{};
+        bool is_free{};
+    };
+
+    struct Window {
+        std::array<std::set<uint8_t*>, num_size_classes> bins{}; ///< Starts of the free ranges in each size class.
+        uint8_t* next_hint{};                                    ///< Where the next block will most likely fit.
+    };
+
+    std::map<uint8_t*, std::unique_ptr<Memory>> m_memory{};
+    std::map<uintptr_t, Window> m_windows{};
+    std::map<uint8_t*, Region> m_vm_map{}; ///< Snapshot of the regions queried so far, keyed by base address.
     std::mutex m_mutex{};
 
     Allocator() = default;
@@ -179,9 +196,15 @@ private:
         const std::vector<uint8_t*>& desired_addresses, size_t size, size_t max_distance = 0x7FFF'FFFF);
     void internal_free(uint8_t* address, size_t size);
 
-    static void combine_adjacent_freenodes(Memory& memory);
-    [[nodiscard]] static std::expected<uint8_t*, Error> allocate_nearby_memory(
+    [[nodiscard]] Memory* find_memory(uint8_t* address);
+    [[nodiscard]] uint8_t* take_free_range(Window& window, size_t size, uint8_t* low, uint8_t* high);
+    void insert_free_range(Memory& memory, uint8_t* start, uint8_t* end);
+    void erase_free_range(Memory& memory, std::map<uint8_t*, uint8_t*>::iterator range);
+    [[nodiscard]] std::expected<uint8_t*, Error> allocate_nearby_memory(
         const std::vector<uint8_t*>& desired_addresses, size_t size, size_t max_distance);
+    [[nodiscard]] std::optional<Region> cached_vm_query(uint8_t* address);
+    void invalidate_vm_map(uint8_t* address, size_t size);
+    [[nodiscard]] static size_t size_class(size_t size);
     [[nodiscard]] static bool in_range(
         uint8_t* address, const std::vector<uint8_t*>& desired_addresses, size_t max_distance);
 };
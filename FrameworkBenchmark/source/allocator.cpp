@@ -0,0 +1,230 @@
+#include "benchmarks.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <list>
+#include <random>
+#include <vector>
+using namespace Aurie;
+
+// Total allocate / free cycles per run
+constexpr size_t BENCHMARK_MEMORY_CYCLES = 100000;
+
+// Pool objects freed per run, enough for dozens of slabs
+constexpr size_t BENCHMARK_POOL_OBJECTS = 100000;
+constexpr size_t BENCHMARK_POOL_OBJECT_SIZE = 48;
+
+// What MmAllocateMemory and MmFreeMemory used to do: one list per module,
+// walked once to check ownership and once more to remove the entry.
+struct LegacyAllocation
+{
+	PVOID AllocationBase;
+	size_t AllocationSize;
+	AurieModule* OwnerModule;
+};
+
+static std::list<LegacyAllocation> g_LegacyAllocations;
+
+static PVOID LegacyAllocateMemory(
+	IN AurieModule* Owner,
+	IN size_t Size
+)
+{
+	PVOID allocation_base = new char[Size];
+	g_LegacyAllocations.push_back({ allocation_base, Size, Owner });
+
+	return allocation_base;
+}
+
+static AurieStatus LegacyFreeMemory(
+	IN AurieModule* Owner,
+	IN PVOID AllocationBase
+)
+{
+	auto iterator = std::find_if(
+		g_LegacyAllocations.begin(),
+		g_LegacyAllocations.end(),
+		[AllocationBase](const LegacyAllocation& Allocation) -> bool
+		{
+			return Allocation.AllocationBase == AllocationBase;
+		}
+	);
+
+	if (iterator == g_LegacyAllocations.end() || iterator->OwnerModule != Owner)
+		return AURIE_INVALID_PARAMETER;
+
+	g_LegacyAllocations.remove_if(
+		[AllocationBase](const LegacyAllocation& Allocation)
+		{
+			return Allocation.AllocationBase == AllocationBase;
+		}
+	);
+
+	delete[] reinterpret_cast<char*>(AllocationBase);
+	return AURIE_SUCCESS;
+}
+
+// Keeps LiveCount blocks allocated, and keeps swapping a random one for a new one.
+// Then frees whatever is left in random order.
+template <typename TAllocate, typename TFree>
+static bool RunMemoryChurn(
+	IN const char* Name,
+	IN AurieModule* Module,
+	IN size_t LiveCount,
+	IN TAllocate Allocate,
+	IN TFree Free
+)
+{
+	std::mt19937 random(static_cast<unsigned>(LiveCount));
+	std::uniform_int_distribution<size_t> block_size(16, 256);
+
+	std::vector<PVOID> live_blocks(LiveCount);
+	for (auto& block : live_blocks)
+		block = Allocate(Module, block_size(random));
+
+	size_t failed_frees = 0;
+
+	auto start = benchmark_clock::now();
+
+	for (size_t i = 0; i < BENCHMARK_MEMORY_CYCLES; i++)
+	{
+		PVOID& block = live_blocks[random() % LiveCount];
+
+		if (!AurieSuccess(Free(Module, block)))
+			failed_frees++;
+
+		block = Allocate(Module, block_size(random));
+	}
+
+	const double churn_time = ElapsedMilliseconds(start);
+
+	std::shuffle(live_blocks.begin(), live_blocks.end(), random);
+
+	start = benchmark_clock::now();
+	for (PVOID block : live_blocks)
+	{
+		if (!AurieSuccess(Free(Module, block)))
+			failed_frees++;
+	}
+
+	const double free_time = ElapsedMilliseconds(start);
+
+	printf(
+		"- %-12s %6zu live: %zu cycles in %9.2f ms, freeing the rest %8.2f ms%s\n",
+		Name,
+		LiveCount,
+		BENCHMARK_MEMORY_CYCLES,
+		churn_time,
+		free_time,
+		failed_frees ? " (some frees failed!)" : ""
+	);
+
+	return !failed_frees;
+}
+
+bool BenchmarkMemoryFree()
+{
+	printf("[>] BenchmarkMemoryFree\n");
+
+	AurieModule owner_module;
+	Internal::MmpInitializeArena(owner_module.MemoryArena);
+
+	bool has_passed = true;
+	for (size_t live_count : { 100, 1000, 10000 })
+	{
+		has_passed &= RunMemoryChurn(
+			"list walk",
+			&owner_module,
+			live_count,
+			LegacyAllocateMemory,
+			LegacyFreeMemory
+		);
+
+		has_passed &= RunMemoryChurn(
+			"MmFreeMemory",
+			&owner_module,
+			live_count,
+			[](AurieModule* Owner, size_t Size) { return MmAllocateMemory(Owner, Size); },
+			[](AurieModule* Owner, PVOID AllocationBase) { return MmFreeMemory(Owner, AllocationBase); }
+		);
+	}
+
+	// Blocks of other modules, and anything that isn't a block, have to be turned away
+	AurieModule other_module;
+	Internal::MmpInitializeArena(other_module.MemoryArena);
+
+	char* other_block = static_cast<char*>(MmAllocateMemory(&other_module, 64));
+	char stack_buffer[64] = {};
+
+	if (MmFreeMemory(&owner_module, other_block) != AURIE_INVALID_PARAMETER
+		|| MmFreeMemory(&owner_module, other_block + 16) != AURIE_INVALID_PARAMETER
+		|| MmFreeMemory(&owner_module, stack_buffer) != AURIE_INVALID_PARAMETER)
+	{
+		printf("[!] MmFreeMemory took a block it doesn't own\n");
+		has_passed = false;
+	}
+
+	Internal::MmpReleaseArena(other_module.MemoryArena);
+	Internal::MmpReleaseArena(owner_module.MemoryArena);
+
+	return has_passed;
+}
+
+bool BenchmarkPoolFree()
+{
+	printf("[>] BenchmarkPoolFree\n");
+
+	AurieModule owner_module;
+	Internal::MmpInitializeArena(owner_module.MemoryArena);
+
+	AurieObjectPool* pool = nullptr;
+	AurieObjectPool* other_pool = nullptr;
+	MmCreateObjectPool(&owner_module, BENCHMARK_POOL_OBJECT_SIZE, pool);
+	MmCreateObjectPool(&owner_module, BENCHMARK_POOL_OBJECT_SIZE, other_pool);
+
+	std::vector<PVOID> objects(BENCHMARK_POOL_OBJECTS);
+	for (auto& object : objects)
+		object = MmAllocatePoolObject(pool);
+
+	// Anything that isn't one of the pool's objects has to be turned away
+	char* other_object = static_cast<char*>(MmAllocatePoolObject(other_pool));
+	char* block = static_cast<char*>(MmAllocateMemory(&owner_module, BENCHMARK_POOL_OBJECT_SIZE));
+	char stack_buffer[BENCHMARK_POOL_OBJECT_SIZE] = {};
+
+	bool has_passed = MmFreePoolObject(pool, other_object) == AURIE_INVALID_PARAMETER
+		&& MmFreePoolObject(pool, static_cast<char*>(objects[0]) + 8) == AURIE_INVALID_PARAMETER
+		&& MmFreePoolObject(pool, block) == AURIE_INVALID_PARAMETER
+		&& MmFreePoolObject(pool, stack_buffer) == AURIE_INVALID_PARAMETER;
+
+	if (!has_passed)
+		printf("[!] MmFreePoolObject took an object that isn't the pool's\n");
+
+	std::mt19937 random(static_cast<unsigned>(BENCHMARK_POOL_OBJECTS));
+	std::shuffle(objects.begin(), objects.end(), random);
+
+	size_t failed_frees = 0;
+	const auto start = benchmark_clock::now();
+
+	// The last slab is checked as fast as the first, so this shouldn't depend on how many there are
+	for (PVOID object : objects)
+	{
+		if (!AurieSuccess(MmFreePoolObject(pool, object)))
+			failed_frees++;
+	}
+
+	const double free_time = ElapsedMilliseconds(start);
+
+	printf(
+		"- %zu objects in %zu slabs freed in %.2f ms (%.1f ns each)%s\n",
+		BENCHMARK_POOL_OBJECTS,
+		(BENCHMARK_POOL_OBJECTS + pool->ObjectsPerSlab - 1) / pool->ObjectsPerSlab,
+		free_time,
+		free_time * 1e6 / static_cast<double>(BENCHMARK_POOL_OBJECTS),
+		failed_frees ? " (some frees failed!)" : ""
+	);
+
+	MmDestroyObjectPool(&owner_module, other_pool);
+	MmDestroyObjectPool(&owner_module, pool);
+	Internal::MmpReleaseArena(owner_module.MemoryArena);
+
+	return has_passed && !failed_frees;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "framework.hpp"
+#include <chrono>
+
+using benchmark_clock = std::chrono::steady_clock;
+
+inline double ElapsedMilliseconds(
+	IN benchmark_clock::time_point Start
+)
+{
+	return std::chrono::duration<double, std::milli>(benchmark_clock::now() - Start).count();
+}
+
+// Does nothing, only its address matters
+struct BenchmarkInterface : Aurie::AurieInterfaceBase
+{
+	Aurie::AurieStatus Create() override { return Aurie::AURIE_SUCCESS; }
+	void Destroy() override {}
+
+	void QueryVersion(
+		OUT short& Major,
+		OUT short& Minor,
+		OUT short& Patch
+	) override
+	{
+		Major = 1;
+		Minor = 0;
+		Patch = 0;
+	}
+};
+
+// Churns through MmAllocateMemory / MmFreeMemory, next to the list walk they used to do.
+// Returns false if a valid block was turned away, or a foreign one taken.
+bool BenchmarkMemoryFree();
+
+// Frees a pool's objects across dozens of slabs, after checking it turns away foreign ones
+bool BenchmarkPoolFree();
+
+// Looks up interfaces from several threads at once, and reports lookups per second
+void BenchmarkInterfaceLookup();
+
+// Creates, destroys and looks up interfaces from several threads while a module
+// comes and goes with an interface of its own. Returns false if a lookup ever returned something it shouldn't.
+bool StressInterfaceTables();
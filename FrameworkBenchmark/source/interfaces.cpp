@@ -0,0 +1,299 @@
+#include "benchmarks.hpp"
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+using namespace Aurie;
+
+// Interfaces to look up, and how long each thread count gets
+constexpr size_t BENCHMARK_INTERFACE_COUNT = 64;
+constexpr auto BENCHMARK_LOOKUP_DURATION = std::chrono::milliseconds(500);
+
+// How long the stress test keeps going
+constexpr auto STRESS_DURATION = std::chrono::seconds(10);
+
+constexpr size_t STRESS_INTERFACE_COUNT = 16;
+constexpr size_t STRESS_WRITER_COUNT = 2;
+constexpr size_t STRESS_READER_COUNT = 4;
+
+// Registered by the module that keeps getting loaded and unloaded, see StressLoader
+constexpr const char* STRESS_MODULE_INTERFACE_NAME = "Benchmark_StressModule";
+
+// Set on that module, a reader that sees anything else is looking at a reclaimed one
+constexpr uint32_t STRESS_MODULE_MARKER = 0x5AFE;
+
+static BenchmarkInterface g_StressInterfaces[STRESS_INTERFACE_COUNT];
+static char g_StressInterfaceNames[STRESS_INTERFACE_COUNT][32];
+static BenchmarkInterface g_StressModuleInterface;
+
+struct StressCounters
+{
+	std::atomic<uint64_t> Creates = 0;
+	std::atomic<uint64_t> Destroys = 0;
+	std::atomic<uint64_t> Lookups = 0;
+	std::atomic<uint64_t> ModuleLookups = 0;
+	std::atomic<uint64_t> LoadCycles = 0;
+
+	// Anything a lookup should never return, a torn or reclaimed table shows up here
+	std::atomic<uint64_t> Mismatches = 0;
+	std::atomic<uint64_t> LoadFailures = 0;
+};
+
+void BenchmarkInterfaceLookup()
+{
+	printf("[>] BenchmarkInterfaceLookup\n");
+
+	AurieModule owner_module;
+
+	static BenchmarkInterface interfaces[BENCHMARK_INTERFACE_COUNT];
+	static char interface_names[BENCHMARK_INTERFACE_COUNT][32];
+
+	AurieInterfaceHandle handles[BENCHMARK_INTERFACE_COUNT] = {};
+
+	for (size_t i = 0; i < BENCHMARK_INTERFACE_COUNT; i++)
+	{
+		snprintf(interface_names[i], sizeof(interface_names[i]), "Benchmark_Lookup%zu", i);
+		ObCreateInterface(&owner_module, &interfaces[i], interface_names[i]);
+		ObAcquireInterfaceHandle(interface_names[i], handles[i]);
+	}
+
+	// Readers don't take a lock, so throughput should grow with the thread count
+	for (bool by_handle : { false, true })
+	{
+		for (size_t thread_count : { 1, 2, 4, 8 })
+		{
+			std::atomic<bool> is_running = true;
+			std::atomic<uint64_t> total_lookups = 0;
+			std::atomic<uint64_t> failed_lookups = 0;
+			std::vector<std::thread> threads;
+
+			for (size_t i = 0; i < thread_count; i++)
+			{
+				threads.emplace_back(
+					[&, i]()
+					{
+						uint64_t lookups = 0, failures = 0;
+						size_t index = i;
+
+						while (is_running.load(std::memory_order_relaxed))
+						{
+							AurieInterfaceBase* found_interface = nullptr;
+							AurieStatus last_status = by_handle
+								? ObResolveInterfaceHandle(handles[index], found_interface)
+								: ObGetInterface(interface_names[index], found_interface);
+
+							if (!AurieSuccess(last_status) || found_interface != &interfaces[index])
+								failures++;
+
+							index = (index + 1) % BENCHMARK_INTERFACE_COUNT;
+							lookups++;
+						}
+
+						total_lookups += lookups;
+						failed_lookups += failures;
+					}
+				);
+			}
+
+			const auto start = benchmark_clock::now();
+
+			std::this_thread::sleep_for(BENCHMARK_LOOKUP_DURATION);
+			is_running = false;
+
+			for (auto& thread : threads)
+				thread.join();
+
+			const double elapsed_time = ElapsedMilliseconds(start);
+
+			printf(
+				"- %-8s %zu threads: %12.0f lookups/s%s\n",
+				by_handle ? "handle" : "name",
+				thread_count,
+				static_cast<double>(total_lookups.load()) * 1000.0 / elapsed_time,
+				failed_lookups.load() ? " (some lookups failed!)" : ""
+			);
+		}
+	}
+
+	for (size_t i = 0; i < BENCHMARK_INTERFACE_COUNT; i++)
+		ObDestroyInterface(&owner_module, interface_names[i]);
+}
+
+// Both writers go over the same names, so they also race each other to create and destroy them
+static void StressWriter(
+	IN AurieModule* Module,
+	IN const std::atomic<bool>& IsRunning,
+	IN OUT StressCounters& Counters,
+	IN unsigned Seed
+)
+{
+	uint32_t state = Seed;
+	while (IsRunning.load(std::memory_order_relaxed))
+	{
+		state = state * 1664525 + 1013904223;
+		const size_t index = (state >> 16) % STRESS_INTERFACE_COUNT;
+
+		if (AurieSuccess(ObCreateInterface(Module, &g_StressInterfaces[index], g_StressInterfaceNames[index])))
+			Counters.Creates.fetch_add(1, std::memory_order_relaxed);
+
+		if (AurieSuccess(ObDestroyInterface(Module, g_StressInterfaceNames[(index + 1) % STRESS_INTERFACE_COUNT])))
+			Counters.Destroys.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+static void StressReader(
+	IN const std::atomic<bool>& IsRunning,
+	IN OUT StressCounters& Counters
+)
+{
+	AurieInterfaceHandle handles[STRESS_INTERFACE_COUNT] = {};
+	bool has_handle[STRESS_INTERFACE_COUNT] = {};
+
+	while (IsRunning.load(std::memory_order_relaxed))
+	{
+		for (size_t i = 0; i < STRESS_INTERFACE_COUNT; i++)
+		{
+			// By name, the interface is either there or it isn't, but it's never someone else's
+			AurieInterfaceBase* found_interface = nullptr;
+			AurieStatus last_status = ObGetInterface(g_StressInterfaceNames[i], found_interface);
+
+			if (AurieSuccess(last_status) ? found_interface != &g_StressInterfaces[i] : last_status != AURIE_OBJECT_NOT_FOUND)
+				Counters.Mismatches.fetch_add(1, std::memory_order_relaxed);
+
+			// A handle from an earlier generation must not resolve to whatever took its slot since
+			if (!has_handle[i])
+				has_handle[i] = AurieSuccess(ObAcquireInterfaceHandle(g_StressInterfaceNames[i], handles[i]));
+
+			if (has_handle[i])
+			{
+				if (AurieSuccess(ObResolveInterfaceHandle(handles[i], found_interface)))
+				{
+					if (found_interface != &g_StressInterfaces[i])
+						Counters.Mismatches.fetch_add(1, std::memory_order_relaxed);
+				}
+				else
+				{
+					has_handle[i] = false;
+				}
+			}
+
+			Counters.Lookups.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		// The module and its table entry are retired when it's unloaded, they have to stay readable until we're out
+		{
+			AurieRcuReadGuard rcu_guard;
+
+			AurieModule* owner_module = nullptr;
+			AurieInterfaceTableEntry* table_entry = nullptr;
+
+			AurieStatus last_status = Internal::ObpLookupInterfaceOwner(
+				STRESS_MODULE_INTERFACE_NAME,
+				true,
+				owner_module,
+				table_entry
+			);
+
+			if (AurieSuccess(last_status))
+			{
+				if (table_entry->Interface != &g_StressModuleInterface || owner_module->InitializationWave != STRESS_MODULE_MARKER)
+					Counters.Mismatches.fetch_add(1, std::memory_order_relaxed);
+			}
+			else if (last_status != AURIE_OBJECT_NOT_FOUND)
+			{
+				Counters.Mismatches.fetch_add(1, std::memory_order_relaxed);
+			}
+		}
+
+		Counters.ModuleLookups.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+// Does what loading and unloading a module does to the interface tables, see MdpUnmapImage
+static void StressLoader(
+	IN const std::atomic<bool>& IsRunning,
+	IN OUT StressCounters& Counters
+)
+{
+	while (IsRunning.load(std::memory_order_relaxed))
+	{
+		auto loaded_module = std::make_unique<AurieModule>();
+		loaded_module->InitializationWave = STRESS_MODULE_MARKER;
+
+		if (!AurieSuccess(ObCreateInterface(loaded_module.get(), &g_StressModuleInterface, STRESS_MODULE_INTERFACE_NAME)))
+		{
+			Counters.LoadFailures.fetch_add(1, std::memory_order_relaxed);
+			continue;
+		}
+
+		for (auto& module_interface : loaded_module->InterfaceTable)
+			module_interface.Interface->Destroy();
+
+		Internal::ObpRemoveModuleInterfaces(loaded_module.get());
+
+		// Scribbled over when it's reclaimed, a reader that still gets to it afterwards sees the difference
+		Internal::ObpRcuRetire(
+			loaded_module.release(),
+			[](const void* Object)
+			{
+				std::unique_ptr<AurieModule> unloaded_module(const_cast<AurieModule*>(static_cast<const AurieModule*>(Object)));
+				unloaded_module->InitializationWave = 0;
+			}
+		);
+
+		Counters.LoadCycles.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+bool StressInterfaceTables()
+{
+	printf("[>] StressInterfaceTables (%lld ms)\n", static_cast<long long>(std::chrono::milliseconds(STRESS_DURATION).count()));
+
+	AurieModule owner_module;
+
+	for (size_t i = 0; i < STRESS_INTERFACE_COUNT; i++)
+		snprintf(g_StressInterfaceNames[i], sizeof(g_StressInterfaceNames[i]), "Benchmark_Stress%zu", i);
+
+	StressCounters counters;
+	std::atomic<bool> is_running = true;
+	std::vector<std::thread> threads;
+
+	for (size_t i = 0; i < STRESS_WRITER_COUNT; i++)
+		threads.emplace_back(StressWriter, &owner_module, std::cref(is_running), std::ref(counters), static_cast<unsigned>(i + 1));
+
+	for (size_t i = 0; i < STRESS_READER_COUNT; i++)
+		threads.emplace_back(StressReader, std::cref(is_running), std::ref(counters));
+
+	threads.emplace_back(StressLoader, std::cref(is_running), std::ref(counters));
+
+	std::this_thread::sleep_for(STRESS_DURATION);
+	is_running = false;
+
+	for (auto& thread : threads)
+		thread.join();
+
+	// Leave nothing behind, the owner goes out of scope
+	for (size_t i = 0; i < STRESS_INTERFACE_COUNT; i++)
+		ObDestroyInterface(&owner_module, g_StressInterfaceNames[i]);
+
+	printf(
+		"- %llu creates, %llu destroys, %llu lookups, %llu module lookups, %llu load cycles (%llu failed)\n",
+		static_cast<unsigned long long>(counters.Creates.load()),
+		static_cast<unsigned long long>(counters.Destroys.load()),
+		static_cast<unsigned long long>(counters.Lookups.load()),
+		static_cast<unsigned long long>(counters.ModuleLookups.load()),
+		static_cast<unsigned long long>(counters.LoadCycles.load()),
+		static_cast<unsigned long long>(counters.LoadFailures.load())
+	);
+
+	const bool has_passed = !counters.Mismatches && !counters.LoadFailures && counters.LoadCycles;
+	printf(
+		"[%c] StressInterfaceTables %s with %llu bad lookups\n",
+		has_passed ? '>' : '!',
+		has_passed ? "passed" : "failed",
+		static_cast<unsigned long long>(counters.Mismatches.load())
+	);
+
+	return has_passed;
+}
@@ -0,0 +1,13 @@
+// Stands in for the module manager, which the interface tables call into.
+// There are no images here, so nothing is ever deferred.
+#include "Module Manager/module.hpp"
+
+namespace Aurie
+{
+	AurieStatus Internal::MdpLoadLazyImage(
+		IN const char*
+	)
+	{
+		return AURIE_OBJECT_NOT_FOUND;
+	}
+}
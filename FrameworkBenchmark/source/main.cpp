@@ -0,0 +1,22 @@
+// Runs the framework's allocator, interface tables and RCU on Linux, no Windows or game process needed.
+// Only the arena and object manager sources are built, shim/ stands in for Windows.h and loader.cpp for the module manager.
+// SafetyHook is only linked for the destructors of the hooks a module holds, with the same Zydis stand-in as the allocator benchmark.
+// Builds from this folder with:
+//   g++ -std=c++23 -O2 -DAURIE_INCLUDE_PRIVATE -DEXPORTED= -Ishim -I../../Aurie/source/framework -I../../Aurie/source/include main.cpp allocator.cpp interfaces.cpp loader.cpp shim/windows.cpp "../../Aurie/source/framework/Memory Manager/arena.cpp" "../../Aurie/source/framework/Object Manager/interface.cpp" "../../Aurie/source/framework/Object Manager/rcu.cpp" ../../Aurie/source/include/SafetyHook/safetyhook.cpp ../../AllocatorBenchmark/source/decoder.cpp
+// Add -fsanitize=address or -fsanitize=thread to have the stress test checked for reclaimed memory or data races.
+#include "benchmarks.hpp"
+#include <cstdio>
+
+int main()
+{
+	bool has_passed = BenchmarkMemoryFree();
+	has_passed &= BenchmarkPoolFree();
+
+	BenchmarkInterfaceLookup();
+	has_passed &= StressInterfaceTables();
+
+	// Whatever is still retired, every thread is out of its read section by now
+	Aurie::Internal::ObpRcuReclaimAll();
+
+	return has_passed ? 0 : 1;
+}
@@ -0,0 +1,107 @@
+// Just enough of Windows.h for the framework headers to parse on Linux.
+// Only the functions the benchmark ends up calling are declared, they're implemented in windows.cpp.
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <pthread.h>
+
+#define WINAPI
+#define NTAPI
+#define CALLBACK
+#define __forceinline inline
+#define __declspec(x)
+
+#define TRUE 1
+#define FALSE 0
+#define MAX_PATH 260
+#define INFINITE 0xFFFFFFFF
+
+typedef void* PVOID;
+typedef void* LPVOID;
+typedef void* HANDLE;
+typedef struct HINSTANCE__* HINSTANCE;
+typedef HINSTANCE HMODULE;
+typedef struct HWND__* HWND;
+typedef int BOOL;
+typedef unsigned char BYTE;
+typedef unsigned short WORD;
+typedef uint32_t DWORD;
+typedef int32_t LONG;
+typedef uint32_t ULONG;
+typedef unsigned int UINT;
+typedef uint64_t ULONGLONG;
+typedef uint64_t DWORD64;
+typedef uintptr_t ULONG_PTR;
+typedef uintptr_t SIZE_T;
+typedef int32_t NTSTATUS;
+typedef LONG KPRIORITY;
+typedef wchar_t WCHAR;
+typedef int INT;
+typedef ULONG* PULONG;
+
+typedef union
+{
+	struct
+	{
+		DWORD LowPart;
+		LONG HighPart;
+	};
+	int64_t QuadPart;
+} LARGE_INTEGER;
+
+typedef struct
+{
+	HANDLE UniqueProcess;
+	HANDLE UniqueThread;
+} CLIENT_ID;
+
+typedef struct
+{
+	WORD Length;
+	WORD MaximumLength;
+	WCHAR* Buffer;
+} UNICODE_STRING;
+
+// Opaque, only ever handled by pointer
+typedef struct IMAGE_NT_HEADERS32* PIMAGE_NT_HEADERS32;
+typedef struct IMAGE_NT_HEADERS64* PIMAGE_NT_HEADERS64;
+typedef PIMAGE_NT_HEADERS64 PIMAGE_NT_HEADERS;
+
+typedef struct TP_WORK* PTP_WORK;
+typedef struct TP_CALLBACK_INSTANCE* PTP_CALLBACK_INSTANCE;
+
+#define MOD_ALT 0x0001
+#define MOD_CONTROL 0x0002
+#define MOD_SHIFT 0x0004
+
+// Only ever locked and unlocked, which a pthread rwlock does just as well
+typedef struct
+{
+	pthread_rwlock_t Lock;
+} SRWLOCK, *PSRWLOCK;
+
+#define SRWLOCK_INIT { PTHREAD_RWLOCK_INITIALIZER }
+
+typedef struct
+{
+	PVOID Ptr;
+} CONDITION_VARIABLE;
+
+#define CONDITION_VARIABLE_INIT { nullptr }
+
+void AcquireSRWLockExclusive(PSRWLOCK SRWLock);
+void ReleaseSRWLockExclusive(PSRWLOCK SRWLock);
+void AcquireSRWLockShared(PSRWLOCK SRWLock);
+void ReleaseSRWLockShared(PSRWLOCK SRWLock);
+
+#define MEM_COMMIT 0x1000
+#define MEM_RESERVE 0x2000
+#define MEM_RELEASE 0x8000
+#define PAGE_READWRITE 0x04
+
+// Allocations start on a 64 KB boundary, like they do on Windows
+PVOID VirtualAlloc(PVOID Address, SIZE_T Size, DWORD AllocationType, DWORD Protect);
+BOOL VirtualFree(PVOID Address, SIZE_T Size, DWORD FreeType);
+
+BOOL CloseHandle(HANDLE Object);
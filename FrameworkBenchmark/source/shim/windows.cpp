@@ -0,0 +1,86 @@
+#include <Windows.h>
+#include <sys/mman.h>
+#include <mutex>
+#include <unordered_map>
+
+// VirtualAlloc's allocation granularity, arenas find a block's chunk by rounding down to it
+constexpr size_t SHIM_ALLOCATION_GRANULARITY = 64 * 1024;
+
+// munmap needs the size, VirtualFree with MEM_RELEASE doesn't get one
+static std::mutex g_ShimAllocationLock;
+static std::unordered_map<uintptr_t, size_t> g_ShimAllocations;
+
+void AcquireSRWLockExclusive(PSRWLOCK SRWLock)
+{
+	pthread_rwlock_wrlock(&SRWLock->Lock);
+}
+
+void ReleaseSRWLockExclusive(PSRWLOCK SRWLock)
+{
+	pthread_rwlock_unlock(&SRWLock->Lock);
+}
+
+void AcquireSRWLockShared(PSRWLOCK SRWLock)
+{
+	pthread_rwlock_rdlock(&SRWLock->Lock);
+}
+
+void ReleaseSRWLockShared(PSRWLOCK SRWLock)
+{
+	pthread_rwlock_unlock(&SRWLock->Lock);
+}
+
+PVOID VirtualAlloc(PVOID Address, SIZE_T Size, DWORD, DWORD)
+{
+	if (Address || !Size)
+		return nullptr;
+
+	Size = (Size + SHIM_ALLOCATION_GRANULARITY - 1) & ~(SHIM_ALLOCATION_GRANULARITY - 1);
+
+	// Map a granule more than needed, then trim both ends so the rest starts on a granule
+	const size_t mapped_size = Size + SHIM_ALLOCATION_GRANULARITY;
+	void* mapping = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mapping == MAP_FAILED)
+		return nullptr;
+
+	const uintptr_t mapping_start = reinterpret_cast<uintptr_t>(mapping);
+	const uintptr_t allocation = (mapping_start + SHIM_ALLOCATION_GRANULARITY - 1) & ~(SHIM_ALLOCATION_GRANULARITY - 1);
+
+	if (allocation != mapping_start)
+		munmap(mapping, allocation - mapping_start);
+
+	const uintptr_t allocation_end = allocation + Size;
+	if (allocation_end != mapping_start + mapped_size)
+		munmap(reinterpret_cast<void*>(allocation_end), mapping_start + mapped_size - allocation_end);
+
+	std::lock_guard allocation_lock(g_ShimAllocationLock);
+	g_ShimAllocations[allocation] = Size;
+
+	return reinterpret_cast<PVOID>(allocation);
+}
+
+BOOL VirtualFree(PVOID Address, SIZE_T, DWORD FreeType)
+{
+	if (FreeType != MEM_RELEASE)
+		return FALSE;
+
+	size_t size = 0;
+
+	{
+		std::lock_guard allocation_lock(g_ShimAllocationLock);
+
+		auto iterator = g_ShimAllocations.find(reinterpret_cast<uintptr_t>(Address));
+		if (iterator == g_ShimAllocations.end())
+			return FALSE;
+
+		size = iterator->second;
+		g_ShimAllocations.erase(iterator);
+	}
+
+	return munmap(Address, size) == 0;
+}
+
+BOOL CloseHandle(HANDLE)
+{
+	return TRUE;
+}